@@ -0,0 +1,160 @@
+#include "AttitudeBatch.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+// Same layout as EKFBatch: the inputs of a block are copied into aligned local arrays, every loop over
+// b runs across the kBatchLanes samples of the block with a trip count known at compile time, and the
+// results are copied out. The lane functions are branch free, their selects become blends once the
+// compiler may evaluate both sides and sqrt needs no errno, which the Makefile allows for this file
+// alone (-fno-trapping-math -fno-math-errno); the auto-vectorizer then turns each loop into SIMD code.
+
+namespace matrix_utils {
+    namespace {
+        constexpr std::size_t L = kBatchLanes;
+        constexpr float kPi = 3.14159265f;
+        constexpr float kHalfPi = 1.57079633f;
+        constexpr float kRad2Deg = 180.0f / 3.14159265f;
+
+        // atan(t) for t in [0, 1], odd minimax polynomial of degree 11
+        inline float atanUnit(float t) {
+            float t2 = t*t;
+            return t*(0.99997726f + t2*(-0.33262347f + t2*(0.19354346f + t2*(-0.11643287f +
+                      t2*(0.05265332f + t2*(-0.01172120f))))));
+        }
+
+        // reduced to atan(min/max) on [0, 1], then reflected into the quadrant of (x, y)
+        inline float atan2Lane(float y, float x) {
+            float ax = std::fabs(x), ay = std::fabs(y);
+            float hi = ax > ay ? ax : ay;
+            float lo = ax > ay ? ay : ax;
+            float r = atanUnit(lo / (hi > 0.0f ? hi : 1.0f));
+            r = ay > ax ? kHalfPi - r : r;
+            r = x < 0.0f ? kPi - r : r;
+            return std::copysign(r, y);
+        }
+
+        // asin(a) = pi/2 - sqrt(1 - a) * p(a) on [0, 1], Abramowitz & Stegun 4.4.46
+        inline float asinLane(float x) {
+            float a = std::fabs(x);
+            a = a < 1.0f ? a : 1.0f;
+            float p = -0.0012624911f;
+            p = p*a + 0.0066700901f;
+            p = p*a - 0.0170881256f;
+            p = p*a + 0.0308918810f;
+            p = p*a - 0.0501743046f;
+            p = p*a + 0.0889789874f;
+            p = p*a - 0.2145988016f;
+            p = p*a + 1.5707963050f;
+            return std::copysign(kHalfPi - std::sqrt(1.0f - a) * p, x);
+        }
+
+        // first n elements of src, the rest of the block filled with pad
+        inline void loadLanes(const float* src, std::size_t n, float pad, float (&dst)[L]) {
+            std::copy(src, src + n, dst);
+            std::fill(dst + n, dst + L, pad);
+        }
+
+        inline void storeLanes(const float (&src)[L], std::size_t n, float* dst) {
+            std::copy(src, src + n, dst);
+        }
+
+        // step(base, n) for every block of L samples, the last one holding n <= L
+        template <typename Step>
+        void forEachBlock(std::size_t count, unsigned threads, Step step) {
+            std::size_t blocks = (count + L - 1) / L;
+            if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+            std::size_t workers = std::min<std::size_t>(threads, count / kMinSamplesPerThread);
+
+            auto run = [&](std::size_t first, std::size_t last) {
+                for(std::size_t k=first; k<last; ++k) step(k * L, std::min(L, count - k * L));
+            };
+            if (workers <= 1) {
+                run(0, blocks);
+                return;
+            }
+            std::vector<std::thread> pool;
+            pool.reserve(workers - 1);
+            for(std::size_t w=1; w<workers; ++w)
+                pool.emplace_back(run, blocks * w / workers, blocks * (w + 1) / workers);
+            run(0, blocks / workers);
+            for(auto& t : pool) t.join();
+        }
+    }
+
+    float fastAtan2(float y, float x) {
+        return atan2Lane(y, x);
+    }
+
+    float fastAsin(float x) {
+        return asinLane(x);
+    }
+
+    void quaternionToEulerBatch(const QuaternionBatch& q, std::size_t count, const EulerOutput& out,
+                                unsigned threads) {
+        forEachBlock(count, threads, [&](std::size_t base, std::size_t n) {
+            alignas(64) float q0[L], q1[L], q2[L], q3[L];
+            alignas(64) float roll[L], pitch[L], yaw[L];
+            loadLanes(q.w + base, n, 1.0f, q0);
+            loadLanes(q.x + base, n, 0.0f, q1);
+            loadLanes(q.y + base, n, 0.0f, q2);
+            loadLanes(q.z + base, n, 0.0f, q3);
+
+            // same expressions as quaternionToEuler
+            for(std::size_t b=0; b<L; ++b) {
+                float sinr_cosp = 2.0f * (q0[b] * q1[b] + q2[b] * q3[b]);
+                float cosr_cosp = 1.0f - 2.0f * (q1[b]*q1[b] + q2[b]*q2[b]);
+                roll[b] = atan2Lane(sinr_cosp, cosr_cosp) * kRad2Deg;
+            }
+            for(std::size_t b=0; b<L; ++b) {
+                // asinLane clamps, which is the +-90 deg of quaternionToEuler for |sinp| >= 1
+                float sinp = 2.0f * (q0[b] * q2[b] - q3[b] * q1[b]);
+                pitch[b] = asinLane(sinp) * kRad2Deg;
+            }
+            for(std::size_t b=0; b<L; ++b) {
+                float siny_cosp = 2.0f * (q0[b] * q3[b] + q1[b] * q2[b]);
+                float cosy_cosp = 1.0f - 2.0f * (q2[b]*q2[b] + q3[b]*q3[b]);
+                yaw[b] = atan2Lane(siny_cosp, cosy_cosp) * kRad2Deg;
+            }
+
+            storeLanes(roll, n, out.roll + base);
+            storeLanes(pitch, n, out.pitch + base);
+            storeLanes(yaw, n, out.yaw + base);
+        });
+    }
+
+    void rotateVectorBatch(const QuaternionBatch& q, const Vector3Batch& v, std::size_t count,
+                           const Vector3Output& out, unsigned threads) {
+        forEachBlock(count, threads, [&](std::size_t base, std::size_t n) {
+            alignas(64) float q0[L], q1[L], q2[L], q3[L], v0[L], v1[L], v2[L];
+            alignas(64) float r0[L], r1[L], r2[L];
+            loadLanes(q.w + base, n, 1.0f, q0);
+            loadLanes(q.x + base, n, 0.0f, q1);
+            loadLanes(q.y + base, n, 0.0f, q2);
+            loadLanes(q.z + base, n, 0.0f, q3);
+            loadLanes(v.x + base, n, 0.0f, v0);
+            loadLanes(v.y + base, n, 0.0f, v1);
+            loadLanes(v.z + base, n, 0.0f, v2);
+
+            for(std::size_t b=0; b<L; ++b) {
+                float t2 =   q0[b]*q1[b];
+                float t3 =   q0[b]*q2[b];
+                float t4 =   q0[b]*q3[b];
+                float t5 =  -q1[b]*q1[b];
+                float t6 =   q1[b]*q2[b];
+                float t7 =   q1[b]*q3[b];
+                float t8 =  -q2[b]*q2[b];
+                float t9 =   q2[b]*q3[b];
+                float t10 = -q3[b]*q3[b];
+                r0[b] = 2*( (t8 + t10)*v0[b] + (t6 - t4)*v1[b] + (t3 + t7)*v2[b] ) + v0[b];
+                r1[b] = 2*( (t4 + t6)*v0[b] + (t5 + t10)*v1[b] + (t9 - t2)*v2[b] ) + v1[b];
+                r2[b] = 2*( (t7 - t3)*v0[b] + (t2 + t9)*v1[b] + (t5 + t8)*v2[b] ) + v2[b];
+            }
+
+            storeLanes(r0, n, out.x + base);
+            storeLanes(r1, n, out.y + base);
+            storeLanes(r2, n, out.z + base);
+        });
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef ATTITUDE_BATCH_HPP
+#define ATTITUDE_BATCH_HPP
+#include "BatchLayout.hpp"
+#include <cstddef>
+
+// Array-in/array-out versions of matrix_utils::quaternionToEuler and rotateVector for post-processing
+// long logs. Inputs and outputs are structure-of-arrays buffers, one array per component, processed
+// in blocks that the compiler turns into SIMD lanes, with atan2 and asin replaced by polynomials.
+// Inputs of at least kMinSamplesPerThread samples per thread are split across threads.
+namespace matrix_utils {
+    // count quaternions as four component arrays, (w, x, y, z) like Quaternion
+    struct QuaternionBatch {
+        const float* w;
+        const float* x;
+        const float* y;
+        const float* z;
+    };
+
+    struct Vector3Output {
+        float* x;
+        float* y;
+        float* z;
+    };
+
+    // degrees, like quaternionToEuler
+    struct EulerOutput {
+        float* roll;
+        float* pitch;
+        float* yaw;
+    };
+
+    // Largest error of the polynomials against the exact function, measured on a dense sweep (atan2
+    // over every direction at scales from 1e-3 to 1e3, asin over [-1, 1])
+    constexpr float kFastAtan2MaxError = 2.0e-6f;  // rad
+    constexpr float kFastAsinMaxError  = 3.0e-7f;  // rad
+    // Largest difference of quaternionToEulerBatch from quaternionToEuler on unit quaternions, in
+    // degrees. Holds for pitch, and for roll and yaw away from gimbal lock (|pitch| < 89 deg): near
+    // it they are ill-conditioned and both functions are dominated by float rounding
+    constexpr float kEulerBatchMaxError = 2.0e-4f;
+
+    constexpr std::size_t kMinSamplesPerThread = 1 << 16;
+
+    // minimax polynomial on the octant and reflections, within kFastAtan2MaxError; fastAtan2(0, 0) is 0
+    float fastAtan2(float y, float x);
+    // x is clamped to [-1, 1], within kFastAsinMaxError
+    float fastAsin(float x);
+
+    // threads = 0 uses every hardware thread; the output arrays must not overlap the inputs
+    void quaternionToEulerBatch(const QuaternionBatch& q, std::size_t count, const EulerOutput& out,
+                                unsigned threads = 1);
+    // rotates v[i] by q[i], same formula as rotateVector
+    void rotateVectorBatch(const QuaternionBatch& q, const Vector3Batch& v, std::size_t count,
+                           const Vector3Output& out, unsigned threads = 1);
+}
+#endif
@@ -0,0 +1,18 @@
+#ifndef BATCH_LAYOUT_HPP
+#define BATCH_LAYOUT_HPP
+#include <cstddef>
+
+// Structure-of-arrays layout shared by EKFBatch and the AttitudeBatch kernels: each component of a
+// batch is one contiguous array, processed in blocks of kBatchLanes elements whose loops the compiler
+// turns into SIMD lanes.
+
+// elements processed together in one block
+constexpr std::size_t kBatchLanes = 16;
+
+// One 3-vector per element, as three component arrays
+struct Vector3Batch {
+    const float* x;
+    const float* y;
+    const float* z;
+};
+#endif
@@ -2,10 +2,52 @@
 #include "matrixUtils.hpp"
 #include <cmath>
 
+#ifdef EKF_CHECK_ALLOCATIONS
+#include "allocationHook.hpp"
+// Debug builds with the allocation hook assert that a step never reaches the heap
+#define EKF_EXPECT_NO_ALLOCATIONS() allocation_hook::ExpectNone expectNoAllocations_
+#else
+#define EKF_EXPECT_NO_ALLOCATIONS()
+#endif
+
 using namespace matrix_utils;
 
-EKF::EKF(float dt):
-    dt_(dt),
+namespace {
+    // q is any 4x1 expression, such as a view of the state
+    template <typename Q, typename T = typename Q::ElementType>
+    fixed_matrix<T, 4, 1> quaternionRate(const Q& q, const fixed_matrix<T, 3, 1>& omega) {
+        T q0=q(0,0), q1=q(1,0), q2=q(2,0), q3=q(3,0);
+        T wx=omega(0,0), wy=omega(1,0), wz=omega(2,0);
+        const T h(0.5f);
+
+        fixed_matrix<T, 4, 1> dq;
+        dq.set_elt(0,0, h * (-q1*wx - q2*wy - q3*wz));
+        dq.set_elt(1,0, h * ( q0*wx + q2*wz - q3*wy));
+        dq.set_elt(2,0, h * ( q0*wy - q1*wz + q3*wx));
+        dq.set_elt(3,0, h * ( q0*wz + q1*wy - q2*wx));
+        return dq;
+    }
+
+    // accel and mag readings expected at attitude q, any 4x1 expression
+    template <typename Q, typename T = typename Q::ElementType>
+    fixed_matrix<T, 6, 1> predictedReadings(const Q& q) {
+        fixed_matrix<T, 6, 1> z;
+        fixed_matrix<T, 3, 1> g, m;
+        g.set_elt(2,0,T(-1));
+        m.set_elt(0,0,T(1));
+
+        z.template segment<0, 3>() = rotateVector(q,g);
+        z.template segment<3, 3>() = rotateVector(q,m);
+        return z;
+    }
+}
+
+template <typename T>
+BasicEKF<T>::BasicEKF(float dt):
+    dt_(T(dt)),
+    updateMode_(UpdateMode::Automatic),
+    integrationMode_(IntegrationMode::Exponential),
+    rDiagonal_(true),
     x_(7, 1),
     P_(7, 7),
     Q_(7, 7),
@@ -13,156 +55,265 @@ EKF::EKF(float dt):
     F_(7, 7),
     H_(6, 7)
 {
-    x_.set_elt(0,0, 1.0f);
-    for(int i=1; i<7; ++i) x_.set_elt(i,0, 0.0f);
+    x_.set_elt(0,0, T(1));
+    for(int i=1; i<7; ++i) x_.set_elt(i,0, T(0));
 
     for(int i=0;i<7;++i)
       for(int j=0;j<7;++j)
-        P_.set_elt(i,j, (i==j? 0.01f : 0.0f));
+        P_.set_elt(i,j, T(i==j? kInitialVariance : 0.0f));
 
-    const float q_att  = 1e-6f;  // quaternion
-    const float q_bias = 1e-5f;  // gyro bias
     for(int i=0;i<7;++i){
-      float v = (i<4? q_att : q_bias);
+      T v(i<4? kQuaternionNoise : kBiasNoise);
       Q_.set_elt(i,i, v);
-      for(int j=0;j<7;++j) if(i!=j) Q_.set_elt(i,j,0.0f);
+      for(int j=0;j<7;++j) if(i!=j) Q_.set_elt(i,j,T(0));
     }
 
-    const float r_acc = 0.01f;
-    const float r_mag = 0.02f;
     for(int i=0;i<6;++i){
-      float v = (i<3? r_acc : r_mag);
+      T v(i<3? kAccelNoise : kMagNoise);
       R_.set_elt(i,i, v);
-      for(int j=0;j<6;++j) if(i!=j) R_.set_elt(i,j,0.0f);
+      for(int j=0;j<6;++j) if(i!=j) R_.set_elt(i,j,T(0));
     }
 
-    for(int i=0;i<7;++i) for(int j=0;j<7;++j) F_.set_elt(i,j,0.0f);
-    for(int i=0;i<6;++i) for(int j=0;j<7;++j) H_.set_elt(i,j,0.0f);
+    // the constant blocks of F_ and H_ (identity and zero) are part of their types
+}
+
+template <typename T>
+void BasicEKF<T>::predict(const Vector3& gyro) {
+    FASTMATRIX_SCOPE("ekf.predict");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.omega = gyro - x_.template segment<4, 3>();
+    ws_.phi = ws_.omega * dt_;
+    propagate(ws_.phi, dt_);
+}
+
+template <typename T>
+void BasicEKF<T>::predict(const Vector3& gyro, float dt) {
+    FASTMATRIX_SCOPE("ekf.predict");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    T step(dt);
+    ws_.omega = gyro - x_.template segment<4, 3>();
+    ws_.phi = ws_.omega * step;
+    propagate(ws_.phi, step);
 }
 
-void EKF::predict(const matrix<float>& gyro) {
-    float bgx = x_(4,0), bgy = x_(5,0), bgz = x_(6,0);
-    matrix<float> omega(3,1);
-    omega.set_elt(0,0, gyro(0,0) - bgx);
-    omega.set_elt(1,0, gyro(1,0) - bgy);
-    omega.set_elt(2,0, gyro(2,0) - bgz);
+template <typename T>
+void BasicEKF<T>::predict(const Vector3* gyro, int count, float dt) {
+    FASTMATRIX_SCOPE("ekf.predict");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    if (count < 1 || count > kMaxGyroSamples) return;
+    T part(dt / count);
+    for(int i=0;i<count;++i)
+      ws_.increments[i] = (gyro[i] - x_.template segment<4, 3>()) * part;
+    ws_.phi = coningRotationVector(ws_.increments, count);
+    propagate(ws_.phi, T(dt));
+}
 
-    matrix<float> q(4,1);
-    for(int i=0;i<4;++i) q.set_elt(i,0, x_(i,0));
+template <typename T>
+void BasicEKF<T>::propagate(const Vector3& phi, T step) {
+    FASTMATRIX_SCOPE("ekf.propagate");
+    // attitude increment dq = exp(phi/2), or its first order (1, phi/2)
+    Quaternion& dq = ws_.dq;
+    if (integrationMode_ == IntegrationMode::Exponential) {
+        dq = rotationVectorToQuaternion(phi);
+    } else {
+        dq.set_elt(0,0, T(1));
+        dq.template segment<1, 3>() = phi * T(0.5f);
+    }
+    T p0=dq(0,0), p1=dq(1,0), p2=dq(2,0), p3=dq(3,0);
 
-    matrix<float> dq = quaternionDerivative(q, omega);
+    // q = q*dq is linear in q: M below is the matrix of right multiplication by dq
+    const T M[4][4] = {{p0, -p1, -p2, -p3},
+                       {p1,  p0,  p3, -p2},
+                       {p2, -p3,  p0,  p1},
+                       {p3,  p2, -p1,  p0}};
+    T q[4] = {x_(0,0), x_(1,0), x_(2,0), x_(3,0)};
     for(int i=0;i<4;++i)
-      x_.set_elt(i,0, x_(i,0) + dt_*dq(i,0));
+      x_.set_elt(i,0, M[i][0]*q[0] + M[i][1]*q[1] + M[i][2]*q[2] + M[i][3]*q[3]);
     normalizeQuaternion();
 
-    float q0=x_(0,0), q1=x_(1,0), q2=x_(2,0), q3=x_(3,0);
-    float wx=omega(0,0), wy=omega(1,0), wz=omega(2,0);
-    const float h = 0.5f;
-
-    F_.set_elt(0,0,  0.0f);   F_.set_elt(0,1, -h*wx); F_.set_elt(0,2, -h*wy); F_.set_elt(0,3, -h*wz);
-    F_.set_elt(1,0,  h*wx);   F_.set_elt(1,1,  0.0f); F_.set_elt(1,2,  h*wz); F_.set_elt(1,3, -h*wy);
-    F_.set_elt(2,0,  h*wy);   F_.set_elt(2,1, -h*wz); F_.set_elt(2,2,  0.0f); F_.set_elt(2,3,  h*wx);
-    F_.set_elt(3,0,  h*wz);   F_.set_elt(3,1,  h*wy); F_.set_elt(3,2, -h*wx); F_.set_elt(3,3,  0.0f);
+    // The quaternion block of F is the exact transition of the step, M followed by the Jacobian of
+    // the normalization, I - q*qt at the new q, which keeps P free of the unobservable norm direction
+    for(int i=0;i<4;++i) q[i] = x_(i,0);
+    for(int j=0;j<4;++j) {
+        T v = q[0]*M[0][j] + q[1]*M[1][j] + q[2]*M[2][j] + q[3]*M[3][j];  // (qt*M)_j
+        for(int i=0;i<4;++i) F_.set_elt(i,j, M[i][j] - q[i]*v);
+    }
 
-    const float s = -0.5f;
+    // a bias error db turns the step by -db*step in the body frame, which moves q by
+    // -step/2 * q*(0, db): the columns of q*(0, e_i), as in quaternionDerivative
+    T q0=q[0], q1=q[1], q2=q[2], q3=q[3];
+    const T s = T(-0.5f) * step;
     F_.set_elt(0,4, s*(-q1)); F_.set_elt(0,5, s*(-q2)); F_.set_elt(0,6, s*(-q3));
-    F_.set_elt(1,4, s*( q0)); F_.set_elt(1,5, s*( q3)); F_.set_elt(1,6, s*(-q2));
-    F_.set_elt(2,4, s*(-q3)); F_.set_elt(2,5, s*( q0)); F_.set_elt(2,6, s*( q1));
-    F_.set_elt(3,4, s*( q2)); F_.set_elt(3,5, s*(-q1)); F_.set_elt(3,6, s*( q0));
+    F_.set_elt(1,4, s*( q0)); F_.set_elt(1,5, s*(-q3)); F_.set_elt(1,6, s*( q2));
+    F_.set_elt(2,4, s*( q3)); F_.set_elt(2,5, s*( q0)); F_.set_elt(2,6, s*(-q1));
+    F_.set_elt(3,4, s*(-q2)); F_.set_elt(3,5, s*( q1)); F_.set_elt(3,6, s*( q0));
 
-    for(int i=4;i<7;++i)
-      for(int j=0;j<7;++j)
-        F_.set_elt(i,j, (i==j?1.0f:0.0f));
-
-    P_ = F_ * P_ * transpose(F_) + Q_;
+    // covariances are symmetric, only their upper triangles are computed. Q_ is the noise of a
+    // step of dt_, other steps get it in proportion to their length
+    P_ = congruence(F_, P_) + Q_ * (step / dt_);
 }
 
-matrix<float> EKF::quaternionDerivative(
-    const matrix<float>& q,
-    const matrix<float>& omega)
+template <typename T>
+typename BasicEKF<T>::Quaternion BasicEKF<T>::quaternionDerivative(
+    const Quaternion& q,
+    const Vector3& omega)
 {
-    float q0=q(0,0), q1=q(1,0), q2=q(2,0), q3=q(3,0);
-    float wx=omega(0,0), wy=omega(1,0), wz=omega(2,0);
-
-    matrix<float> dq(4,1);
-    dq.set_elt(0,0, 0.5f * (-q1*wx - q2*wy - q3*wz));
-    dq.set_elt(1,0, 0.5f * ( q0*wx + q2*wz - q3*wy));
-    dq.set_elt(2,0, 0.5f * ( q0*wy - q1*wz + q3*wx));
-    dq.set_elt(3,0, 0.5f * ( q0*wz + q1*wy - q2*wx));
-    return dq;
+    return quaternionRate(q, omega);
 }
 
-void EKF::normalizeQuaternion() {
-    float n = std::sqrt(
+template <typename T>
+void BasicEKF<T>::normalizeQuaternion() {
+    using std::sqrt;
+    T n = sqrt(
         x_(0,0)*x_(0,0) + x_(1,0)*x_(1,0) +
         x_(2,0)*x_(2,0) + x_(3,0)*x_(3,0)
     );
-    if(n>0){
+    if(n>T(0)){
       for(int i=0;i<4;++i)
         x_.set_elt(i,0, x_(i,0)/n);
     }
 }
 
-matrix<float> EKF::expectedMeasurement(const matrix<float>& q) {
-    matrix<float> z(6,1);
-    matrix<float> g(3,1), m(3,1);
-    g.set_elt(0,0,0.0f); g.set_elt(1,0,0.0f); g.set_elt(2,0,-1.0f);
-    m.set_elt(0,0,1.0f); m.set_elt(1,0,0.0f); m.set_elt(2,0,0.0f);
+template <typename T>
+fixed_matrix<T, 6, 1> BasicEKF<T>::expectedMeasurement(const Quaternion& q) {
+    return predictedReadings(q);
+}
+template <typename T>
+bool BasicEKF<T>::update(const Vector3& accel, const Vector3& mag) {
+    FASTMATRIX_SCOPE("ekf.update");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.z.template segment<0, 3>() = accel;
+    ws_.z.template segment<3, 3>() = mag;
+    linearizeMeasurement();
 
-    matrix<float> a = rotateVector(q,g);
-    matrix<float> b = rotateVector(q,m);
-    for(int i=0;i<3;++i){
-      z.set_elt(i,  0, a(i,0));
-      z.set_elt(i+3,0, b(i,0));
+    if (updateMode_ == UpdateMode::Automatic && rDiagonal_) {
+        return updateSequential(0, 6);
     }
-    return z;
+    return updateBatch();
+}
+
+// A single sensor is applied row by row with the diagonal of R whatever the update mode, any
+// correlation in R involving its rows is ignored
+template <typename T>
+bool BasicEKF<T>::updateAccel(const Vector3& accel) {
+    FASTMATRIX_SCOPE("ekf.update");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.z.template segment<0, 3>() = accel;
+    linearizeMeasurement();
+    return updateSequential(0, 3);
+}
+
+template <typename T>
+bool BasicEKF<T>::updateMag(const Vector3& mag) {
+    FASTMATRIX_SCOPE("ekf.update");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.z.template segment<3, 3>() = mag;
+    linearizeMeasurement();
+    return updateSequential(3, 6);
 }
-void EKF::update(const matrix<float>& accel, const matrix<float>& mag) {
-    matrix<float> z(6,1);
-    for(int i=0;i<3;++i) {
-        z.set_elt(i,   0, accel(i,0));
-        z.set_elt(i+3, 0, mag(i,0));
-    }
 
-    matrix<float> q(4,1);
-    for(int i=0;i<4;++i) q.set_elt(i,0, x_(i,0));
-    matrix<float> z_pred = expectedMeasurement(q);
+// innovation y and Jacobian H_ at the current state, for the measurement in ws_.z
+template <typename T>
+void BasicEKF<T>::linearizeMeasurement() {
+    FASTMATRIX_SCOPE("ekf.linearize");
+    ws_.z_pred = predictedReadings(x_.template segment<0, 4>());
 
-    matrix<float> y = z - z_pred;
+    ws_.y = ws_.z - ws_.z_pred;
 
     //measurement Jacobian H_
-    float q0 = x_(0,0), q1 = x_(1,0), q2 = x_(2,0), q3 = x_(3,0);
+    T q0 = x_(0,0), q1 = x_(1,0), q2 = x_(2,0), q3 = x_(3,0);
+    const T two(2);
+
+    H_.set_elt(0,0, -two*q2);   H_.set_elt(0,1, -two*q3);   H_.set_elt(0,2, -two*q0);   H_.set_elt(0,3, -two*q1);
+    H_.set_elt(1,0,  two*q1);   H_.set_elt(1,1,  two*q0);   H_.set_elt(1,2, -two*q3);   H_.set_elt(1,3, -two*q2);
+    H_.set_elt(2,0, -two*q0);   H_.set_elt(2,1,  two*q1);   H_.set_elt(2,2,  two*q2);   H_.set_elt(2,3, -two*q3);
+
+    H_.set_elt(3,0,  two*q0);   H_.set_elt(3,1,  two*q1);   H_.set_elt(3,2, -two*q2);   H_.set_elt(3,3, -two*q3);
+    H_.set_elt(4,0,  two*q3);   H_.set_elt(4,1,  two*q2);   H_.set_elt(4,2,  two*q1);   H_.set_elt(4,3,  two*q0);
+    H_.set_elt(5,0, -two*q2);   H_.set_elt(5,1,  two*q3);   H_.set_elt(5,2, -two*q0);   H_.set_elt(5,3,  two*q1);
+}
 
-    H_.set_elt(0,0, -2*q2);   H_.set_elt(0,1, -2*q3);   H_.set_elt(0,2, -2*q0);   H_.set_elt(0,3, -2*q1);
-    H_.set_elt(1,0,  2*q1);   H_.set_elt(1,1,  2*q0);   H_.set_elt(1,2, -2*q3);   H_.set_elt(1,3, -2*q2);
-    H_.set_elt(2,0, -2*q0);   H_.set_elt(2,1,  2*q1);   H_.set_elt(2,2,  2*q2);   H_.set_elt(2,3, -2*q3);
+template <typename T>
+bool BasicEKF<T>::updateBatch() {
+    FASTMATRIX_SCOPE("ekf.update_batch");
+    //kalman gain K = P*Ht*S^-1, computed as Kt = S^-1*(H*P) through an LDLt solve
+    ws_.S = congruence(H_, P_) + R_;
+    if (ws_.S_ldlt.compute(ws_.S) != decomposition_status::success) {
+        return false;
+    }
+    ws_.HP = H_ * P_;
+    ws_.Kt = ws_.HP;
+    ws_.S_ldlt.solve_in_place(ws_.Kt);
+
+    x_ += transpose(ws_.Kt) * ws_.y;
+    normalizeQuaternion();
+
+    // (I - K*H)*P == P - K*H*P, and K*H*P = P*Ht*S^-1*H*P is symmetric
+    P_ -= make_symmetric_product(transpose(ws_.Kt), ws_.HP);
+    return true;
+}
 
-    H_.set_elt(3,0,  2*q0);   H_.set_elt(3,1,  2*q1);   H_.set_elt(3,2, -2*q2);   H_.set_elt(3,3, -2*q3);
-    H_.set_elt(4,0,  2*q3);   H_.set_elt(4,1,  2*q2);   H_.set_elt(4,2,  2*q1);   H_.set_elt(4,3,  2*q0);
-    H_.set_elt(5,0, -2*q2);   H_.set_elt(5,1,  2*q3);   H_.set_elt(5,2,  2*q0);   H_.set_elt(5,3, -2*q1);
+// With a diagonal R the measurements are independent, so they can be applied one scalar at a time:
+// s = h*P*ht + r is a scalar, K = P*ht/s, P -= K*h*P. Each row sees the covariance and state left by
+// the previous ones, which gives the batch result for the same linearization point.
+template <typename T>
+bool BasicEKF<T>::updateSequential(int first, int last) {
+    FASTMATRIX_SCOPE("ekf.update_sequential");
+    bool ok = true;
+    for(int i=0;i<7;++i) ws_.dx.set_elt(i,0, T(0));
 
-    for(int i=0; i<6; ++i)
-      for(int j=4; j<7; ++j)
-        H_.set_elt(i,j, 0.0f);
+    for(int m=first;m<last;++m) {
+        for(int j=0;j<4;++j) ws_.h.set_elt(0,j, H_(m,j));
+        // P is symmetric, so P*ht = transpose(h*P), which lets the product skip the zeros of h
+        ws_.ph = transpose(ws_.h * P_);
+        T s = (ws_.h * ws_.ph)(0,0) + R_(m,m);
+        if (!(s > T(0))) {
+            ok = false;  // skip this row, the others are still valid
+            continue;
+        }
+        T innovation = ws_.y(m,0) - (ws_.h * ws_.dx)(0,0);
 
-    //kalman gain
-    matrix<float> Ht = transpose(H_);
-    matrix<float> S  = H_ * P_ * Ht + R_;
-    matrix<float> K  = P_ * Ht * inverse6x6(S);
+        // gain k = P*ht/s, whose entries stay below one. 1/s alone can exceed the range of a fixed
+        // point T when r is small, so P*ht*h*P/s is formed as k*(P*ht)t rather than (P*ht)*(P*ht)t/s
+        for(int i=0;i<7;++i) ws_.k.set_elt(i,0, ws_.ph(i,0) / s);
+        ws_.dx += ws_.k * innovation;
+        P_ -= make_symmetric_product(ws_.k, transpose(ws_.ph));
+    }
 
-    x_ = x_ + K * y;
+    x_ += ws_.dx;
     normalizeQuaternion();
+    return ok;
+}
 
-    matrix<float> I(7,7);
-    for(int i=0;i<7;++i)
-      for(int j=0;j<7;++j)
-        I.set_elt(i,j, (i==j?1.0f:0.0f));
-    P_ = (I - K * H_) * P_;
+template <typename T>
+void BasicEKF<T>::setUpdateMode(UpdateMode mode) {
+    updateMode_ = mode;
 }
 
+template <typename T>
+void BasicEKF<T>::setIntegrationMode(IntegrationMode mode) {
+    integrationMode_ = mode;
+}
 
-matrix<float> EKF::getQuaternion() const {
-    matrix<float> q(4,1);
-    for(int i=0;i<4;++i) q.set_elt(i,0, x_(i,0));
-    return q;
+template <typename T>
+void BasicEKF<T>::setMeasurementNoise(const symmetric_matrix<T, 6>& R) {
+    R_ = R;
+    rDiagonal_ = true;
+    for(int i=0;i<6;++i)
+      for(int j=i+1;j<6;++j)
+        if (R_(i,j) != T(0)) rDiagonal_ = false;
 }
+
+
+template <typename T>
+typename BasicEKF<T>::Quaternion BasicEKF<T>::getQuaternion() const {
+    return x_.template segment<0, 4>();
+}
+
+template <typename T>
+typename BasicEKF<T>::Vector3 BasicEKF<T>::getBias() const {
+    return x_.template segment<4, 3>();
+}
+
+template class BasicEKF<float>;
+template class BasicEKF<q4_27>;
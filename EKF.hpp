@@ -1,36 +1,97 @@
 #ifndef EKF_HPP
 #define EKF_HPP
 #include "fastmatrix.hpp"
+#include "fastmatrix_block.hpp"
+#include "fastmatrix_ldlt.hpp"
+#include "fastmatrix_fixed_point.hpp"
 using namespace fastmatrix;
-using Vector3 = matrix<float>;
+using Vector3 = fixed_matrix<float, 3, 1>;
+using Quaternion = fixed_matrix<float, 4, 1>;
 
 
-class EKF {
+// T is the scalar type of the state, the covariances and all the arithmetic: float, or a
+// fixed_point type on targets without an FPU. Members are defined in EKF.cpp, which instantiates
+// float and q4_27; the noise constants and dt stay float and are converted once at construction.
+template <typename T>
+class BasicEKF {
     public:
-        EKF(float dt);
-        void predict(const matrix<float>& gyro); //3x1 vector
-        void update(const matrix<float>& accel, const matrix<float>& mag); //both 3x1 vectors 
-        matrix<float> getBias() const;
-        matrix<float> getQuaternion() const;
-        //helpers
-        void normalizeQuaternion();
-        matrix<float> quaternionDerivative(const matrix<float>& q, const matrix<float>& omega);
-        matrix<float> expectedMeasurement(const matrix<float>& q);  // For accel + mag
+        using Scalar = T;
+        using Vector3 = fixed_matrix<T, 3, 1>;
+        using Quaternion = fixed_matrix<T, 4, 1>;
 
+        // Automatic processes the measurement one scalar at a time when R is diagonal, which needs
+        // no matrix solve and gives the same estimate as Batch; Batch always does the joint update
+        enum class UpdateMode { Automatic, Batch };
 
-    private:
-        float dt_;
-        matrix<float> x_; //7x1
-        matrix<float> P_; //7x7
-        matrix<float> Q_; //7x7
-        matrix<float> R_; //6x6
-        matrix<float> F_;   // 7x7: Jacobian of predict model
-        matrix<float> H_;   // 6x7: Jacobian of measurement model
+        // How predict turns the gyro rate into an attitude increment over the step. Exponential is
+        // exact for a constant rate; Euler is the first order q += dt*dq, which loses the cube of the
+        // angle turned per step, so it needs a higher predict rate for the same accuracy
+        enum class IntegrationMode { Exponential, Euler };
 
-        
+        static constexpr int kMaxGyroSamples = 4;  // per predict, see predict(gyro, count, dt)
 
+        // default noise model, shared with EKFBatch
+        static constexpr float kInitialVariance = 0.01f;  // P diagonal
+        static constexpr float kQuaternionNoise = 1e-6f;  // Q, quaternion
+        static constexpr float kBiasNoise       = 1e-5f;  // Q, gyro bias
+        static constexpr float kAccelNoise      = 0.01f;  // R, accelerometer
+        static constexpr float kMagNoise        = 0.02f;  // R, magnetometer
 
+        BasicEKF(float dt);
+        void predict(const Vector3& gyro); //3x1 vector
+        void predict(const Vector3& gyro, float dt); //step of dt seconds instead of the constructor's
+        //count (1 to kMaxGyroSamples) gyro samples over equal parts of a step of dt, coning compensated
+        void predict(const Vector3* gyro, int count, float dt);
+        bool update(const Vector3& accel, const Vector3& mag); //both 3x1 vectors, false if S is not SPD
+        bool updateAccel(const Vector3& accel); //a single sensor, for measurements arriving separately
+        bool updateMag(const Vector3& mag);
+        Vector3 getBias() const;
+        Quaternion getQuaternion() const;
+        void setUpdateMode(UpdateMode mode);
+        void setIntegrationMode(IntegrationMode mode);
+        void setMeasurementNoise(const symmetric_matrix<T, 6>& R);
+        //helpers
+        void normalizeQuaternion();
+        Quaternion quaternionDerivative(const Quaternion& q, const Vector3& omega);
+        fixed_matrix<T, 6, 1> expectedMeasurement(const Quaternion& q);  // For accel + mag
 
 
+    private:
+        void propagate(const Vector3& phi, T step);  // by the bias corrected rotation vector phi
+        void linearizeMeasurement();
+        bool updateBatch();
+        bool updateSequential(int first, int last);  // rows [first, last) of the measurement
+
+        T dt_;
+        UpdateMode updateMode_;
+        IntegrationMode integrationMode_;
+        bool rDiagonal_;
+        fixed_matrix<T, 7, 1> x_; //7x1
+        symmetric_matrix<T, 7> P_; //7x7, packed upper triangle
+        symmetric_matrix<T, 7> Q_; //7x7
+        symmetric_matrix<T, 6> R_; //6x6
+        // the bias rows of F are identity and the bias columns of H are zero, products skip them
+        block_matrix<T, 7, 7, 4, 4, block_kind::dense, block_kind::dense,
+                     block_kind::zero, block_kind::identity> F_;   // 7x7: Jacobian of predict model
+        block_matrix<T, 6, 7, 6, 4, block_kind::dense, block_kind::zero,
+                     block_kind::zero, block_kind::zero> H_;       // 6x7: Jacobian of measurement model
+
+        // Scratch buffers for predict/update, set up once at construction and reused every step
+        struct Workspace {
+            Vector3 omega, phi;
+            Vector3 increments[kMaxGyroSamples];
+            Quaternion dq;  // attitude increment of the step
+            fixed_matrix<T, 6, 1> z, z_pred, y;
+            symmetric_matrix<T, 6> S;
+            ldlt<T, 6> S_ldlt;
+            fixed_matrix<T, 6, 7> HP, Kt;  // H*P and the transposed gain
+            block_matrix<T, 1, 7, 1, 4, block_kind::dense, block_kind::zero,
+                         block_kind::zero, block_kind::zero> h;  // one row of H_
+            fixed_matrix<T, 7, 1> ph, k, dx;  // P*ht, the gain and the accumulated correction
+        };
+        Workspace ws_;
 };
-#endif
\ No newline at end of file
+
+using EKF = BasicEKF<float>;
+using FixedEKF = BasicEKF<q4_27>;
+#endif
@@ -0,0 +1,344 @@
+#include "EKFBatch.hpp"
+#include "matrixUtils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+// Every loop over b below runs across the kLanes filters of a block, with a trip count known at
+// compile time, which is the shape the auto-vectorizer turns into SIMD code. The arithmetic in each
+// lane is written in the same order as the scalar EKF so that both produce the same estimates.
+
+namespace {
+    constexpr std::size_t L = EKFBatch::kLanes;
+
+    // Smallest number of blocks worth handing to another thread
+    constexpr std::size_t kMinBlocksPerThread = 8;
+
+    // Same formula as matrix_utils::rotateVector
+    inline void rotate(float q0, float q1, float q2, float q3,
+                       float v0, float v1, float v2, float* r) {
+        float t2 =   q0*q1;
+        float t3 =   q0*q2;
+        float t4 =   q0*q3;
+        float t5 =  -q1*q1;
+        float t6 =   q1*q2;
+        float t7 =   q1*q3;
+        float t8 =  -q2*q2;
+        float t9 =   q2*q3;
+        float t10 = -q3*q3;
+        r[0] = 2*( (t8 + t10)*v0 + (t6 - t4)*v1 + (t3 + t7)*v2 ) + v0;
+        r[1] = 2*( (t4 + t6)*v0 + (t5 + t10)*v1 + (t9 - t2)*v2 ) + v1;
+        r[2] = 2*( (t7 - t3)*v0 + (t2 + t9)*v1 + (t5 + t8)*v2 ) + v2;
+    }
+
+    inline void normalizeLanes(float (&x)[7][L]) {
+        for(std::size_t b=0; b<L; ++b) {
+            float n = std::sqrt(x[0][b]*x[0][b] + x[1][b]*x[1][b] + x[2][b]*x[2][b] + x[3][b]*x[3][b]);
+            float d = n > 0 ? n : 1.0f;
+            for(int i=0;i<4;++i) x[i][b] = x[i][b]/d;
+        }
+    }
+}
+
+EKFBatch::EKFBatch(std::size_t count, float dt):
+    count_(count),
+    stride_((count + kLanes - 1) / kLanes * kLanes),
+    dt_(dt),
+    threads_(1),
+    data_((kStates + kCovariances) * stride_, 0.0f),
+    inputs_(6 * stride_, 0.0f),
+    job_(nullptr),
+    step_(nullptr),
+    active_(1),
+    pending_(0),
+    generation_(0),
+    stopping_(false)
+{
+    std::fill(state(0), state(0) + stride_, 1.0f);
+    for(int i=0;i<7;++i)
+      std::fill(cov(i,i), cov(i,i) + stride_, EKF::kInitialVariance);
+}
+
+float* EKFBatch::cov(int i, int j) {
+    if (i > j) std::swap(i, j);
+    return data_.data() + (kStates + i*(2*7 - i + 1)/2 + (j - i)) * stride_;
+}
+
+EKFBatch::~EKFBatch() {
+    stopWorkers();
+}
+
+// Starts the helpers once, no more than the batch can ever keep busy
+void EKFBatch::setThreadCount(unsigned threads) {
+    threads_ = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    std::size_t blocks = stride_ / kLanes;
+    std::size_t useful = std::max<std::size_t>(1, blocks / kMinBlocksPerThread);
+    std::size_t helpers = std::min<std::size_t>(threads_, useful) - 1;
+    if (helpers == workers_.size()) return;
+    stopWorkers();
+    stopping_ = false;
+    for(std::size_t w=1; w<=helpers; ++w)
+        workers_.emplace_back([this, w, start = generation_]() { workerLoop(w, start); });
+}
+
+void EKFBatch::stopWorkers() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for(auto& t : workers_) t.join();
+    workers_.clear();
+}
+
+// seen is the generation current when the helper was started, it only joins the ones after it
+void EKFBatch::workerLoop(std::size_t worker, std::uint64_t seen) {
+    for(;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&]() { return stopping_ || generation_ != seen; });
+            if (stopping_) return;
+            seen = generation_;
+            if (worker >= active_) continue;  // the step is too small to need this helper
+        }
+        runShare(worker);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--pending_ == 0) done_.notify_one();
+    }
+}
+
+// Blocks [blocks*worker/active_, blocks*(worker+1)/active_) of the current step
+void EKFBatch::runShare(std::size_t worker) {
+    std::size_t blocks = stride_ / kLanes;
+    std::size_t first = blocks * worker / active_, last = blocks * (worker + 1) / active_;
+    for(std::size_t k=first; k<last; ++k) job_(step_, k * kLanes);
+}
+
+void EKFBatch::loadInputs(const Vector3Batch* vectors, int n) {
+    for(int v=0; v<n; ++v) {
+        std::memcpy(input(3*v),   vectors[v].x, count_ * sizeof(float));
+        std::memcpy(input(3*v+1), vectors[v].y, count_ * sizeof(float));
+        std::memcpy(input(3*v+2), vectors[v].z, count_ * sizeof(float));
+    }
+}
+
+// Blocks are processed in local copies: the compiler can then see that no two arrays alias, which
+// it needs to vectorize without runtime overlap checks
+void EKFBatch::loadBlock(std::size_t base, Block& blk) {
+    for(int k=0;k<7;++k) std::memcpy(blk.x[k], state(k) + base, sizeof(blk.x[k]));
+    for(int i=0;i<7;++i)
+      for(int j=i;j<7;++j) {
+          std::memcpy(blk.P[i][j], cov(i,j) + base, sizeof(blk.P[i][j]));
+          if (j != i) std::memcpy(blk.P[j][i], blk.P[i][j], sizeof(blk.P[i][j]));
+      }
+}
+
+void EKFBatch::storeBlock(std::size_t base, const Block& blk) {
+    for(int k=0;k<7;++k) std::memcpy(state(k) + base, blk.x[k], sizeof(blk.x[k]));
+    for(int i=0;i<7;++i)
+      for(int j=i;j<7;++j) std::memcpy(cov(i,j) + base, blk.P[i][j], sizeof(blk.P[i][j]));
+}
+
+template <typename Step>
+void EKFBatch::forEachBlock(Step step) {
+    std::size_t blocks = stride_ / kLanes;
+    std::size_t workers = std::min<std::size_t>(workers_.size() + 1, blocks / kMinBlocksPerThread);
+    if (workers <= 1) {
+        for(std::size_t k=0; k<blocks; ++k) step(k * kLanes);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        job_ = [](void* s, std::size_t base) { (*static_cast<Step*>(s))(base); };
+        step_ = &step;
+        active_ = workers;
+        pending_ = workers - 1;
+        ++generation_;
+    }
+    wake_.notify_all();
+    runShare(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+void EKFBatch::predict(const Vector3Batch& gyro) {
+    loadInputs(&gyro, 1);
+    forEachBlock([this](std::size_t base) { predictBlock(base); });
+}
+
+void EKFBatch::update(const Vector3Batch& accel, const Vector3Batch& mag) {
+    const Vector3Batch vectors[2] = {accel, mag};
+    loadInputs(vectors, 2);
+    forEachBlock([this](std::size_t base) { updateBlock(base); });
+}
+
+void EKFBatch::predictBlock(std::size_t base) {
+    Block blk;
+    loadBlock(base, blk);
+    auto& x = blk.x;
+    auto& P = blk.P;
+
+    alignas(64) float w[3][L];
+    for(int c=0;c<3;++c)
+      for(std::size_t b=0;b<L;++b) w[c][b] = input(c)[base + b] - x[4+c][b];
+
+    // quaternion integration q = q*exp(w*dt/2), see EKF::propagate. The series runs on every lane,
+    // lanes turning further than it covers are redone with trig as matrix_utils::halfAngle does
+    alignas(64) float p[3][L], theta2[L], c[L], sinc[L];
+    for(std::size_t b=0;b<L;++b) {
+        const float h = 0.5f;
+        for(int k=0;k<3;++k) p[k][b] = h*(w[k][b]*dt_);
+        theta2[b] = p[0][b]*p[0][b] + p[1][b]*p[1][b] + p[2][b]*p[2][b];
+        matrix_utils::halfAngleSeries(theta2[b], c[b], sinc[b]);
+    }
+    for(std::size_t b=0;b<L;++b)
+        if (theta2[b] > matrix_utils::kHalfAngleSeriesLimit) matrix_utils::halfAngle(theta2[b], c[b], sinc[b]);
+
+    alignas(64) float M[4][4][L];
+    for(std::size_t b=0;b<L;++b) {
+        float d0 = c[b], d1 = sinc[b]*p[0][b], d2 = sinc[b]*p[1][b], d3 = sinc[b]*p[2][b];
+        M[0][0][b] = d0; M[0][1][b] = -d1; M[0][2][b] = -d2; M[0][3][b] = -d3;
+        M[1][0][b] = d1; M[1][1][b] =  d0; M[1][2][b] =  d3; M[1][3][b] = -d2;
+        M[2][0][b] = d2; M[2][1][b] = -d3; M[2][2][b] =  d0; M[2][3][b] =  d1;
+        M[3][0][b] = d3; M[3][1][b] =  d2; M[3][2][b] = -d1; M[3][3][b] =  d0;
+
+        float q0=x[0][b], q1=x[1][b], q2=x[2][b], q3=x[3][b];
+        for(int i=0;i<4;++i)
+          x[i][b] = M[i][0][b]*q0 + M[i][1][b]*q1 + M[i][2][b]*q2 + M[i][3][b]*q3;
+    }
+    normalizeLanes(x);
+
+    // top four rows of F, the bottom three are identity
+    alignas(64) float F[4][7][L];
+    const float s = -0.5f * dt_;
+    for(std::size_t b=0;b<L;++b) {
+        float q0=x[0][b], q1=x[1][b], q2=x[2][b], q3=x[3][b];
+        for(int j=0;j<4;++j) {
+            float v = q0*M[0][j][b] + q1*M[1][j][b] + q2*M[2][j][b] + q3*M[3][j][b];
+            F[0][j][b] = M[0][j][b] - q0*v;
+            F[1][j][b] = M[1][j][b] - q1*v;
+            F[2][j][b] = M[2][j][b] - q2*v;
+            F[3][j][b] = M[3][j][b] - q3*v;
+        }
+        F[0][4][b] = s*(-q1); F[0][5][b] = s*(-q2); F[0][6][b] = s*(-q3);
+        F[1][4][b] = s*( q0); F[1][5][b] = s*(-q3); F[1][6][b] = s*( q2);
+        F[2][4][b] = s*( q3); F[2][5][b] = s*( q0); F[2][6][b] = s*(-q1);
+        F[3][4][b] = s*(-q2); F[3][5][b] = s*( q1); F[3][6][b] = s*( q0);
+    }
+
+    // P = F*P*Ft + Q, upper triangle only, in the order of fastmatrix::congruence_product.
+    // Rows of F*P for the identity rows of F are rows of P, so every element still needs the old P:
+    // the result goes to a block-local copy first
+    alignas(64) float FP[4][7][L];
+    for(int i=0;i<4;++i)
+      for(int k=0;k<7;++k)
+        for(std::size_t b=0;b<L;++b) {
+            float sum = F[i][0][b] * P[0][k][b];
+            for(int j=1;j<7;++j) sum = F[i][j][b] * P[j][k][b] + sum;
+            FP[i][k][b] = sum;
+        }
+
+    alignas(64) float out[7][7][L];
+    for(int i=0;i<7;++i) {
+        auto& row = i < 4 ? FP[i] : P[i];
+        for(int l=i;l<4;++l)
+          for(std::size_t b=0;b<L;++b) {
+              float sum = row[0][b] * F[l][0][b];
+              for(int k=1;k<7;++k) sum = row[k][b] * F[l][k][b] + sum;
+              out[i][l][b] = sum;
+          }
+        for(int l=std::max(i,4);l<7;++l)
+          std::memcpy(out[i][l], row[l], sizeof(out[i][l]));
+        const float q = i < 4 ? EKF::kQuaternionNoise : EKF::kBiasNoise;
+        for(std::size_t b=0;b<L;++b) out[i][i][b] = out[i][i][b] + q;
+    }
+    for(int i=0;i<7;++i)
+      for(int l=i;l<7;++l) std::memcpy(P[i][l], out[i][l], sizeof(out[i][l]));
+    storeBlock(base, blk);
+}
+
+void EKFBatch::updateBlock(std::size_t base) {
+    Block blk;
+    loadBlock(base, blk);
+    auto& x = blk.x;
+    auto& P = blk.P;
+
+    // innovation and the four nonzero columns of H, see EKF::update
+    alignas(64) float y[6][L];
+    alignas(64) float H[6][4][L];
+    for(std::size_t b=0;b<L;++b) {
+        float q0=x[0][b], q1=x[1][b], q2=x[2][b], q3=x[3][b];
+        float a[3], m[3];
+        rotate(q0,q1,q2,q3, 0.0f,0.0f,-1.0f, a);
+        rotate(q0,q1,q2,q3, 1.0f,0.0f,0.0f, m);
+        for(int i=0;i<3;++i) {
+            y[i][b]   = input(i)[base + b]   - a[i];
+            y[i+3][b] = input(i+3)[base + b] - m[i];
+        }
+        H[0][0][b] = -2*q2; H[0][1][b] = -2*q3; H[0][2][b] = -2*q0; H[0][3][b] = -2*q1;
+        H[1][0][b] =  2*q1; H[1][1][b] =  2*q0; H[1][2][b] = -2*q3; H[1][3][b] = -2*q2;
+        H[2][0][b] = -2*q0; H[2][1][b] =  2*q1; H[2][2][b] =  2*q2; H[2][3][b] = -2*q3;
+        H[3][0][b] =  2*q0; H[3][1][b] =  2*q1; H[3][2][b] = -2*q2; H[3][3][b] = -2*q3;
+        H[4][0][b] =  2*q3; H[4][1][b] =  2*q2; H[4][2][b] =  2*q1; H[4][3][b] =  2*q0;
+        H[5][0][b] = -2*q2; H[5][1][b] =  2*q3; H[5][2][b] = -2*q0; H[5][3][b] =  2*q1;
+    }
+
+    // sequential scalar updates, see EKF::updateSequential
+    alignas(64) float dx[7][L] = {};
+    alignas(64) float ph[7][L];
+    for(int m=0;m<6;++m) {
+        const float r = m < 3 ? EKF::kAccelNoise : EKF::kMagNoise;
+        for(int k=0;k<7;++k)
+          for(std::size_t b=0;b<L;++b) {
+              float sum = P[k][0][b] * H[m][0][b];
+              for(int j=1;j<4;++j) sum = P[k][j][b] * H[m][j][b] + sum;
+              ph[k][b] = sum;
+          }
+        alignas(64) float innovation[L], s[L];
+        alignas(64) bool ok[L];
+        for(std::size_t b=0;b<L;++b) {
+            float sb = H[m][0][b] * ph[0][b];
+            for(int j=1;j<4;++j) sb += H[m][j][b] * ph[j][b];
+            s[b] = sb + r;
+            float hdx = H[m][0][b] * dx[0][b];
+            for(int j=1;j<4;++j) hdx += H[m][j][b] * dx[j][b];
+            innovation[b] = y[m][b] - hdx;
+
+            // a lane with a non-positive s skips this row, like the scalar filter
+            ok[b] = s[b] > 0.0f;
+            s[b] = ok[b] ? s[b] : 1.0f;
+        }
+        alignas(64) float gain[7][L];
+        for(int k=0;k<7;++k)
+          for(std::size_t b=0;b<L;++b) {
+              gain[k][b] = ph[k][b] / s[b];
+              dx[k][b] = dx[k][b] + (ok[b] ? gain[k][b] * innovation[b] : 0.0f);
+          }
+        for(int i=0;i<7;++i)
+          for(int j=i;j<7;++j)
+            for(std::size_t b=0;b<L;++b) {
+                float p = P[i][j][b] - gain[i][b] * ph[j][b];
+                P[i][j][b] = ok[b] ? p : P[i][j][b];
+                P[j][i][b] = P[i][j][b];  // the next row reads the lower triangle
+            }
+    }
+
+    for(int k=0;k<7;++k)
+      for(std::size_t b=0;b<L;++b) x[k][b] = x[k][b] + dx[k][b];
+    normalizeLanes(x);
+    storeBlock(base, blk);
+}
+
+Quaternion EKFBatch::getQuaternion(std::size_t filter) const {
+    Quaternion q;
+    for(int i=0;i<4;++i) q.set_elt(i,0, state(i)[filter]);
+    return q;
+}
+
+Vector3 EKFBatch::getBias(std::size_t filter) const {
+    Vector3 b;
+    for(int i=0;i<3;++i) b.set_elt(i,0, state(i+4)[filter]);
+    return b;
+}
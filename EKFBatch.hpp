@@ -0,0 +1,80 @@
+#ifndef EKF_BATCH_HPP
+#define EKF_BATCH_HPP
+#include "BatchLayout.hpp"
+#include "EKF.hpp"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Runs many independent EKF instances in structure-of-arrays layout: element k of every filter's
+// state (and element (i,j) of every covariance) sits in one contiguous array, so each arithmetic
+// step of the filter is a loop over filters that the compiler turns into SIMD lanes. Large batches
+// are split across threads, which are started once by setThreadCount and reused by every step.
+//
+// Every filter uses the EKF defaults (initial state, P, Q and a diagonal R) and the sequential
+// measurement update, and produces the same estimates as a scalar EKF in UpdateMode::Automatic
+// and IntegrationMode::Exponential.
+class EKFBatch {
+    public:
+        static constexpr std::size_t kLanes = kBatchLanes;  // filters processed together in one block
+
+        EKFBatch(std::size_t count, float dt);
+        ~EKFBatch();
+        EKFBatch(const EKFBatch&) = delete;
+        EKFBatch& operator=(const EKFBatch&) = delete;
+        void predict(const Vector3Batch& gyro);  // one reading per filter, arrays of length size()
+        void update(const Vector3Batch& accel, const Vector3Batch& mag);
+        std::size_t size() const { return count_; }
+        Quaternion getQuaternion(std::size_t filter) const;
+        Vector3 getBias(std::size_t filter) const;
+        void setThreadCount(unsigned threads);  // 0 uses every hardware thread
+
+    private:
+        static constexpr int kStates = 7;
+        static constexpr int kCovariances = 28;  // packed upper triangle of the 7x7 P
+
+        // One block of filters, with the full P so that either triangle can be read
+        struct Block {
+            alignas(64) float x[kStates][kLanes];
+            alignas(64) float P[kStates][kStates][kLanes];
+        };
+
+        float* state(int k) { return data_.data() + k * stride_; }
+        const float* state(int k) const { return data_.data() + k * stride_; }
+        float* cov(int i, int j);
+        float* input(int k) { return inputs_.data() + k * stride_; }
+        void loadInputs(const Vector3Batch* vectors, int n);
+        template <typename Step>
+        void forEachBlock(Step step);
+        void loadBlock(std::size_t base, Block& blk);
+        void storeBlock(std::size_t base, const Block& blk);
+        void predictBlock(std::size_t base);
+        void updateBlock(std::size_t base);
+        void stopWorkers();
+        void workerLoop(std::size_t worker, std::uint64_t seen);
+        void runShare(std::size_t worker);
+
+        std::size_t count_;
+        std::size_t stride_;  // count_ rounded up to kLanes
+        float dt_;
+        unsigned threads_;
+        std::vector<float> data_;    // 7 state arrays, then 28 covariance arrays
+        std::vector<float> inputs_;  // sensor readings padded to stride_
+
+        // Helper threads 1..workers_.size() sleep until forEachBlock starts a new generation, run
+        // their share of its blocks through job_ and the last one to finish wakes the caller
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable wake_, done_;
+        void (*job_)(void* step, std::size_t base);
+        void* step_;
+        std::size_t active_;   // threads sharing the current step, the caller included
+        std::size_t pending_;  // helpers that have not finished it yet
+        std::uint64_t generation_;
+        bool stopping_;
+};
+#endif
@@ -0,0 +1,192 @@
+#ifndef FILTER_THREAD_HPP
+#define FILTER_THREAD_HPP
+#include "LogReplay.hpp"
+#include "SpscRing.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Runs an EKF or MEKF on a thread of its own, fed by a sensor acquisition thread through a wait-free
+// SpscRing, so jitter of the sensor I/O and the filter's compute time no longer delay each other.
+//  - the acquisition thread push()es SensorRecords; a full ring drops the record and counts an overrun
+//  - the filter thread drains the ring in batches of up to maxBatch, applies them in order as
+//    replayLog does, and publishes the estimate after every batch for estimate() on any thread
+//  - an empty ring puts the filter thread to sleep for pollInterval
+// A record waits at most pollInterval plus the time to filter a full ring before it is applied,
+// Capacity trades that bound against how long a stall of the filter can last without drops. The
+// wait of every record is measured and those over latencyBound are counted.
+//
+//   EKF filter(0.01f);
+//   FilterThread<EKF> thread(filter, 0.01f);
+//   thread.start();
+//   ... thread.push(record) from the acquisition thread, thread.estimate() from anywhere ...
+//   thread.stop();
+template <typename Filter, std::size_t Capacity = 256>
+class FilterThread {
+    public:
+        struct Config {
+            std::size_t maxBatch = 32;                          // records between two publications
+            std::chrono::nanoseconds pollInterval{100000};      // 0.1 ms
+            std::chrono::nanoseconds latencyBound{2000000};     // 2 ms, from push to applied
+        };
+
+        struct Stats {
+            std::uint64_t pushed = 0;
+            std::uint64_t overruns = 0;       // records dropped because the ring was full
+            std::uint64_t applied = 0;
+            std::uint64_t batches = 0;
+            std::uint64_t largestBatch = 0;
+            std::uint64_t lateRecords = 0;    // applied more than latencyBound after their push
+            std::uint64_t maxLatencyNs = 0;
+            std::uint64_t rejectedUpdates = 0;
+        };
+
+        // the filter belongs to the thread between start and stop
+        FilterThread(Filter& filter, float nominalDt, const Config& config = Config()):
+            feeder_(filter, nominalDt),
+            config_(config),
+            batch_(config.maxBatch ? config.maxBatch : 1),
+            running_(false),
+            sequence_(0)
+        {
+            publish(0);
+        }
+        ~FilterThread() { stop(); }
+        FilterThread(const FilterThread&) = delete;
+        FilterThread& operator=(const FilterThread&) = delete;
+
+        void start() {
+            if (thread_.joinable()) return;
+            running_.store(true, std::memory_order_release);
+            thread_ = std::thread([this]() { run(); });
+        }
+
+        // applies what is still queued, then joins the filter thread
+        void stop() {
+            if (!thread_.joinable()) return;
+            running_.store(false, std::memory_order_release);
+            thread_.join();
+        }
+
+        // acquisition thread only, wait-free; false if the record was dropped as an overrun
+        bool push(const sensor_log::SensorRecord& record) {
+            Item item{record, now()};
+            if (!ring_.push(item)) return false;
+            pushed_.store(pushed_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // any thread: attitude and bias after the last applied batch, stamped with its last record
+        sensor_log::TrajectoryRecord estimate() const {
+            std::uint64_t words[kEstimateWords];
+            std::uint32_t before, after;
+            do {
+                before = sequence_.load(std::memory_order_acquire);
+                for(std::size_t i=0; i<kEstimateWords; ++i) words[i] = estimate_[i].load(std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_acquire);
+                after = sequence_.load(std::memory_order_relaxed);
+            } while ((before & 1) || before != after);
+            sensor_log::TrajectoryRecord record;
+            std::memcpy(&record, words, sizeof(record));
+            return record;
+        }
+
+        // any thread, each counter read on its own
+        Stats stats() const {
+            Stats s;
+            s.pushed = pushed_.load(std::memory_order_relaxed);
+            s.overruns = ring_.overruns();
+            s.applied = counters_[kApplied].load(std::memory_order_relaxed);
+            s.batches = counters_[kBatches].load(std::memory_order_relaxed);
+            s.largestBatch = counters_[kLargestBatch].load(std::memory_order_relaxed);
+            s.lateRecords = counters_[kLate].load(std::memory_order_relaxed);
+            s.maxLatencyNs = counters_[kMaxLatency].load(std::memory_order_relaxed);
+            s.rejectedUpdates = counters_[kRejected].load(std::memory_order_relaxed);
+            return s;
+        }
+
+        // filter thread only once started
+        const sensor_log::ReplayStats& feederStats() const { return feeder_.stats(); }
+
+    private:
+        struct Item {
+            sensor_log::SensorRecord record;
+            std::int64_t pushedNs;
+        };
+
+        // counters written by the filter thread alone
+        enum Counter { kApplied, kBatches, kLargestBatch, kLate, kMaxLatency, kRejected, kCounters };
+
+        static constexpr std::size_t kEstimateWords = (sizeof(sensor_log::TrajectoryRecord) + 7) / 8;
+
+        static std::int64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        void add(Counter c, std::uint64_t n) {
+            counters_[c].store(counters_[c].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+        void raise(Counter c, std::uint64_t n) {
+            if (n > counters_[c].load(std::memory_order_relaxed)) counters_[c].store(n, std::memory_order_relaxed);
+        }
+
+        void run() {
+            for(;;) {
+                // read before popping, so nothing pushed ahead of stop() is left behind
+                bool running = running_.load(std::memory_order_acquire);
+                std::size_t n = ring_.pop(batch_.data(), batch_.size());
+                if (n == 0) {
+                    if (!running) return;
+                    std::this_thread::sleep_for(config_.pollInterval);
+                    continue;
+                }
+
+                std::uint64_t rejected = 0;
+                for(std::size_t i=0; i<n; ++i)
+                    if (!feeder_.apply(batch_[i].record)) ++rejected;
+                publish(batch_[n-1].record.timeUs);
+
+                // one clock read per batch, the first record waited longest
+                std::int64_t done = now(), bound = config_.latencyBound.count();
+                std::uint64_t late = 0;
+                for(std::size_t i=0; i<n; ++i)
+                    if (done - batch_[i].pushedNs > bound) ++late;
+                add(kApplied, n);
+                add(kBatches, 1);
+                add(kLate, late);
+                add(kRejected, rejected);
+                raise(kLargestBatch, n);
+                raise(kMaxLatency, std::uint64_t(done - batch_[0].pushedNs));
+            }
+        }
+
+        // seqlock: odd while the words are being written, readers retry until they see an even
+        // sequence that didn't change across their copy
+        void publish(std::uint64_t timeUs) {
+            sensor_log::TrajectoryRecord record = feeder_.estimate(timeUs);
+            std::uint64_t words[kEstimateWords] = {};
+            std::memcpy(words, &record, sizeof(record));
+            std::uint32_t s = sequence_.load(std::memory_order_relaxed);
+            sequence_.store(s + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            for(std::size_t i=0; i<kEstimateWords; ++i) estimate_[i].store(words[i], std::memory_order_relaxed);
+            sequence_.store(s + 2, std::memory_order_release);
+        }
+
+        sensor_log::RecordFeeder<Filter> feeder_;
+        Config config_;
+        std::vector<Item> batch_;
+        SpscRing<Item, Capacity> ring_;
+        std::atomic<bool> running_;
+        std::thread thread_;
+
+        alignas(64) std::atomic<std::uint64_t> pushed_{0};  // acquisition thread's line
+        alignas(64) std::atomic<std::uint64_t> counters_[kCounters] = {};
+        std::atomic<std::uint32_t> sequence_;
+        std::atomic<std::uint64_t> estimate_[kEstimateWords] = {};
+};
+#endif
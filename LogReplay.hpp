@@ -0,0 +1,108 @@
+#ifndef LOG_REPLAY_HPP
+#define LOG_REPLAY_HPP
+#include "EKF.hpp"
+#include "SensorLog.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Runs the records of a sensor log through an EKF or MEKF as fast as the filter goes, straight out of
+// the mapping. Records are taken in file order:
+//  - a gyro reading predicts over the time since the previous one (the log's nominalDt for the first)
+//  - accel and mag then update, jointly when the record holds both
+// so readings of different sensors should share records or be logged in time order; logs of sensors
+// delivered out of order belong in a MeasurementScheduler instead.
+//
+//   MappedLog log;  log.open<SensorRecord>(path);
+//   EKF filter(log.header().nominalDt);
+//   ReplayStats stats = replayLog(log, filter, &trajectory);
+namespace sensor_log {
+    struct ReplayStats {
+        std::size_t records = 0;
+        std::size_t predicts = 0;
+        std::size_t updates = 0;
+        std::size_t rejectedUpdates = 0;  // the filter skipped a measurement
+        double logSeconds = 0.0;          // time spanned by the records
+    };
+
+    // The step of replayLog for one record, for feeding records that arrive some other way
+    template <typename Filter>
+    class RecordFeeder {
+        public:
+            // the first gyro reading predicts over nominalDt
+            RecordFeeder(Filter& filter, float nominalDt):
+                filter_(filter),
+                nominalUs_(std::int64_t(double(nominalDt) * 1e6 + 0.5)),
+                started_(false),
+                lastGyro_(0)
+            {}
+
+            // false if an update rejected a measurement
+            bool apply(const SensorRecord& r) {
+                // signed, a log may start at time 0
+                std::int64_t t = std::int64_t(r.timeUs);
+                if (!started_) {
+                    lastGyro_ = t - nominalUs_;
+                    started_ = true;
+                }
+                if ((r.flags & SensorRecord::kGyro) && t > lastGyro_) {
+                    filter_.predict(vector(r.gyro), float(double(t - lastGyro_) * 1e-6));
+                    lastGyro_ = t;
+                    ++stats_.predicts;
+                }
+
+                bool accel = r.flags & SensorRecord::kAccel, mag = r.flags & SensorRecord::kMag;
+                bool ok = true;
+                if (accel && mag) ok = filter_.update(vector(r.accel), vector(r.mag));
+                else if (accel) ok = filter_.updateAccel(vector(r.accel));
+                else if (mag) ok = filter_.updateMag(vector(r.mag));
+                if (accel || mag) ++stats_.updates;
+                if (!ok) ++stats_.rejectedUpdates;
+                ++stats_.records;
+                return ok;
+            }
+
+            // the filter state as a trajectory record stamped timeUs
+            TrajectoryRecord estimate(std::uint64_t timeUs, bool ok = true) const {
+                TrajectoryRecord estimate{};
+                estimate.timeUs = timeUs;
+                estimate.flags = ok ? 0u : std::uint32_t(TrajectoryRecord::kRejected);
+                Quaternion q = filter_.getQuaternion();
+                Vector3 bias = filter_.getBias();
+                for(int j=0;j<4;++j) estimate.q[j] = q(j,0);
+                for(int j=0;j<3;++j) estimate.bias[j] = bias(j,0);
+                return estimate;
+            }
+
+            const ReplayStats& stats() const { return stats_; }
+
+        private:
+            static Vector3 vector(const float* v) {
+                Vector3 r;
+                for(int i=0;i<3;++i) r.set_elt(i,0, v[i]);
+                return r;
+            }
+
+            Filter& filter_;
+            std::int64_t nominalUs_;
+            bool started_;
+            std::int64_t lastGyro_;
+            ReplayStats stats_;
+    };
+
+    // trajectory, if given, gets one TrajectoryRecord per sensor record
+    template <typename Filter>
+    ReplayStats replayLog(const MappedLog& log, Filter& filter, LogWriter* trajectory = nullptr) {
+        const SensorRecord* records = log.records<SensorRecord>();
+        std::size_t count = log.size();
+        RecordFeeder<Filter> feeder(filter, log.header().nominalDt);
+        for(std::size_t i=0; i<count; ++i) {
+            bool ok = feeder.apply(records[i]);
+            if (trajectory) trajectory->append(feeder.estimate(records[i].timeUs, ok));
+        }
+
+        ReplayStats stats = feeder.stats();
+        if (count) stats.logSeconds = double(records[count-1].timeUs - records[0].timeUs) * 1e-6 + log.header().nominalDt;
+        return stats;
+    }
+}
+#endif
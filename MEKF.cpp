@@ -0,0 +1,166 @@
+#include "MEKF.hpp"
+#include "matrixUtils.hpp"
+#include <cmath>
+
+#ifdef EKF_CHECK_ALLOCATIONS
+#include "allocationHook.hpp"
+#define EKF_EXPECT_NO_ALLOCATIONS() allocation_hook::ExpectNone expectNoAllocations_
+#else
+#define EKF_EXPECT_NO_ALLOCATIONS()
+#endif
+
+using namespace matrix_utils;
+
+namespace {
+    // the matrix applied by rotateVector, R = I + 2*T
+    fixed_matrix<float, 3, 3> rotationMatrix(const quat& q) {
+        float q0=q.w(), q1=q.x(), q2=q.y(), q3=q.z();
+        fixed_matrix<float, 3, 3> R;
+        R.set_elt(0,0, 1 - 2*(q2*q2 + q3*q3)); R.set_elt(0,1, 2*(q1*q2 - q0*q3));     R.set_elt(0,2, 2*(q0*q2 + q1*q3));
+        R.set_elt(1,0, 2*(q0*q3 + q1*q2));     R.set_elt(1,1, 1 - 2*(q1*q1 + q3*q3)); R.set_elt(1,2, 2*(q2*q3 - q0*q1));
+        R.set_elt(2,0, 2*(q1*q3 - q0*q2));     R.set_elt(2,1, 2*(q0*q1 + q2*q3));     R.set_elt(2,2, 1 - 2*(q1*q1 + q2*q2));
+        return R;
+    }
+
+    // rows [row, row+3) of H: d(R(q*dq)*v)/d(dtheta) = -R*[v x]
+    void measurementJacobian(const fixed_matrix<float, 3, 3>& R, float v0, float v1, float v2,
+                             int row, MEKF::MeasurementJacobian& H) {
+        // columns of [v x]
+        const float c[3][3] = {{0.0f, v2, -v1}, {-v2, 0.0f, v0}, {v1, -v0, 0.0f}};
+        for(int i=0;i<3;++i)
+          for(int j=0;j<3;++j)
+            H.set_elt(row+i, j, -(R(i,0)*c[j][0] + R(i,1)*c[j][1] + R(i,2)*c[j][2]));
+    }
+}
+
+MEKF::MEKF(float dt):
+    dt_(dt),
+    P_(6, 6),
+    Q_(6, 6),
+    F_(6, 6),
+    H_(6, 6)
+{
+    for(int i=0;i<6;++i){
+      P_.set_elt(i,i, i<3? kInitialAttitudeVariance : kInitialBiasVariance);
+      Q_.set_elt(i,i, i<3? kAttitudeNoise : kBiasNoise);
+      r_.set_elt(i,0, i<3? kAccelNoise : kMagNoise);
+    }
+}
+
+void MEKF::predict(const Vector3& gyro) {
+    predict(gyro, dt_);
+}
+
+void MEKF::predict(const Vector3& gyro, float dt) {
+    FASTMATRIX_SCOPE("mekf.predict");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.omega = gyro - b_;
+    ws_.phi = ws_.omega * dt;
+    propagate(dt);
+}
+
+void MEKF::predict(const Vector3* gyro, int count, float dt) {
+    FASTMATRIX_SCOPE("mekf.predict");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    if (count < 1 || count > kMaxGyroSamples) return;
+    float part = dt / count;
+    for(int i=0;i<count;++i) ws_.increments[i] = (gyro[i] - b_) * part;
+    ws_.phi = coningRotationVector(ws_.increments, count);
+    propagate(dt);
+}
+
+void MEKF::propagate(float dt) {
+    FASTMATRIX_SCOPE("mekf.propagate");
+    float kx=ws_.phi(0,0), ky=ws_.phi(1,0), kz=ws_.phi(2,0);
+
+    // q = q * exp(phi/2), exact for a constant rate over the step
+    q_ = normalize(q_ * exp(vec3(kx, ky, kz)));
+
+    // dtheta block of F: exp(-[phi x]), by Rodrigues' formula
+    float angle = std::sqrt(kx*kx + ky*ky + kz*kz);
+    float a = 1.0f, b = 0.5f;
+    if (angle > 1e-4f) {
+        a = std::sin(angle) / angle;
+        b = (1.0f - std::cos(angle)) / (angle*angle);
+    }
+    const float K[3][3] = {{0.0f, -kz, ky}, {kz, 0.0f, -kx}, {-ky, kx, 0.0f}};
+    for(int i=0;i<3;++i)
+      for(int j=0;j<3;++j) {
+          float k2 = K[i][0]*K[0][j] + K[i][1]*K[1][j] + K[i][2]*K[2][j];
+          F_.set_elt(i,j, (i==j ? 1.0f : 0.0f) - a*K[i][j] + b*k2);
+      }
+    for(int i=0;i<3;++i) F_.set_elt(i, i+3, -dt);  // dtheta picks up the bias error
+
+    // covariances are symmetric, only their upper triangles are computed. Q_ is the noise of a
+    // step of dt_, other steps get it in proportion to their length
+    P_ = congruence(F_, P_) + Q_ * (dt / dt_);
+}
+
+// R is diagonal, so the six measurements are applied one scalar at a time as in EKF::updateSequential,
+// then the accumulated error is folded into the quaternion and bias and reset to zero
+bool MEKF::update(const Vector3& accel, const Vector3& mag) {
+    FASTMATRIX_SCOPE("mekf.update");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.z.segment<0, 3>() = accel;
+    ws_.z.segment<3, 3>() = mag;
+    return updateRows(0, 6);
+}
+
+bool MEKF::updateAccel(const Vector3& accel) {
+    FASTMATRIX_SCOPE("mekf.update");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.z.segment<0, 3>() = accel;
+    return updateRows(0, 3);
+}
+
+bool MEKF::updateMag(const Vector3& mag) {
+    FASTMATRIX_SCOPE("mekf.update");
+    EKF_EXPECT_NO_ALLOCATIONS();
+    ws_.z.segment<3, 3>() = mag;
+    return updateRows(3, 6);
+}
+
+bool MEKF::updateRows(int first, int last) {
+    FASTMATRIX_SCOPE("mekf.update_rows");
+    const vec3 g(0.0f, 0.0f, -1.0f), m(1.0f, 0.0f, 0.0f);
+
+    vec3 a = rotate(q_, g);
+    vec3 b = rotate(q_, m);
+    ws_.y.segment<0, 3>() = ws_.z.segment<0, 3>() - a.matrix();
+    ws_.y.segment<3, 3>() = ws_.z.segment<3, 3>() - b.matrix();
+
+    fixed_matrix<float, 3, 3> R = rotationMatrix(q_);
+    measurementJacobian(R, g.x(), g.y(), g.z(), 0, H_);
+    measurementJacobian(R, m.x(), m.y(), m.z(), 3, H_);
+
+    bool ok = true;
+    for(int i=0;i<6;++i) ws_.dx.set_elt(i,0, 0.0f);
+
+    for(int k=first;k<last;++k) {
+        for(int j=0;j<3;++j) ws_.h.set_elt(0,j, H_(k,j));
+        // P is symmetric, so P*ht = transpose(h*P), which lets the product skip the zeros of h
+        ws_.ph = transpose(ws_.h * P_);
+        float s = (ws_.h * ws_.ph)(0,0) + r_(k,0);
+        if (!(s > 0.0f)) {
+            ok = false;  // skip this row, the others are still valid
+            continue;
+        }
+        float innovation = ws_.y(k,0) - (ws_.h * ws_.dx)(0,0);
+
+        ws_.dx += ws_.ph * (innovation / s);
+        P_ -= make_symmetric_product(ws_.ph, transpose(ws_.ph)) * (1.0f / s);
+    }
+
+    // reset: q = q * dq(dtheta), the first-order reset Jacobian on P is left out
+    q_ = normalize(q_ * quat(1.0f, 0.5f*ws_.dx(0,0), 0.5f*ws_.dx(1,0), 0.5f*ws_.dx(2,0)));
+    b_ += ws_.dx.segment<3, 3>();
+    return ok;
+}
+
+Quaternion MEKF::getQuaternion() const {
+    return q_.matrix();
+}
+
+Vector3 MEKF::getBias() const {
+    return b_;
+}
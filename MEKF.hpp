@@ -0,0 +1,64 @@
+#ifndef MEKF_HPP
+#define MEKF_HPP
+#include "EKF.hpp"
+#include "quaternion.hpp"
+
+// Multiplicative (error-state) variant of EKF with the same interface. The quaternion is kept
+// outside the filter state and corrected by composition, q = q_est * dq(dtheta), so the filter only
+// estimates the 3-dof attitude error dtheta and the 3-dof gyro bias: P is 6x6 and has no direction
+// along the quaternion norm, which needs no renormalization fix-up after each step.
+class MEKF {
+    public:
+        using Vector3 = ::Vector3;
+
+        // default noise model, per step like EKF's
+        static constexpr float kInitialAttitudeVariance = 4 * EKF::kInitialVariance;  // rad^2, dtheta ~ 2*dq
+        static constexpr float kInitialBiasVariance     = EKF::kInitialVariance;
+        static constexpr float kAttitudeNoise           = 4 * EKF::kQuaternionNoise;
+        static constexpr float kBiasNoise               = EKF::kBiasNoise;
+        static constexpr float kAccelNoise              = EKF::kAccelNoise;
+        static constexpr float kMagNoise                = EKF::kMagNoise;
+        static constexpr int kMaxGyroSamples            = EKF::kMaxGyroSamples;
+
+        // the bias rows of F are identity and the bias columns of H are zero, products skip them
+        using Transition = block_matrix<float, 6, 6, 3, 3, block_kind::dense, block_kind::dense,
+                                        block_kind::zero, block_kind::identity>;
+        using MeasurementJacobian = block_matrix<float, 6, 6, 6, 3, block_kind::dense, block_kind::zero,
+                                                 block_kind::zero, block_kind::zero>;
+
+        MEKF(float dt);
+        void predict(const Vector3& gyro); //3x1 vector
+        void predict(const Vector3& gyro, float dt); //step of dt seconds instead of the constructor's
+        //count (1 to kMaxGyroSamples) gyro samples over equal parts of a step of dt, coning compensated
+        void predict(const Vector3* gyro, int count, float dt);
+        bool update(const Vector3& accel, const Vector3& mag); //both 3x1 vectors, false if a row was rejected
+        bool updateAccel(const Vector3& accel); //a single sensor, for measurements arriving separately
+        bool updateMag(const Vector3& mag);
+        Vector3 getBias() const;
+        Quaternion getQuaternion() const;
+
+    private:
+        void propagate(float dt);  // by the bias corrected rotation vector in ws_.phi
+        bool updateRows(int first, int last);  // rows [first, last) of the measurement in ws_.z
+
+        float dt_;
+        matrix_utils::quat q_;           // attitude estimate, unit norm
+        Vector3 b_;                      // gyro bias estimate
+        symmetric_matrix<float, 6> P_;   // covariance of (dtheta, dbias)
+        symmetric_matrix<float, 6> Q_;
+        fixed_matrix<float, 6, 1> r_;    // diagonal of R
+        Transition F_;                   // error-state transition
+        MeasurementJacobian H_;          // 6x6: Jacobian of measurement model wrt the error state
+
+        // Scratch buffers for predict/update, set up once at construction and reused every step
+        struct Workspace {
+            Vector3 omega, phi;
+            Vector3 increments[kMaxGyroSamples];
+            fixed_matrix<float, 6, 1> z, y;
+            block_matrix<float, 1, 6, 1, 3, block_kind::dense, block_kind::zero,
+                         block_kind::zero, block_kind::zero> h;  // one row of H_
+            fixed_matrix<float, 6, 1> ph, dx;  // P*ht and the accumulated correction
+        };
+        Workspace ws_;
+};
+#endif
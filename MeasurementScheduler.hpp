@@ -0,0 +1,181 @@
+#ifndef MEASUREMENT_SCHEDULER_HPP
+#define MEASUREMENT_SCHEDULER_HPP
+#include "EKF.hpp"
+#include <cstddef>
+
+// Front end for sensors sampled at different rates and delivered out of order, for EKF, FixedEKF or
+// MEKF.
+// Timestamped samples wait in a small buffer sorted by time and are applied once they are older
+// than the reorder window, so a sample arriving up to that much late still lands in order:
+//  - a gyro sample is the rate over the interval ending at its timestamp, the filter predicts up to it
+//  - an accel or mag sample predicts up to its timestamp with the rate of the gyro sample whose
+//    interval covers it, or the last rate when that one has not arrived yet, then updates with that
+//    sensor alone, or with both when the other one follows within the joint window
+// Predictions longer than maxDt (gyro dropouts) are split into several steps.
+//
+//   MEKF filter(0.001f);
+//   MeasurementScheduler<MEKF> scheduler(filter);
+//   scheduler.addGyro(t, gyro); ...; scheduler.process(now);
+template <typename Filter, std::size_t Capacity = 32>
+class MeasurementScheduler {
+    public:
+        using Vector3 = typename Filter::Vector3;
+
+        enum class Sensor { Gyro, Accel, Mag };  // also the order of samples with equal timestamps
+
+        struct Config {
+            double reorderWindow = 0.005;  // s, how long a sample is held back for late ones
+            double jointWindow   = 0.001;  // s, accel and mag closer than this make one update
+            float maxDt          = 0.01f;  // s, longest single prediction step
+        };
+
+        struct Stats {
+            unsigned long predicts = 0;
+            unsigned long accelUpdates = 0;
+            unsigned long magUpdates = 0;
+            unsigned long jointUpdates = 0;
+            unsigned long rejectedUpdates = 0;   // the filter skipped a measurement row
+            unsigned long lateSamples = 0;       // older than the filter time, dropped
+            unsigned long overflowReleases = 0;  // applied early because the buffer was full
+        };
+
+        explicit MeasurementScheduler(Filter& filter, const Config& config = Config()):
+            filter_(filter),
+            config_(config),
+            count_(0),
+            started_(false),
+            time_(0.0)
+        {}
+
+        // false if the sample is older than the filter time and was dropped
+        bool addGyro(double t, const Vector3& rate) { return add(t, Sensor::Gyro, rate); }
+        bool addAccel(double t, const Vector3& accel) { return add(t, Sensor::Accel, accel); }
+        bool addMag(double t, const Vector3& mag) { return add(t, Sensor::Mag, mag); }
+
+        // applies the samples taken at or before now - reorderWindow
+        void process(double now) {
+            double cutoff = now - config_.reorderWindow;
+            while (count_ > 0 && buffer_[0].t <= cutoff) release(cutoff);
+        }
+
+        // applies every buffered sample, e.g. at the end of a log
+        void flush() {
+            while (count_ > 0) release(buffer_[count_-1].t);
+        }
+
+        double filterTime() const { return time_; }
+        std::size_t pending() const { return count_; }
+        const Stats& stats() const { return stats_; }
+
+    private:
+        struct Sample {
+            double t;
+            Sensor sensor;
+            Vector3 value;
+        };
+
+        bool add(double t, Sensor sensor, const Vector3& value) {
+            if (started_ && t < time_) {
+                ++stats_.lateSamples;
+                return false;
+            }
+            if (count_ == Capacity) {
+                ++stats_.overflowReleases;
+                release(buffer_[0].t);
+                if (t < time_) {  // the forced release may have moved the filter past this sample
+                    ++stats_.lateSamples;
+                    return false;
+                }
+            }
+
+            // insertion sort from the back, samples mostly arrive in order
+            std::size_t i = count_++;
+            while (i > 0 && before(t, sensor, buffer_[i-1])) {
+                buffer_[i] = buffer_[i-1];
+                --i;
+            }
+            buffer_[i].t = t;
+            buffer_[i].sensor = sensor;
+            buffer_[i].value = value;
+            return true;
+        }
+
+        static bool before(double t, Sensor sensor, const Sample& s) {
+            return t < s.t || (t == s.t && sensor < s.sensor);
+        }
+
+        // applies the oldest sample, pairing an accel or mag with the next sample when that is the
+        // other sensor within the joint window and also at or before cutoff
+        void release(double cutoff) {
+            Sample s = pop();
+            if (!started_) {
+                started_ = true;
+                time_ = s.t;
+            }
+
+            if (s.sensor == Sensor::Gyro) {
+                propagate(s.t, s.value);
+                lastRate_ = s.value;
+                return;
+            }
+
+            propagate(s.t, rateAhead());
+            Sensor other = s.sensor == Sensor::Accel ? Sensor::Mag : Sensor::Accel;
+            bool ok;
+            if (count_ > 0 && buffer_[0].sensor == other && buffer_[0].t <= cutoff &&
+                buffer_[0].t - s.t <= config_.jointWindow) {
+                Sample o = pop();
+                const Vector3& accel = s.sensor == Sensor::Accel ? s.value : o.value;
+                const Vector3& mag = s.sensor == Sensor::Mag ? s.value : o.value;
+                ok = filter_.update(accel, mag);
+                ++stats_.jointUpdates;
+            } else if (s.sensor == Sensor::Accel) {
+                ok = filter_.updateAccel(s.value);
+                ++stats_.accelUpdates;
+            } else {
+                ok = filter_.updateMag(s.value);
+                ++stats_.magUpdates;
+            }
+            if (!ok) ++stats_.rejectedUpdates;
+        }
+
+        // the rate of the first buffered gyro sample, the next one after an accel or mag just popped,
+        // whose interval ends at or after it
+        const Vector3& rateAhead() const {
+            for(std::size_t i=0; i<count_; ++i)
+                if (buffer_[i].sensor == Sensor::Gyro) return buffer_[i].value;
+            return lastRate_;
+        }
+
+        Sample pop() {
+            Sample s = buffer_[0];
+            --count_;
+            for(std::size_t i=0; i<count_; ++i) buffer_[i] = buffer_[i+1];
+            return s;
+        }
+
+        // predicts from the filter time up to t at a constant rate
+        void propagate(double t, const Vector3& rate) {
+            while (t > time_) {
+                float dt = float(t - time_);
+                if (dt > config_.maxDt) {
+                    dt = config_.maxDt;
+                    time_ += dt;
+                } else {
+                    time_ = t;
+                }
+                filter_.predict(rate, dt);
+                ++stats_.predicts;
+            }
+        }
+
+        Filter& filter_;
+        Config config_;
+        Sample buffer_[Capacity];  // sorted by time, then by sensor
+        std::size_t count_;
+        bool started_;
+        double time_;              // time of the filter state
+        Vector3 lastRate_;         // rate of the last applied gyro sample, zero before the first
+        Stats stats_;
+};
+#endif
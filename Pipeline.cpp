@@ -0,0 +1,135 @@
+#include "Pipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace pipeline {
+    namespace {
+        std::int64_t now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    bool pinCurrentThread(int cpu) {
+#if defined(__linux__)
+        int cores = int(std::max(1u, std::thread::hardware_concurrency()));
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(((cpu % cores) + cores) % cores, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)cpu;
+        return false;
+#endif
+    }
+
+    Pipeline::Pipeline(int firstCpu): firstCpu_(firstCpu) {}
+
+    Pipeline::~Pipeline() {}
+
+    void Pipeline::setSource(const std::string& name, Source source) {
+        source_ = std::move(source);
+        if (stats_.stages.empty()) stats_.stages.emplace_back();
+        stats_.stages[0].name = name;
+    }
+
+    void Pipeline::addStage(const std::string& name, Stage stage) {
+        if (stats_.stages.empty()) stats_.stages.emplace_back();
+        stages_.push_back(std::move(stage));
+        stats_.stages.emplace_back();
+        stats_.stages.back().name = name;
+    }
+
+    bool Pipeline::run() {
+        if (!source_ || stages_.empty()) return false;
+        links_.clear();
+        for(std::size_t i=0; i<stages_.size(); ++i) links_.emplace_back(new Link());
+        for(auto& s : stats_.stages) {
+            std::string name = s.name;
+            s = StageStats();
+            s.name = name;
+        }
+        stats_.endToEnd = LatencyHistogram();
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        threads.emplace_back([this]() { runSource(); });
+        for(std::size_t i=0; i<stages_.size(); ++i) threads.emplace_back([this, i]() { runStage(i); });
+        for(auto& t : threads) t.join();
+        stats_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return true;
+    }
+
+    // pushes into links_[link], waiting for room; the stage below drains it whatever happens
+    void Pipeline::forward(std::size_t link, Sample& sample, StageStats& stats) {
+        Queue& queue = links_[link]->queue;
+        sample.queuedNs = now();
+        if (queue.tryPush(sample)) return;
+        ++stats.fullWaits;
+        while (!queue.tryPush(sample)) std::this_thread::yield();
+    }
+
+    void Pipeline::runSource() {
+        StageStats& stats = stats_.stages[0];
+        if (firstCpu_ >= 0) {
+            stats.cpu = firstCpu_;
+            stats.pinned = pinCurrentThread(firstCpu_);
+        }
+
+        Sample sample{};
+        for(std::uint64_t sequence=0;; ++sequence) {
+            sample = Sample{};
+            sample.sequence = sequence;
+            std::int64_t begin = now();
+            if (!source_(sample)) break;
+            sample.createdNs = now();
+            stats.service.record(sample.createdNs - begin);
+            ++stats.processed;
+            forward(0, sample, stats);
+        }
+        links_[0]->closed.store(true, std::memory_order_release);
+    }
+
+    void Pipeline::runStage(std::size_t i) {
+        StageStats& stats = stats_.stages[i + 1];
+        if (firstCpu_ >= 0) {
+            stats.cpu = firstCpu_ + int(i) + 1;
+            stats.pinned = pinCurrentThread(stats.cpu);
+        }
+        Link& in = *links_[i];
+        bool last = i + 1 == stages_.size();
+        Sample batch[kBatch];
+
+        for(;;) {
+            // read before popping, so nothing pushed ahead of the close is left behind
+            bool closed = in.closed.load(std::memory_order_acquire);
+            std::size_t n = in.queue.pop(batch, kBatch);
+            if (n == 0) {
+                if (closed) break;
+                std::this_thread::yield();
+                continue;
+            }
+            for(std::size_t k=0; k<n; ++k) {
+                Sample& sample = batch[k];
+                std::int64_t begin = now();
+                bool keep = stages_[i](sample);
+                std::int64_t end = now();
+                stats.wait.record(begin - sample.queuedNs);
+                stats.service.record(end - begin);
+                ++stats.processed;
+                if (!keep) {
+                    ++stats.dropped;
+                    continue;
+                }
+                if (last) stats_.endToEnd.record(end - sample.createdNs);
+                else forward(i + 1, sample, stats);
+            }
+        }
+        if (!last) links_[i + 1]->closed.store(true, std::memory_order_release);
+    }
+}
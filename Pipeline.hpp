@@ -0,0 +1,101 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+#include "SensorLog.hpp"
+#include "fastmatrix_instrumentation.hpp"
+#include "SpscRing.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Host-side pipeline runtime: a source and a chain of stages, each on a thread of its own (pinned to
+// a core if asked), handing Samples down through bounded SpscRings. A full ring makes the stage above
+// wait rather than drop, so a slow stage throttles the source and every sample is accounted for.
+//
+// The time each stage spends in its function, the time samples wait in front of it and the end to end
+// time from the source to the end of the last stage are kept as latency histograms.
+//
+//   Pipeline p;
+//   p.setSource("sensors", [&](Sample& s) { ...; return more; });
+//   p.addStage("filter", [&](Sample& s) { ...; return true; });  // false drops the sample
+//   p.run();  // returns once the source is exhausted and every stage has drained
+//   p.stats();
+namespace pipeline {
+    // Everything a sample picks up on its way down; stages fill in their part
+    struct Sample {
+        std::uint32_t stream;                    // which of the interleaved streams it belongs to
+        std::uint64_t sequence;                  // position in the source's output
+        sensor_log::SensorRecord sensors;
+        sensor_log::TrajectoryRecord estimate;
+        float roll, pitch, yaw;                  // deg
+        std::int64_t createdNs;                  // set by the runtime when the source returns it
+        std::int64_t queuedNs;                   // set by the runtime when it enters a queue
+    };
+
+    // log-linear buckets, within 12.5%; one thread records, read it once that thread is done
+    using LatencyHistogram = fastmatrix::instrumentation::histogram;
+
+    struct StageStats {
+        std::string name;
+        std::uint64_t processed = 0;  // samples taken by the function
+        std::uint64_t dropped = 0;    // samples the function returned false for
+        std::uint64_t fullWaits = 0;  // times the stage found the queue below it full
+        bool pinned = false;          // the thread is bound to its core
+        int cpu = -1;
+        LatencyHistogram service;     // time inside the function
+        LatencyHistogram wait;        // time in the queue in front of the stage, none for the source
+    };
+
+    struct Stats {
+        std::vector<StageStats> stages;  // source first
+        LatencyHistogram endToEnd;       // source output to the end of the last stage, kept samples only
+        double seconds = 0.0;            // wall time of run()
+    };
+
+    class Pipeline {
+        public:
+            static constexpr std::size_t kQueueCapacity = 1024;
+            static constexpr std::size_t kBatch = 32;  // samples a stage takes off its queue at a time
+
+            using Source = std::function<bool(Sample&)>;  // false once there is nothing more
+            using Stage = std::function<bool(Sample&)>;   // false drops the sample
+
+            // the source runs on firstCpu, stage i on firstCpu + i + 1, modulo the cores; -1 leaves
+            // the threads unpinned
+            explicit Pipeline(int firstCpu = -1);
+            ~Pipeline();
+            Pipeline(const Pipeline&) = delete;
+            Pipeline& operator=(const Pipeline&) = delete;
+
+            void setSource(const std::string& name, Source source);
+            void addStage(const std::string& name, Stage stage);
+
+            // starts every thread and returns once all are done; needs a source and one stage
+            bool run();
+            const Stats& stats() const { return stats_; }
+
+        private:
+            using Queue = SpscRing<Sample, kQueueCapacity>;
+
+            struct Link {
+                Queue queue;
+                std::atomic<bool> closed{false};  // the stage above has pushed its last sample
+            };
+
+            void runSource();
+            void runStage(std::size_t i);
+            void forward(std::size_t link, Sample& sample, StageStats& stats);
+
+            int firstCpu_;
+            Source source_;
+            std::vector<Stage> stages_;
+            std::vector<std::unique_ptr<Link>> links_;  // links_[i] feeds stages_[i]
+            Stats stats_;
+    };
+
+    // Binds the calling thread to cpu (modulo the cores), false where that isn't supported
+    bool pinCurrentThread(int cpu);
+}
+#endif
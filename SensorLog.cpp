@@ -0,0 +1,120 @@
+#include "SensorLog.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace sensor_log {
+    namespace {
+        // stdio buffer of a writer, records go to the kernel in chunks of this size
+        constexpr std::size_t kWriteBuffer = 1 << 20;
+    }
+
+    MappedLog::MappedLog(): map_(nullptr), mapSize_(0), records_(nullptr), count_(0), header_{} {
+        error_[0] = '\0';
+    }
+
+    MappedLog::~MappedLog() {
+        close();
+    }
+
+    bool MappedLog::open(const char* path, RecordKind kind, std::size_t recordSize) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::snprintf(error_, sizeof(error_), "%s: %s", path, std::strerror(errno));
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(LogHeader)) {
+            ::close(fd);
+            std::snprintf(error_, sizeof(error_), "%s: too short for a log header", path);
+            return false;
+        }
+        mapSize_ = std::size_t(st.st_size);
+        map_ = mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);  // the mapping keeps the file
+        if (map_ == MAP_FAILED) {
+            map_ = nullptr;
+            std::snprintf(error_, sizeof(error_), "%s: mmap: %s", path, std::strerror(errno));
+            return false;
+        }
+        // replay reads front to back once, let the kernel read ahead and drop pages behind
+        madvise(map_, mapSize_, MADV_SEQUENTIAL);
+
+        std::memcpy(&header_, map_, sizeof(LogHeader));
+        const char* problem = nullptr;
+        std::size_t available = (mapSize_ - sizeof(LogHeader)) / (recordSize ? recordSize : 1);
+        if (std::memcmp(header_.magic, kMagic, sizeof(kMagic))) problem = "not a sensor log";
+        else if (header_.version != kVersion) problem = "unsupported log version";
+        else if (header_.kind != kind) problem = "wrong record kind";
+        else if (header_.recordSize != recordSize) problem = "record size does not match this build";
+        else if (header_.count > available) problem = "truncated";
+        if (problem) {
+            std::snprintf(error_, sizeof(error_), "%s: %s", path, problem);
+            close();
+            return false;
+        }
+
+        records_ = static_cast<const unsigned char*>(map_) + sizeof(LogHeader);
+        count_ = header_.count ? std::size_t(header_.count) : available;
+        error_[0] = '\0';
+        return true;
+    }
+
+    void MappedLog::close() {
+        if (map_) munmap(map_, mapSize_);
+        map_ = nullptr;
+        mapSize_ = 0;
+        records_ = nullptr;
+        count_ = 0;
+    }
+
+    LogWriter::LogWriter(): file_(nullptr), header_{} {
+        error_[0] = '\0';
+    }
+
+    LogWriter::~LogWriter() {
+        close();
+    }
+
+    bool LogWriter::open(const char* path, RecordKind kind, std::size_t recordSize, float nominalDt) {
+        close();
+        error_[0] = '\0';
+        file_ = std::fopen(path, "wb");
+        if (!file_) {
+            std::snprintf(error_, sizeof(error_), "%s: %s", path, std::strerror(errno));
+            return false;
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, kWriteBuffer);
+
+        header_ = LogHeader{};
+        std::memcpy(header_.magic, kMagic, sizeof(kMagic));
+        header_.version = kVersion;
+        header_.kind = kind;
+        header_.recordSize = std::uint32_t(recordSize);
+        header_.nominalDt = nominalDt;
+        // count stays 0 on disk until close, which a reader takes as "use the file size"
+        if (std::fwrite(&header_, sizeof(LogHeader), 1, file_) != 1) return fail("write failed");
+        return true;
+    }
+
+    bool LogWriter::close() {
+        if (!file_) return error_[0] == '\0';
+        bool ok = std::fseek(file_, 0, SEEK_SET) == 0 &&
+                  std::fwrite(&header_, sizeof(LogHeader), 1, file_) == 1;
+        ok = std::fclose(file_) == 0 && ok;
+        file_ = nullptr;
+        if (!ok) std::snprintf(error_, sizeof(error_), "closing the log failed");
+        return ok;
+    }
+
+    bool LogWriter::fail(const char* what) {
+        std::snprintf(error_, sizeof(error_), "%s", what);
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+}
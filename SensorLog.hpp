@@ -0,0 +1,123 @@
+#ifndef SENSOR_LOG_HPP
+#define SENSOR_LOG_HPP
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// Binary logs of fixed size records behind a small header, for replaying recorded flights through the
+// filters and storing what they estimated. The records are the in-memory structs written as they
+// are (little endian, no padding), so a log is read by mapping the file and indexing the records in
+// place: nothing is parsed or copied on the way in.
+//
+//   header (32 bytes) | record 0 | record 1 | ...
+//
+// SensorRecord logs hold the readings, TrajectoryRecord logs hold an estimate per sensor record.
+namespace sensor_log {
+    enum class RecordKind : std::uint16_t { Sensor = 1, Trajectory = 2 };
+
+    constexpr char kMagic[4] = {'G', 'S', 'L', 'G'};
+    constexpr std::uint16_t kVersion = 1;
+
+    struct LogHeader {
+        char magic[4];
+        std::uint16_t version;
+        RecordKind kind;
+        std::uint32_t recordSize;   // bytes, checked against the record struct on open
+        float nominalDt;            // s, sample period the log was recorded at
+        std::uint64_t count;        // records; 0 if the writer never closed, see MappedLog::open
+        std::uint64_t reserved;
+    };
+
+    // Readings of one sample time; flags says which of them were taken
+    struct SensorRecord {
+        static constexpr RecordKind kKind = RecordKind::Sensor;
+        enum Flags : std::uint32_t { kGyro = 1, kAccel = 2, kMag = 4 };
+
+        std::uint64_t timeUs;  // of the sample, the gyro reading is the rate over the interval ending at it
+        std::uint32_t flags;
+        float gyro[3];         // rad/s
+        float accel[3];        // g
+        float mag[3];          // field units
+    };
+
+    // Filter state after the sensor record of the same index, or the true attitude of a simulation
+    struct TrajectoryRecord {
+        static constexpr RecordKind kKind = RecordKind::Trajectory;
+        enum Flags : std::uint32_t { kRejected = 1 };  // an update of this step rejected a measurement
+
+        std::uint64_t timeUs;
+        std::uint32_t flags;
+        float q[4];            // w, x, y, z like Quaternion
+        float bias[3];         // rad/s
+    };
+
+    static_assert(sizeof(LogHeader) == 32, "LogHeader is the on-disk header");
+    static_assert(sizeof(SensorRecord) == 48, "SensorRecord is the on-disk record");
+    static_assert(sizeof(TrajectoryRecord) == 40, "TrajectoryRecord is the on-disk record");
+
+    // Read-only mapping of a log. The records stay valid until close or destruction
+    class MappedLog {
+        public:
+            MappedLog();
+            ~MappedLog();
+            MappedLog(const MappedLog&) = delete;
+            MappedLog& operator=(const MappedLog&) = delete;
+
+            // false with error() set if the file can't be mapped or isn't a log of kind/recordSize.
+            // A log with a count of 0 takes its count from the file size, so the records of a
+            // recording cut short before its writer closed are still readable
+            bool open(const char* path, RecordKind kind, std::size_t recordSize);
+            template <typename Record>
+            bool open(const char* path) { return open(path, Record::kKind, sizeof(Record)); }
+            void close();
+
+            const LogHeader& header() const { return header_; }
+            std::size_t size() const { return count_; }
+            template <typename Record>
+            const Record* records() const { return reinterpret_cast<const Record*>(records_); }
+            const char* error() const { return error_; }
+
+        private:
+            void* map_;
+            std::size_t mapSize_;
+            const unsigned char* records_;
+            std::size_t count_;
+            LogHeader header_;
+            char error_[160];
+    };
+
+    // Appends records through a large stdio buffer and writes the count into the header on close
+    class LogWriter {
+        public:
+            LogWriter();
+            ~LogWriter();  // closes
+            LogWriter(const LogWriter&) = delete;
+            LogWriter& operator=(const LogWriter&) = delete;
+
+            bool open(const char* path, RecordKind kind, std::size_t recordSize, float nominalDt);
+            template <typename Record>
+            bool open(const char* path, float nominalDt) {
+                return open(path, Record::kKind, sizeof(Record), nominalDt);
+            }
+            // false once a write has failed, the records after it are dropped
+            template <typename Record>
+            bool append(const Record& record) {
+                if (!file_ || Record::kKind != header_.kind) return false;
+                if (std::fwrite(&record, sizeof(Record), 1, file_) != 1) return fail("write failed");
+                ++header_.count;
+                return true;
+            }
+            bool close();
+
+            std::size_t size() const { return std::size_t(header_.count); }
+            const char* error() const { return error_; }
+
+        private:
+            bool fail(const char* what);
+
+            std::FILE* file_;
+            LogHeader header_;
+            char error_[160];
+    };
+}
+#endif
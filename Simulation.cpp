@@ -0,0 +1,358 @@
+#include "Simulation.hpp"
+#include "matrixUtils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+
+using namespace matrix_utils;
+
+namespace simulation {
+    namespace {
+        constexpr float kDeg2Rad = 3.14159265f / 180.0f;
+        constexpr float kRad2Deg = 180.0f / 3.14159265f;
+
+        // KF_test.ino ramp
+        constexpr float kTargetPitchDeg = 30.0f;
+        constexpr int   kHoldSteps      = 500;
+
+        class Noise {
+            public:
+                Noise(NoiseShape shape, std::seed_seq& seq): shape_(shape), rng_(seq) {}
+                float operator()(float std) {
+                    return shape_ == NoiseShape::Uniform ? uniform_(rng_) * std : gaussian_(rng_) * std;
+                }
+                std::mt19937& engine() { return rng_; }
+
+            private:
+                NoiseShape shape_;
+                std::mt19937 rng_;
+                std::uniform_real_distribution<float> uniform_{-1.0f, 1.0f};
+                std::normal_distribution<float> gaussian_{0.0f, 1.0f};
+        };
+
+        // KF_test.ino's truth model: q += q*omega/2 * dt, then renormalize
+        void integrateTruth(Quaternion& q, const Vector3& w, float dt) {
+            float q0=q(0,0), q1=q(1,0), q2=q(2,0), q3=q(3,0);
+            float wx=w(0,0), wy=w(1,0), wz=w(2,0);
+            q.set_elt(0,0, q0 + 0.5f * (-q1*wx - q2*wy - q3*wz) * dt);
+            q.set_elt(1,0, q1 + 0.5f * ( q0*wx + q2*wz - q3*wy) * dt);
+            q.set_elt(2,0, q2 + 0.5f * ( q0*wy - q1*wz + q3*wx) * dt);
+            q.set_elt(3,0, q3 + 0.5f * ( q0*wz + q1*wy - q2*wx) * dt);
+            normalizeQuaternion(q);
+        }
+
+        // Truth trajectory and noisy sensor readings of one trial, the same for every filter given
+        // the same (seed, trial)
+        class TrialStream {
+            public:
+                TrialStream(const Scenario& scenario, int trial, std::uint64_t seed):
+                    scenario_(scenario),
+                    seq_{std::uint32_t(seed), std::uint32_t(seed >> 32), std::uint32_t(trial)},
+                    noise_(scenario.noiseShape, seq_)
+                {
+                    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+                    for(int i=0;i<3;++i) bias_.set_elt(i,0, unit(noise_.engine()) * scenario.gyroBias);
+                    axisNorm_ = 0.0f;
+                    while (axisNorm_ < 0.1f) {
+                        for(int i=0;i<3;++i) tumbleAxis_.set_elt(i,0, unit(noise_.engine()));
+                        axisNorm_ = std::sqrt(tumbleAxis_(0,0)*tumbleAxis_(0,0) + tumbleAxis_(1,0)*tumbleAxis_(1,0) +
+                                              tumbleAxis_(2,0)*tumbleAxis_(2,0));
+                    }
+
+                    gravityWorld_.set_elt(2,0, -1.0f);
+                    magWorld_.set_elt(0,0, 1.0f);
+                    trueQ_.set_elt(0,0, 1.0f);
+                }
+
+                // advances the truth by one step and draws its readings, false once the motion is over
+                bool next(int step) {
+                    // 1) true body rate
+                    Vector3 rate;
+                    float t = step * scenario_.dt;
+                    switch (scenario_.motion) {
+                        case Motion::PitchRampHold: {
+                            float roll, pitch, yaw;
+                            quaternionToEuler(trueQ_, roll, pitch, yaw);
+                            if (!holding_) {
+                                rate.set_elt(0,0, scenario_.rate);
+                                rate.set_elt(1,0, scenario_.rate);
+                                if (pitch >= kTargetPitchDeg) holding_ = true;
+                            } else {
+                                ++holdCount_;
+                            }
+                            break;
+                        }
+                        case Motion::Static:
+                            break;
+                        case Motion::Coning:
+                            rate.set_elt(0,0, scenario_.rate * std::cos(0.5f * t));
+                            rate.set_elt(1,0, scenario_.rate * std::sin(0.5f * t));
+                            break;
+                        case Motion::Tumble:
+                            for(int i=0;i<3;++i) rate.set_elt(i,0, scenario_.rate * tumbleAxis_(i,0) / axisNorm_);
+                            break;
+                    }
+                    if (holdCount_ > kHoldSteps) return false;
+
+                    // 2) integrate the truth
+                    integrateTruth(trueQ_, rate, scenario_.dt);
+
+                    // 3) noisy sensors
+                    Vector3 accelBody = rotateVector(trueQ_, gravityWorld_);
+                    Vector3 magBody   = rotateVector(trueQ_, magWorld_);
+                    for(int i=0;i<3;++i) {
+                        gyro_.set_elt(i,0,  rate(i,0) + bias_(i,0) + noise_(scenario_.gyroNoise));
+                        accel_.set_elt(i,0, accelBody(i,0) + noise_(scenario_.accelNoise));
+                        mag_.set_elt(i,0,   magBody(i,0) + noise_(scenario_.magNoise));
+                    }
+                    return true;
+                }
+
+                const Quaternion& truth() const { return trueQ_; }
+                const Vector3& bias() const { return bias_; }
+                const Vector3& gyro() const { return gyro_; }
+                const Vector3& accel() const { return accel_; }
+                const Vector3& mag() const { return mag_; }
+
+            private:
+                const Scenario& scenario_;
+                std::seed_seq seq_;
+                Noise noise_;
+                Vector3 bias_, tumbleAxis_;
+                float axisNorm_;
+                Vector3 gravityWorld_, magWorld_;
+                Quaternion trueQ_;
+                bool holding_ = false;
+                int holdCount_ = 0;
+                Vector3 gyro_, accel_, mag_;
+        };
+
+        // norm of the gyro bias error, in deg/s
+        float biasError(const Vector3& estimated, const Vector3& truth) {
+            float error = 0.0f;
+            for(int i=0;i<3;++i) {
+                float e = estimated(i,0) - truth(i,0);
+                error += e*e;
+            }
+            return std::sqrt(error) * kRad2Deg;
+        }
+
+        template <std::size_t N>
+        fixed_matrix<q4_27, N, 1> toFixed(const fixed_matrix<float, N, 1>& v) {
+            fixed_matrix<q4_27, N, 1> result;
+            for(std::size_t i=0;i<N;++i) result.set_elt(i,0, q4_27(v(i,0)));
+            return result;
+        }
+
+        template <std::size_t N>
+        fixed_matrix<float, N, 1> toFloat(const fixed_matrix<q4_27, N, 1>& v) {
+            fixed_matrix<float, N, 1> result;
+            for(std::size_t i=0;i<N;++i) result.set_elt(i,0, float(v(i,0)));
+            return result;
+        }
+
+        // float interface over FixedEKF, the readings are rounded to Q4.27 on the way in and the
+        // estimate converted back on the way out; the filter itself runs on integers only
+        class FixedPointEKF {
+            public:
+                explicit FixedPointEKF(float dt): filter_(dt) {}
+                void predict(const Vector3& gyro) { filter_.predict(toFixed(gyro)); }
+                void predict(const Vector3* gyro, int count, float dt) {
+                    FixedEKF::Vector3 samples[FixedEKF::kMaxGyroSamples];
+                    for(int i=0;i<count;++i) samples[i] = toFixed(gyro[i]);
+                    filter_.predict(samples, count, dt);
+                }
+                bool update(const Vector3& accel, const Vector3& mag) {
+                    return filter_.update(toFixed(accel), toFixed(mag));
+                }
+                Quaternion getQuaternion() const { return toFloat(filter_.getQuaternion()); }
+                Vector3 getBias() const { return toFloat(filter_.getBias()); }
+
+            private:
+                FixedEKF filter_;
+        };
+
+        template <typename Filter>
+        TrialResult runTrialWith(const Scenario& scenario, int trial, std::uint64_t seed, int gyroSamples) {
+            TrialStream stream(scenario, trial, seed);
+            Filter filter(scenario.dt);
+
+            TrialResult result{};
+            result.trial = trial;
+            result.biasSettleTime = 0.0f;
+            double squaredError = 0.0;
+            std::chrono::steady_clock::duration filterTime{};
+            Vector3 gyro[EKF::kMaxGyroSamples];
+            int buffered = 0, filterSteps = 0;
+
+            int step = 0;
+            for(; step<scenario.steps && stream.next(step); ++step) {
+                // 4) filter, once every gyroSamples steps
+                gyro[buffered++] = stream.gyro();
+                if (buffered < gyroSamples) continue;
+                auto start = std::chrono::steady_clock::now();
+                if (gyroSamples == 1) filter.predict(gyro[0]);
+                else filter.predict(gyro, gyroSamples, gyroSamples * scenario.dt);
+                bool ok = filter.update(stream.accel(), stream.mag());
+                filterTime += std::chrono::steady_clock::now() - start;
+                if (!ok) ++result.failedUpdates;
+                buffered = 0;
+                ++filterSteps;
+
+                // 5) score
+                float error = attitudeError(stream.truth(), filter.getQuaternion());
+                squaredError += double(error) * error;
+                result.finalAttitudeError = error;
+
+                result.finalBiasError = biasError(filter.getBias(), stream.bias());
+                if (result.finalBiasError >= kBiasSettleThreshold) result.biasSettleTime = (step + 1) * scenario.dt;
+            }
+
+            result.steps = step;
+            if (filterSteps > 0) {
+                result.rmsAttitudeError = float(std::sqrt(squaredError / filterSteps));
+                result.nsPerStep = std::chrono::duration<double, std::nano>(filterTime).count() / filterSteps;
+            }
+            if (result.finalBiasError >= kBiasSettleThreshold) result.biasSettleTime = -1.0f;
+            return result;
+        }
+
+        // runs job(i) for every trial i on a pool of threads, 0 meaning every hardware thread
+        template <typename Job>
+        void forEachTrial(int trials, unsigned threads, Job job) {
+            if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+            threads = std::min<unsigned>(threads, std::max(trials, 1));
+
+            std::atomic<int> next{0};
+            auto worker = [&]() {
+                for(int i = next++; i < trials; i = next++) job(i);
+            };
+            std::vector<std::thread> pool;
+            for(unsigned t=1; t<threads; ++t) pool.emplace_back(worker);
+            worker();
+            for(auto& t : pool) t.join();
+        }
+    }
+
+    // Taken from conj(a)*b
+    // with atan2 rather than acos of the dot product: acos is ill-conditioned near 1 and would
+    // count a 1e-7 rounding of either norm as 0.05 deg of error
+    float attitudeError(const Quaternion& a, const Quaternion& b) {
+        double a0=a(0,0), a1=a(1,0), a2=a(2,0), a3=a(3,0);
+        double b0=b(0,0), b1=b(1,0), b2=b(2,0), b3=b(3,0);
+        double w = a0*b0 + a1*b1 + a2*b2 + a3*b3;
+        double x = a0*b1 - a1*b0 - a2*b3 + a3*b2;
+        double y = a0*b2 + a1*b3 - a2*b0 - a3*b1;
+        double z = a0*b3 - a1*b2 + a2*b1 - a3*b0;
+        return float(2.0 * std::atan2(std::sqrt(x*x + y*y + z*z), std::fabs(w))) * kRad2Deg;
+    }
+
+    std::vector<Scenario> defaultScenarios() {
+        const float dt = 0.01f;
+        return {
+            // the KF_test.ino sequence: 10 deg/s up to 30 deg pitch, then 5 s of hold
+            {"pitch_ramp", Motion::PitchRampHold, dt, 2000, NoiseShape::Uniform,
+             0.02f * kDeg2Rad, 0.01f, 0.005f, 0.0f, 10.0f * kDeg2Rad},
+            {"static_bias", Motion::Static, dt, 6000, NoiseShape::Gaussian,
+             0.05f * kDeg2Rad, 0.01f, 0.005f, 1.0f * kDeg2Rad, 0.0f},
+            {"coning", Motion::Coning, dt, 6000, NoiseShape::Gaussian,
+             0.05f * kDeg2Rad, 0.01f, 0.005f, 0.5f * kDeg2Rad, 20.0f * kDeg2Rad},
+            {"tumble", Motion::Tumble, dt, 6000, NoiseShape::Gaussian,
+             0.05f * kDeg2Rad, 0.02f, 0.01f, 0.5f * kDeg2Rad, 45.0f * kDeg2Rad},
+        };
+    }
+
+    TrialResult runTrial(const Scenario& scenario, int trial, std::uint64_t seed, Filter filter,
+                         int gyroSamples) {
+        gyroSamples = std::min(std::max(gyroSamples, 1), EKF::kMaxGyroSamples);
+        if (filter == Filter::MEKF) return runTrialWith<MEKF>(scenario, trial, seed, gyroSamples);
+        if (filter == Filter::FixedEKF) return runTrialWith<FixedPointEKF>(scenario, trial, seed, gyroSamples);
+        return runTrialWith<EKF>(scenario, trial, seed, gyroSamples);
+    }
+
+    std::vector<TrialResult> runMonteCarlo(const Scenario& scenario, int trials, std::uint64_t seed,
+                                           unsigned threads, Filter filter, int gyroSamples) {
+        std::vector<TrialResult> results(std::max(trials, 0));
+        forEachTrial(trials, threads, [&](int i) { results[i] = runTrial(scenario, i, seed, filter, gyroSamples); });
+        return results;
+    }
+
+    int recordTrial(const Scenario& scenario, int trial, std::uint64_t seed, sensor_log::LogWriter& sensors,
+                    sensor_log::LogWriter* truth, int steps) {
+        using sensor_log::SensorRecord;
+        using sensor_log::TrajectoryRecord;
+        TrialStream stream(scenario, trial, seed);
+        if (steps <= 0) steps = scenario.steps;
+        // whole microseconds per step, so the timestamps don't drift from step * period
+        std::uint64_t periodUs = std::uint64_t(std::llround(double(scenario.dt) * 1e6));
+
+        int step = 0;
+        for(; step<steps && stream.next(step); ++step) {
+            std::uint64_t timeUs = (step + 1) * periodUs;
+            SensorRecord record{};
+            record.timeUs = timeUs;
+            record.flags = SensorRecord::kGyro | SensorRecord::kAccel | SensorRecord::kMag;
+            for(int i=0;i<3;++i) {
+                record.gyro[i] = stream.gyro()(i,0);
+                record.accel[i] = stream.accel()(i,0);
+                record.mag[i] = stream.mag()(i,0);
+            }
+            if (!sensors.append(record)) break;
+
+            if (truth) {
+                TrajectoryRecord t{};
+                t.timeUs = timeUs;
+                for(int i=0;i<4;++i) t.q[i] = stream.truth()(i,0);
+                for(int i=0;i<3;++i) t.bias[i] = stream.bias()(i,0);
+                truth->append(t);
+            }
+        }
+        return step;
+    }
+
+    FixedPointComparison compareFixedPoint(const Scenario& scenario, int trial, std::uint64_t seed) {
+        TrialStream stream(scenario, trial, seed);
+        EKF reference(scenario.dt);
+        FixedPointEKF filter(scenario.dt);
+
+        FixedPointComparison result{};
+        result.trial = trial;
+        double squaredDifference = 0.0, squaredFloatError = 0.0, squaredFixedError = 0.0;
+
+        int step = 0;
+        for(; step<scenario.steps && stream.next(step); ++step) {
+            reference.predict(stream.gyro());
+            reference.update(stream.accel(), stream.mag());
+            filter.predict(stream.gyro());
+            if (!filter.update(stream.accel(), stream.mag())) ++result.failedUpdates;
+
+            Quaternion q = filter.getQuaternion();
+            float difference = attitudeError(reference.getQuaternion(), q);
+            float floatError = attitudeError(stream.truth(), reference.getQuaternion());
+            float fixedError = attitudeError(stream.truth(), q);
+            squaredDifference += double(difference) * difference;
+            squaredFloatError += double(floatError) * floatError;
+            squaredFixedError += double(fixedError) * fixedError;
+            result.maxDifference = std::max(result.maxDifference, difference);
+            result.finalBiasDifference = biasError(filter.getBias(), reference.getBias());
+        }
+
+        result.steps = step;
+        if (step > 0) {
+            result.rmsDifference = float(std::sqrt(squaredDifference / step));
+            result.floatRmsError = float(std::sqrt(squaredFloatError / step));
+            result.fixedRmsError = float(std::sqrt(squaredFixedError / step));
+        }
+        return result;
+    }
+
+    std::vector<FixedPointComparison> compareFixedPoint(const Scenario& scenario, int trials,
+                                                        std::uint64_t seed, unsigned threads) {
+        std::vector<FixedPointComparison> results(std::max(trials, 0));
+        forEachTrial(trials, threads, [&](int i) { results[i] = compareFixedPoint(scenario, i, seed); });
+        return results;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+#include "EKF.hpp"
+#include "MEKF.hpp"
+#include "SensorLog.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Host-side Monte Carlo harness: simulates a true attitude trajectory, feeds noisy gyro/accel/mag
+// readings to an EKF, MEKF or fixed point EKF and scores the estimate against the truth. Trials are
+// seeded, so a result can be reproduced from (seed, trial) alone whatever the thread count.
+namespace simulation {
+    // How the true body rate evolves during a trial
+    enum class Motion {
+        PitchRampHold,  // KF_test.ino: rate on x and y until pitch reaches 30 deg, then hold
+        Static,         // no rotation
+        Coning,         // rate of constant magnitude turning about z
+        Tumble          // constant rate, random direction per trial
+    };
+
+    // Filter under test, all have the same predict/update interface. FixedEKF is the EKF on Q4.27
+    // fixed point, fed the same float readings rounded to it
+    enum class Filter { EKF, MEKF, FixedEKF };
+
+    // Uniform draws in [-std, std] like KF_test.ino, Gaussian draws have standard deviation std
+    enum class NoiseShape { Uniform, Gaussian };
+
+    struct Scenario {
+        std::string name;
+        Motion motion;
+        float dt;               // s
+        int steps;              // trial length, PitchRampHold stops earlier once its hold is over
+        NoiseShape noiseShape;
+        float gyroNoise;        // rad/s
+        float accelNoise;       // g
+        float magNoise;         // field units
+        float gyroBias;         // rad/s, each axis drawn uniformly in [-gyroBias, gyroBias] per trial
+        float rate;             // rad/s, amplitude of the motion
+    };
+
+    // the bias has converged once its error stays below this, in deg/s
+    constexpr float kBiasSettleThreshold = 0.1f;
+
+    struct TrialResult {
+        int trial;
+        int steps;
+        float rmsAttitudeError;    // deg, RMS over all steps of the angle between true and estimated attitude
+        float finalAttitudeError;  // deg
+        float finalBiasError;      // deg/s, norm of the gyro bias error at the end
+        float biasSettleTime;      // s, from which the bias error stays below kBiasSettleThreshold, -1 if never
+        int failedUpdates;         // updates that rejected a measurement
+        double nsPerStep;          // wall time of predict + update, per filter step
+    };
+
+    // Float EKF against FixedEKF on the same readings
+    struct FixedPointComparison {
+        int trial;
+        int steps;
+        float rmsDifference;        // deg, RMS over all steps of the angle between the two estimates
+        float maxDifference;        // deg
+        float finalBiasDifference;  // deg/s, norm of the difference of the bias estimates at the end
+        float floatRmsError;        // deg, RMS attitude error of the float filter against the truth
+        float fixedRmsError;        // deg, same for the fixed point filter
+        int failedUpdates;          // updates of the fixed point filter that rejected a measurement
+    };
+
+    std::vector<Scenario> defaultScenarios();
+    // angle of the rotation between two attitude quaternions, in degrees
+    float attitudeError(const Quaternion& a, const Quaternion& b);
+    // gyroSamples > 1 runs the filter once every gyroSamples steps, predicting over all of them with
+    // the coning compensated multi-sample predict and updating with the readings of the last one;
+    // the attitude error is scored at those steps only
+    TrialResult runTrial(const Scenario& scenario, int trial, std::uint64_t seed,
+                         Filter filter = Filter::EKF, int gyroSamples = 1);
+    // threads = 0 uses every hardware thread, results are ordered by trial
+    std::vector<TrialResult> runMonteCarlo(const Scenario& scenario, int trials, std::uint64_t seed,
+                                           unsigned threads, Filter filter = Filter::EKF,
+                                           int gyroSamples = 1);
+    // Writes the readings of a trial to a sensor log, one record per step holding all three sensors,
+    // and the true attitude and bias to truth if given; steps > 0 overrides the scenario length.
+    // Returns the steps written
+    int recordTrial(const Scenario& scenario, int trial, std::uint64_t seed, sensor_log::LogWriter& sensors,
+                    sensor_log::LogWriter* truth = nullptr, int steps = 0);
+    FixedPointComparison compareFixedPoint(const Scenario& scenario, int trial, std::uint64_t seed);
+    std::vector<FixedPointComparison> compareFixedPoint(const Scenario& scenario, int trials,
+                                                        std::uint64_t seed, unsigned threads);
+}
+#endif
@@ -0,0 +1,72 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Wait-free single producer, single consumer ring of Capacity (a power of two) elements. push and
+// pop finish in a bounded number of steps whatever the other thread does: a full ring makes push
+// fail and count an overrun instead of waiting, so a stalled consumer costs samples, never a stall
+// of the producer.
+//
+// head_ and tail_ count elements ever pushed and popped, each written by one thread only, and sit on
+// cache lines of their own so the two threads don't bounce one line between cores. Each side keeps a
+// copy of the other's index and only reloads it when the copy says full or empty.
+template <typename T, std::size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+    public:
+        static constexpr std::size_t kCapacity = Capacity;
+
+        SpscRing(): head_(0), overruns_(0), cachedTail_(0), tail_(0), cachedHead_(0) {}
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // producer: false, and one more overrun, if the ring is full
+        bool push(const T& value) {
+            if (tryPush(value)) return true;
+            overruns_.store(overruns_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // producer: push for callers that retry on a full ring rather than drop, counts nothing
+        bool tryPush(const T& value) {
+            std::uint64_t head = head_.load(std::memory_order_relaxed);
+            if (head - cachedTail_ == Capacity) {
+                cachedTail_ = tail_.load(std::memory_order_acquire);
+                if (head - cachedTail_ == Capacity) return false;
+            }
+            slots_[head & (Capacity - 1)] = value;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // consumer: moves up to max elements into out, oldest first, and returns how many
+        std::size_t pop(T* out, std::size_t max) {
+            std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+            if (cachedHead_ - tail < max) cachedHead_ = head_.load(std::memory_order_acquire);
+            std::size_t n = std::size_t(cachedHead_ - tail);
+            if (n > max) n = max;
+            for(std::size_t i=0; i<n; ++i) out[i] = slots_[(tail + i) & (Capacity - 1)];
+            tail_.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        // either side, a snapshot that may be stale by the time it is read
+        std::size_t size() const {
+            return std::size_t(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+        }
+        std::uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+
+    private:
+        // producer's line
+        alignas(64) std::atomic<std::uint64_t> head_;
+        std::atomic<std::uint64_t> overruns_;
+        std::uint64_t cachedTail_;
+        // consumer's line
+        alignas(64) std::atomic<std::uint64_t> tail_;
+        std::uint64_t cachedHead_;
+        alignas(64) T slots_[Capacity];
+};
+#endif
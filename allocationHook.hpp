@@ -0,0 +1,96 @@
+#ifndef ALLOCATION_HOOK_HPP
+#define ALLOCATION_HOOK_HPP
+#include <cassert>
+#include <cstddef>
+
+// Test hook counting calls to the global allocator. Exactly one translation unit of a host program
+// defines ALLOCATION_HOOK_IMPLEMENTATION before including this header, which replaces the global
+// operator new/delete with counting versions. Without it count() always stays 0.
+namespace allocation_hook {
+    // Allocations made by the calling thread, so other threads do not disturb a measurement
+    inline std::size_t& threadCounter() {
+        static thread_local std::size_t counter = 0;
+        return counter;
+    }
+
+    inline std::size_t count() {
+        return threadCounter();
+    }
+
+    // Counts the allocations made by this thread during its lifetime
+    class Scope {
+        public:
+            Scope() : start_(count()) {}
+            std::size_t allocations() const { return count() - start_; }
+
+        private:
+            std::size_t start_;
+    };
+
+    // Asserts that no allocation happened by the time it goes out of scope
+    class ExpectNone : public Scope {
+        public:
+            ~ExpectNone() { assert(allocations() == 0 && "unexpected heap allocation"); }
+    };
+}
+
+#ifdef ALLOCATION_HOOK_IMPLEMENTATION
+#include <cstdlib>
+#include <new>
+
+void* operator new(std::size_t size) {
+    ++allocation_hook::threadCounter();
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+// over-aligned types, such as SIMD vectors and arena storage taken from the heap
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    ++allocation_hook::threadCounter();
+    std::size_t a = static_cast<std::size_t>(alignment);
+    std::size_t rounded = size ? (size + a - 1) / a * a : a;  // aligned_alloc wants a multiple
+    if (void* p = std::aligned_alloc(a, rounded)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+#endif
+#endif
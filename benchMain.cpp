@@ -0,0 +1,515 @@
+#define ALLOCATION_HOOK_IMPLEMENTATION
+#include "allocationHook.hpp"
+#include "EKF.hpp"
+#include "AttitudeBatch.hpp"
+#include "EKFBatch.hpp"
+#include "MEKF.hpp"
+#include "MeasurementScheduler.hpp"
+#include "matrixUtils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Microbenchmarks of the fastmatrix and EKF hot paths.
+// Writes one CSV row per benchmark to stdout (stable names and columns, so two runs can be diffed)
+// and progress to stderr.
+//
+//   guidance_bench [--filter SUBSTRING] [--min-time MS] [--repeat N]
+
+using namespace matrix_utils;
+
+namespace {
+    // Keeps the compiler from optimizing away a value or the stores leading to it
+    template <typename T>
+    inline void doNotOptimize(T const& value) {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    // Core cycles from the perf counters when the kernel allows it, else the x86 time stamp
+    // counter (reference cycles, not core cycles), else nothing
+    class CycleCounter {
+        public:
+            CycleCounter() {
+#ifdef __linux__
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof(attr));
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.size = sizeof(attr);
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                fd_ = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+                if (fd_ >= 0) {
+                    ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+                    source_ = "perf";
+                    return;
+                }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+                source_ = "tsc";
+#endif
+            }
+            ~CycleCounter() {
+#ifdef __linux__
+                if (fd_ >= 0) close(fd_);
+#endif
+            }
+            bool available() const { return std::strcmp(source_, "none") != 0; }
+            const char* source() const { return source_; }
+            std::uint64_t read() const {
+#ifdef __linux__
+                if (fd_ >= 0) {
+                    std::uint64_t value = 0;
+                    if (::read(fd_, &value, sizeof(value)) == sizeof(value)) return value;
+                    return 0;
+                }
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+                return __rdtsc();
+#else
+                return 0;
+#endif
+            }
+
+        private:
+            int fd_ = -1;
+            const char* source_ = "none";
+    };
+
+    struct Options {
+        std::string filter;
+        double minTimeMs = 100.0;
+        int repeat = 5;
+    };
+
+    struct Result {
+        std::string name;
+        long long iterations;
+        double nsPerOp;
+        double allocsPerOp;
+        double cyclesPerOp;  // negative when no counter is available
+    };
+
+    class Runner {
+        public:
+            explicit Runner(const Options& options): options_(options) {}
+
+            const CycleCounter& cycles() const { return cycles_; }
+            const std::vector<Result>& results() const { return results_; }
+
+            // Times op, which must leave its inputs ready for the next call. The iteration count is
+            // grown until one batch takes the minimum time, then the fastest of several batches is kept
+            template <typename Op>
+            void run(const std::string& name, Op op) {
+                if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) return;
+                std::fprintf(stderr, "%-32s", name.c_str());
+
+                op();  // warm up caches and any lazily sized buffers
+                long long iterations = 1;
+                while (true) {
+                    double ns = batch(op, iterations).ns;
+                    if (ns >= options_.minTimeMs * 1e6 || iterations >= (1LL << 40)) break;
+                    long long grow = ns > 0.0 ? (long long)(options_.minTimeMs * 1e6 * 1.2 / ns * iterations) : 0;
+                    iterations = std::max(iterations * 2, std::min(grow, iterations * 100));
+                }
+
+                Sample best = batch(op, iterations);
+                for(int r=1; r<options_.repeat; ++r) {
+                    Sample s = batch(op, iterations);
+                    if (s.ns < best.ns) best = s;
+                }
+
+                Result result;
+                result.name = name;
+                result.iterations = iterations;
+                result.nsPerOp = best.ns / iterations;
+                result.allocsPerOp = double(best.allocations) / iterations;
+                result.cyclesPerOp = cycles_.available() ? double(best.cycles) / iterations : -1.0;
+                results_.push_back(result);
+                std::fprintf(stderr, "%12.1f ns/op %8.2f allocs/op\n", result.nsPerOp, result.allocsPerOp);
+            }
+
+        private:
+            struct Sample {
+                double ns;
+                std::uint64_t cycles;
+                std::size_t allocations;
+            };
+
+            template <typename Op>
+            Sample batch(Op& op, long long iterations) {
+                allocation_hook::Scope scope;
+                std::uint64_t c0 = cycles_.read();
+                auto t0 = std::chrono::steady_clock::now();
+                for(long long i=0; i<iterations; ++i) op();
+                auto t1 = std::chrono::steady_clock::now();
+                std::uint64_t c1 = cycles_.read();
+                return {std::chrono::duration<double, std::nano>(t1 - t0).count(), c1 - c0,
+                        scope.allocations()};
+            }
+
+            Options options_;
+            CycleCounter cycles_;
+            std::vector<Result> results_;
+    };
+
+    // Deterministic inputs, reproducible between runs
+    float value(int i, int j, int salt) {
+        return float((i * 7 + j * 13 + salt * 31) % 17) / 17.0f - 0.5f;
+    }
+
+    template <typename M>
+    void fill(M& m, int salt) {
+        for(std::size_t i=0; i<m.num_rows(); ++i)
+          for(std::size_t j=0; j<m.num_cols(); ++j)
+            m.set_elt(i, j, value(int(i), int(j), salt));
+    }
+
+    void benchProducts(Runner& runner) {
+        for(std::size_t n : {4, 7, 16, 32, 64, 128, 256}) {
+            matrix<float> a(n, n), b(n, n), c(n, n);
+            fill(a, 1);
+            fill(b, 2);
+            runner.run("matrix_product/dynamic/" + std::to_string(n), [&]() {
+                c = a * b;
+                doNotOptimize(c);
+            });
+        }
+
+        fixed_matrix<float, 6, 6> a6, b6, c6;
+        fill(a6, 1);
+        fill(b6, 2);
+        runner.run("matrix_product/fixed/6", [&]() {
+            c6 = a6 * b6;
+            doNotOptimize(c6);
+        });
+
+        fixed_matrix<float, 7, 7> a7, b7, c7;
+        fill(a7, 1);
+        fill(b7, 2);
+        runner.run("matrix_product/fixed/7", [&]() {
+            c7 = a7 * b7;
+            doNotOptimize(c7);
+        });
+
+        // the unrolled kernels against straight-line code written by hand, they should tie
+        float const* pa = a6.data();
+        float const* pb = b6.data();
+        float* pc = c6.data();
+        runner.run("matrix_product/handwritten/6", [&]() {
+            float acc[36];
+            for(int i=0; i<6; ++i) {
+                float const* ai = pa + 6*i;
+                float* ci = acc + 6*i;
+                ci[0] = ai[0]*pb[0]; ci[1] = ai[0]*pb[1]; ci[2] = ai[0]*pb[2];
+                ci[3] = ai[0]*pb[3]; ci[4] = ai[0]*pb[4]; ci[5] = ai[0]*pb[5];
+                for(int k=1; k<6; ++k) {
+                    float const* bk = pb + 6*k;
+                    ci[0] += ai[k]*bk[0]; ci[1] += ai[k]*bk[1]; ci[2] += ai[k]*bk[2];
+                    ci[3] += ai[k]*bk[3]; ci[4] += ai[k]*bk[4]; ci[5] += ai[k]*bk[5];
+                }
+            }
+            std::memcpy(pc, acc, sizeof(acc));
+            doNotOptimize(c6);
+        });
+
+        fixed_matrix<float, 6, 1> v6, w6;
+        fill(v6, 4);
+        runner.run("matrix_vector/fixed/6", [&]() {
+            w6 = a6 * v6;
+            doNotOptimize(w6);
+        });
+
+        fixed_matrix<float, 4, 4> a4, b4;
+        fixed_matrix<float, 4, 1> v4, w4;
+        fill(a4, 1);
+        fill(b4, 2);
+        fill(v4, 4);
+        runner.run("matrix_vector/fixed/4", [&]() {
+            w4 = a4 * b4 * v4;
+            doNotOptimize(w4);
+        });
+
+        fixed_matrix<float, 3, 1> x3, y3, z3;
+        fill(x3, 1);
+        fill(y3, 2);
+        runner.run("assign/fixed/3x1", [&]() {
+            z3 = x3 + y3 * 0.5f;
+            doNotOptimize(z3);
+        });
+    }
+
+    void benchUtils(Runner& runner) {
+        // diagonally dominant, so the inverse is well defined
+        fixed_matrix<float, 6, 6> m;
+        fill(m, 3);
+        for(int i=0;i<6;++i) m.set_elt(i,i, m(i,i) + 4.0f);
+        matrix<float> dynamicM(6, 6);
+        dynamicM.assign(m);
+
+        runner.run("inverse6x6/fixed", [&]() {
+            auto inv = inverse6x6(m);
+            doNotOptimize(inv);
+        });
+        runner.run("inverse6x6/dynamic", [&]() {
+            auto inv = inverse6x6(dynamicM);
+            doNotOptimize(inv);
+        });
+
+        // the same body on storage from an arena rewound every call, as a filter tick would
+        static static_arena<4096> scratch;
+        arena_matrix<float> arenaM(6, 6, arena_allocator<float>(scratch));
+        arenaM.assign(m);
+        runner.run("inverse6x6/arena", [&]() {
+            arena_scope scope(scratch);
+            auto inv = inverse6x6(arenaM);
+            doNotOptimize(inv);
+        });
+
+        Quaternion q;
+        q.set_elt(0,0, 0.9f); q.set_elt(1,0, 0.1f); q.set_elt(2,0, -0.3f); q.set_elt(3,0, 0.3f);
+        normalizeQuaternion(q);
+        Vector3 v;
+        v.set_elt(0,0, 0.2f); v.set_elt(1,0, -0.4f); v.set_elt(2,0, 0.9f);
+        runner.run("rotateVector", [&]() {
+            doNotOptimize(q);
+            auto r = rotateVector(q, v);
+            doNotOptimize(r);
+        });
+        runner.run("normalizeQuaternion", [&]() {
+            doNotOptimize(q);
+            Quaternion n = q;
+            normalizeQuaternion(n);
+            doNotOptimize(n);
+        });
+
+        // the same operations on the SIMD types of quaternion.hpp
+        quat sq = quat::from(q), sp(0.99f, 0.01f, 0.02f, -0.01f);
+        vec3 sv = vec3::from(v), rate(0.3f, -0.2f, 0.1f);
+        runner.run("quat/multiply", [&]() {
+            doNotOptimize(sq);
+            quat r = sq * sp;
+            doNotOptimize(r);
+        });
+        runner.run("quat/rotate", [&]() {
+            doNotOptimize(sq);
+            vec3 r = rotate(sq, sv);
+            doNotOptimize(r);
+        });
+        runner.run("quat/normalize", [&]() {
+            doNotOptimize(sp);
+            quat r = normalize(sp);
+            doNotOptimize(r);
+        });
+        runner.run("quat/integrate", [&]() {
+            doNotOptimize(sq);
+            quat r = integrate(sq, rate, 0.01f);
+            doNotOptimize(r);
+        });
+
+        float roll, pitch, yaw;
+        runner.run("quaternionToEuler", [&]() {
+            doNotOptimize(q);
+            quaternionToEuler(q, roll, pitch, yaw);
+            doNotOptimize(yaw);
+        });
+
+        // one op is a whole array, on one thread, so ns_per_op / 4096 compares with the rows above
+        const std::size_t samples = 4096;
+        std::vector<float> qs[4], vs[3], out[3];
+        for(int i=0;i<4;++i) qs[i].assign(samples, q(i,0));
+        for(int i=0;i<3;++i) {
+            vs[i].assign(samples, v(i,0));
+            out[i].assign(samples, 0.0f);
+        }
+        QuaternionBatch qb{qs[0].data(), qs[1].data(), qs[2].data(), qs[3].data()};
+        runner.run("euler_batch/4096", [&]() {
+            quaternionToEulerBatch(qb, samples, {out[0].data(), out[1].data(), out[2].data()});
+            doNotOptimize(out[0][0]);
+        });
+        runner.run("rotate_batch/4096", [&]() {
+            rotateVectorBatch(qb, {vs[0].data(), vs[1].data(), vs[2].data()}, samples,
+                              {out[0].data(), out[1].data(), out[2].data()});
+            doNotOptimize(out[0][0]);
+        });
+    }
+
+    void benchFilter(Runner& runner) {
+        const float dt = 0.01f;
+        Vector3 gyro, accel, mag;
+        gyro.set_elt(0,0, 0.01f); gyro.set_elt(1,0, -0.02f); gyro.set_elt(2,0, 0.005f);
+        accel.set_elt(0,0, 0.01f); accel.set_elt(1,0, 0.02f); accel.set_elt(2,0, -0.99f);
+        mag.set_elt(0,0, 0.98f); mag.set_elt(1,0, 0.05f); mag.set_elt(2,0, -0.02f);
+
+        {
+            EKF ekf(dt);
+            runner.run("ekf/predict", [&]() {
+                ekf.predict(gyro);
+                doNotOptimize(ekf);
+            });
+        }
+        {
+            // one predict over four gyro samples, what a filter running at a quarter rate pays
+            EKF ekf(4 * dt);
+            const Vector3 samples[4] = {gyro, gyro, gyro, gyro};
+            runner.run("ekf/predict/4_samples", [&]() {
+                ekf.predict(samples, 4, 4 * dt);
+                doNotOptimize(ekf);
+            });
+        }
+        {
+            EKF ekf(dt);
+            runner.run("ekf/update", [&]() {
+                ekf.update(accel, mag);
+                doNotOptimize(ekf);
+            });
+        }
+        {
+            EKF ekf(dt);
+            ekf.setUpdateMode(EKF::UpdateMode::Batch);
+            runner.run("ekf/update_batch", [&]() {
+                ekf.update(accel, mag);
+                doNotOptimize(ekf);
+            });
+        }
+        {
+            EKF ekf(dt);
+            runner.run("ekf/step", [&]() {
+                ekf.predict(gyro);
+                ekf.update(accel, mag);
+                doNotOptimize(ekf);
+            });
+        }
+
+        {
+            // host timing of the integer arithmetic, only a relative figure for FPU-less targets
+            FixedEKF ekf(dt);
+            FixedEKF::Vector3 fixedGyro, fixedAccel, fixedMag;
+            for(int i=0;i<3;++i) {
+                fixedGyro.set_elt(i,0, q4_27(gyro(i,0)));
+                fixedAccel.set_elt(i,0, q4_27(accel(i,0)));
+                fixedMag.set_elt(i,0, q4_27(mag(i,0)));
+            }
+            runner.run("ekf_fixed/step", [&]() {
+                ekf.predict(fixedGyro);
+                ekf.update(fixedAccel, fixedMag);
+                doNotOptimize(ekf);
+            });
+        }
+
+        {
+            MEKF mekf(dt);
+            runner.run("mekf/predict", [&]() {
+                mekf.predict(gyro);
+                doNotOptimize(mekf);
+            });
+        }
+        {
+            MEKF mekf(4 * dt);
+            const Vector3 samples[4] = {gyro, gyro, gyro, gyro};
+            runner.run("mekf/predict/4_samples", [&]() {
+                mekf.predict(samples, 4, 4 * dt);
+                doNotOptimize(mekf);
+            });
+        }
+        {
+            MEKF mekf(dt);
+            runner.run("mekf/update", [&]() {
+                mekf.update(accel, mag);
+                doNotOptimize(mekf);
+            });
+        }
+        {
+            MEKF mekf(dt);
+            runner.run("mekf/step", [&]() {
+                mekf.predict(gyro);
+                mekf.update(accel, mag);
+                doNotOptimize(mekf);
+            });
+        }
+
+        // one op is a second of 1 kHz gyro, 400 Hz accel and 100 Hz mag through the scheduler
+        {
+            MEKF mekf(0.001f);
+            MeasurementScheduler<MEKF> scheduler(mekf);
+            double t0 = 0.0;
+            runner.run("scheduler/mekf/1s", [&]() {
+                for(int us=0; us<1000000; us+=250) {
+                    double t = t0 + us*1e-6;
+                    if (us % 1000 == 0) scheduler.addGyro(t, gyro);
+                    if (us % 2500 == 0) scheduler.addAccel(t, accel);
+                    if (us % 10000 == 0) scheduler.addMag(t, mag);
+                    scheduler.process(t);
+                }
+                t0 += 1.0;
+                doNotOptimize(mekf);
+            });
+        }
+
+        // one op is a step of every filter in the batch
+        const std::size_t filters = 1024;
+        EKFBatch batch(filters, dt);
+        std::vector<float> g[3], a[3], m[3];
+        for(int i=0;i<3;++i) {
+            g[i].assign(filters, gyro(i,0));
+            a[i].assign(filters, accel(i,0));
+            m[i].assign(filters, mag(i,0));
+        }
+        runner.run("ekf_batch/step/1024", [&]() {
+            batch.predict({g[0].data(), g[1].data(), g[2].data()});
+            batch.update({a[0].data(), a[1].data(), a[2].data()}, {m[0].data(), m[1].data(), m[2].data()});
+            doNotOptimize(batch);
+        });
+    }
+
+    void usage(const char* program) {
+        std::fprintf(stderr,
+            "usage: %s [--filter SUBSTRING] [--min-time MS] [--repeat N]\n"
+            "  --filter      only run benchmarks whose name contains SUBSTRING\n"
+            "  --min-time    minimum duration of one timed batch in ms (default 100)\n"
+            "  --repeat      timed batches per benchmark, the fastest is reported (default 5)\n", program);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    for(int i=1; i<argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--filter") && hasValue) options.filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--min-time") && hasValue) options.minTimeMs = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--repeat") && hasValue) options.repeat = std::max(1, std::atoi(argv[++i]));
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    Runner runner(options);
+    benchProducts(runner);
+    benchUtils(runner);
+    benchFilter(runner);
+
+    std::printf("# cycles: %s\n", runner.cycles().source());
+    std::printf("name,iterations,ns_per_op,allocs_per_op,cycles_per_op\n");
+    for(const auto& r : runner.results()) {
+        std::printf("%s,%lld,%.2f,%.3f,", r.name.c_str(), r.iterations, r.nsPerOp, r.allocsPerOp);
+        if (r.cyclesPerOp >= 0.0) std::printf("%.1f\n", r.cyclesPerOp);
+        else std::printf("\n");
+    }
+    return 0;
+}
@@ -1,11 +1,18 @@
 #ifndef FASTMATRIX_FASTMATRIX_HPP
 #define FASTMATRIX_FASTMATRIX_HPP
 
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <ostream>
 #include <type_traits>
 #include <vector>
 
+#include "fastmatrix_arena.hpp"
+#include "fastmatrix_gemm.hpp"
+#include "fastmatrix_instrumentation.hpp"
+#include "fastmatrix_unroll.hpp"
+
 namespace fastmatrix {
 
 /**
@@ -58,6 +65,66 @@ struct storage_type {
 template <typename T>
 using storage_type_t = typename storage_type<T>::type;
 
+/**
+ * Value of static_rows and static_cols for expressions whose dimensions are only known at runtime
+ */
+constexpr std::size_t dynamic = 0;
+
+/**
+ * \brief      Trait returning the number of rows of an expression if it is known at compile time, or
+ * dynamic otherwise
+ *
+ * \tparam     T     Expression type
+ */
+template <typename T>
+struct static_rows {
+  static constexpr std::size_t value = T::StaticRows;
+};
+
+/**
+ * Convenience variable template of static_rows
+ */
+template <typename T>
+constexpr std::size_t static_rows_v = static_rows<T>::value;
+
+/**
+ * \brief      Trait returning the number of columns of an expression if it is known at compile time,
+ * or dynamic otherwise
+ *
+ * \tparam     T     Expression type
+ */
+template <typename T>
+struct static_cols {
+  static constexpr std::size_t value = T::StaticCols;
+};
+
+/**
+ * Convenience variable template of static_cols
+ */
+template <typename T>
+constexpr std::size_t static_cols_v = static_cols<T>::value;
+
+/**
+ * \brief      Checks whether two compile time dimensions can be equal at runtime
+ *
+ * \param[in]  a     Dimension 1, or dynamic
+ * \param[in]  b     Dimension 2, or dynamic
+ *
+ * \return     False only if both dimensions are known and differ
+ */
+constexpr bool dimensions_match(std::size_t a, std::size_t b) {
+  return a == dynamic || b == dynamic || a == b;
+}
+
+/**
+ * \brief      Trait for whether an expression exposes its elements as a contiguous row-major array
+ * through a data() method
+ *
+ * \tparam     T     Expression type
+ */
+template <typename T>
+struct has_direct_access : std::false_type {};
+
 /**
  * \brief      Base class for expressions
  *
@@ -107,6 +174,258 @@ public:
 template <typename T>
 using enable_if_not_expression = std::enable_if_t<!std::is_base_of<expression<T>, T>::value>;
 
+template <typename M, std::size_t Rows, std::size_t Cols>
+class block_view;
+
+/**
+ * \brief      Whether evaluating an expression may read memory in [first, last)
+ *
+ * Decides whether a result can be written straight into a destination occupying that range or has
+ * to go through a temporary first. Classes that store elements or hold operands overload it; for
+ * any other expression the answer is a conservative yes
+ *
+ * \param      expr   The expression
+ * \param[in]  first  Start of the range
+ * \param[in]  last   End of the range
+ *
+ * \tparam     E      Type of the expression
+ *
+ * \return     False only if the expression is known not to read the range
+ */
+template <typename E>
+inline bool aliases(expression<E> const &, void const *, void const *) {
+  return true;
+}
+
+namespace detail {
+
+/**
+ * \brief      Whether the ranges [first1, last1) and [first2, last2) overlap
+ */
+inline bool overlaps(void const *first1, void const *last1, void const *first2,
+                     void const *last2) {
+  return reinterpret_cast<std::uintptr_t>(first1) < reinterpret_cast<std::uintptr_t>(last2) &&
+         reinterpret_cast<std::uintptr_t>(first2) < reinterpret_cast<std::uintptr_t>(last1);
+}
+
+/**
+ * Ways of combining a result with its destination, defined further below: overwrite it, add to it
+ * or subtract from it
+ */
+struct store_assign;
+struct store_add;
+struct store_subtract;
+
+} // namespace detail
+
+/**
+ * \brief      Trait for whether an expression can write its result straight into a destination
+ * through a store_into method, rather than being read element by element
+ *
+ * \tparam     T     Expression type
+ */
+template <typename T>
+struct evaluates_into : std::false_type {};
+
+/**
+ * \brief      Evaluates an expression into a destination it does not alias
+ *
+ * Products write their result straight into the destination, or add it to or subtract it from the
+ * destination element by element, without evaluating into a temporary first. Any other expression
+ * is combined with the destination through the destination's assign. The caller guarantees the
+ * expression does not read the destination, see noalias()
+ *
+ * \param      dst    The destination, of the dimensions of the expression
+ * \param      expr   The expression
+ *
+ * \tparam     Store  detail::store_assign, store_add or store_subtract
+ * \tparam     D      Type of the destination
+ * \tparam     E      Type of the expression
+ */
+template <typename Store, typename D, typename E>
+inline void evaluate_into(D &dst, expression<E> const &expr);
+
+namespace detail {
+
+/**
+ * \brief      Evaluates an expression into a destination whose storage is [first, last)
+ *
+ * An expression that does not read the destination is written straight into it. A product that
+ * does goes through the temporary it evaluates into before its first element is read; any other
+ * aliased expression, say transpose(A) assigned to A or an overlapping segment, may read elements
+ * already overwritten and is evaluated into a temporary first
+ *
+ * \param      dst    The destination, of the dimensions of the expression
+ * \param[in]  first  Start of the storage of the destination
+ * \param[in]  last   End of the storage of the destination
+ * \param      expr   The expression
+ *
+ * \tparam     Store  detail::store_assign, store_add or store_subtract
+ * \tparam     D      Type of the destination
+ * \tparam     E      Type of the expression
+ */
+template <typename Store, typename D, typename E>
+inline void evaluate_checked(D &dst, void const *first, void const *last,
+                             expression<E> const &expr) {
+  E const &e = expr.get_const_derived();
+  if (!aliases(e, first, last)) {
+    evaluate_into<Store>(dst, expr);
+  } else if constexpr (evaluates_into<E>::value) {
+    Store::assign(dst, expr);
+  } else {
+    eval_return_type_t<E> temp(e.num_rows(), e.num_cols());
+    temp.assign(e);
+    Store::assign(dst, temp);
+  }
+}
+
+} // namespace detail
+
+/**
+ * \brief      Assignments to a matrix from expressions that the caller guarantees do not read it,
+ * made by the noalias() method of the matrix
+ *
+ *   c.noalias() = a * b;   // the product is written straight into c
+ *   c.noalias() += a * b;  // and added to it, without a temporary
+ *
+ * The plain operators check for aliasing themselves and are just as fast when they can tell the
+ * operands apart; noalias() skips the check, for expressions it cannot see through
+ *
+ * \tparam     D     Type of the matrix
+ */
+template <typename D>
+class noalias_assignment {
+private:
+  /**
+   * The matrix assigned to
+   */
+  D &dst;
+
+public:
+  inline explicit noalias_assignment(D &dst) : dst(dst) {}
+
+  template <typename E>
+  inline D &operator=(expression<E> const &expr) {
+    assert(dst.num_rows() == expr.num_rows());
+    assert(dst.num_cols() == expr.num_cols());
+    evaluate_into<detail::store_assign>(dst, expr);
+    return dst;
+  }
+
+  template <typename E>
+  inline D &operator+=(expression<E> const &expr) {
+    assert(dst.num_rows() == expr.num_rows());
+    assert(dst.num_cols() == expr.num_cols());
+    evaluate_into<detail::store_add>(dst, expr);
+    return dst;
+  }
+
+  template <typename E>
+  inline D &operator-=(expression<E> const &expr) {
+    assert(dst.num_rows() == expr.num_rows());
+    assert(dst.num_cols() == expr.num_cols());
+    evaluate_into<detail::store_subtract>(dst, expr);
+    return dst;
+  }
+};
+
+/**
+ * \brief      Base class giving a matrix class zero-copy views of its sub-blocks
+ *
+ * The views read and write the elements of the matrix in place, see block_view. Inherited by the
+ * classes that store their elements, next to expression
+ *
+ * \tparam     D     Derived class type
+ */
+template <typename D>
+class block_access {
+public:
+  /**
+   * \brief      View of Size consecutive elements of a column vector
+   *
+   * \tparam     Start  First row of the segment
+   * \tparam     Size   Number of rows of the segment
+   *
+   * \return     The view, writable
+   */
+  template <std::size_t Start, std::size_t Size>
+  inline block_view<D, Size, 1> segment() {
+    static_assert(static_cols_v<D> == dynamic || static_cols_v<D> == 1,
+                  "Segments are only defined for column vectors");
+    static_assert(static_rows_v<D> == dynamic || Start + Size <= static_rows_v<D>,
+                  "Segment past the end of the vector");
+    return block_view<D, Size, 1>(derived(), Start, 0, Size, 1);
+  }
+
+  /**
+   * \brief      Read-only view of Size consecutive elements of a column vector
+   */
+  template <std::size_t Start, std::size_t Size>
+  inline block_view<D const, Size, 1> segment() const {
+    static_assert(static_cols_v<D> == dynamic || static_cols_v<D> == 1,
+                  "Segments are only defined for column vectors");
+    static_assert(static_rows_v<D> == dynamic || Start + Size <= static_rows_v<D>,
+                  "Segment past the end of the vector");
+    return block_view<D const, Size, 1>(derived(), Start, 0, Size, 1);
+  }
+
+  /**
+   * \brief      View of a block whose size is known at compile time
+   *
+   * \param[in]  row     First row of the block
+   * \param[in]  col     First column of the block
+   *
+   * \tparam     Height  Number of rows of the block
+   * \tparam     Width   Number of columns of the block
+   *
+   * \return     The view, writable
+   */
+  template <std::size_t Height, std::size_t Width>
+  inline block_view<D, Height, Width> block(std::size_t row, std::size_t col) {
+    return block_view<D, Height, Width>(derived(), row, col, Height, Width);
+  }
+
+  /**
+   * \brief      Read-only view of a block whose size is known at compile time
+   */
+  template <std::size_t Height, std::size_t Width>
+  inline block_view<D const, Height, Width> block(std::size_t row, std::size_t col) const {
+    return block_view<D const, Height, Width>(derived(), row, col, Height, Width);
+  }
+
+  /**
+   * \brief      View of a block whose size is only known at runtime
+   *
+   * \param[in]  row     First row of the block
+   * \param[in]  col     First column of the block
+   * \param[in]  height  Number of rows of the block
+   * \param[in]  width   Number of columns of the block
+   *
+   * \return     The view, writable
+   */
+  inline block_view<D, dynamic, dynamic> block(std::size_t row, std::size_t col, std::size_t height,
+                                               std::size_t width) {
+    return block_view<D, dynamic, dynamic>(derived(), row, col, height, width);
+  }
+
+  /**
+   * \brief      Read-only view of a block whose size is only known at runtime
+   */
+  inline block_view<D const, dynamic, dynamic> block(std::size_t row, std::size_t col,
+                                                     std::size_t height, std::size_t width) const {
+    return block_view<D const, dynamic, dynamic>(derived(), row, col, height, width);
+  }
+
+private:
+  inline D &derived() {
+    return static_cast<D &>(*this);
+  }
+
+  inline D const &derived() const {
+    return static_cast<D const &>(*this);
+  }
+};
+
 /**
  * \brief      Wrapper expression for scalar values
  *
@@ -131,6 +450,12 @@ public:
    */
   using ElementType = T;
 
+  /**
+   * Scalars have no compile time dimensions
+   */
+  static constexpr std::size_t StaticRows = dynamic;
+  static constexpr std::size_t StaticCols = dynamic;
+
   /**
    * \brief      Constructor
    *
@@ -187,15 +512,18 @@ public:
  *
  * This is a 2D matrix that stores elements of any scalar type in a container
  *
- * \tparam     T     The type of an element stored in the matrix
+ * \tparam     T          The type of an element stored in the matrix
+ * \tparam     Allocator  Allocator of the container, e.g. arena_allocator<T> to take the storage
+ *                        from the current arena (see fastmatrix_arena.hpp)
  */
-template <typename T>
-class matrix : public expression<matrix<T>> {
+template <typename T, typename Allocator = default_allocator<T>>
+class matrix : public expression<matrix<T, Allocator>>,
+               public block_access<matrix<T, Allocator>> {
 private:
   /**
    * Container in which the matrix elements are stored
    */
-  std::vector<T> container;
+  std::vector<T, Allocator> container;
 
   /**
    * Number of rows of this matrix
@@ -207,17 +535,33 @@ private:
    */
   std::size_t n_cols;
 
+  /**
+   * \brief      Reports the allocation of the container to the instrumentation, if it is built in
+   */
+  inline void count_allocation() const {
+    if (!container.empty() && allocates_from_heap(container.get_allocator())) {
+      FASTMATRIX_COUNT(allocations, 1);
+      FASTMATRIX_COUNT(allocated_bytes, container.size() * sizeof(T));
+    }
+  }
+
 public:
   /**
    * Return type of eval() method
    */
-  using EvalReturnType = matrix<T>;
+  using EvalReturnType = matrix<T, Allocator>;
 
   /**
    * Type of elements of this matrix
    */
   using ElementType = T;
 
+  /**
+   * Dimensions of this matrix are only known at runtime
+   */
+  static constexpr std::size_t StaticRows = dynamic;
+  static constexpr std::size_t StaticCols = dynamic;
+
   /**
    * \brief      Default constructor to allow empty matrix construction
    */
@@ -232,7 +576,9 @@ public:
    * \param[in]  n_cols  The number of columns the matrix should have
    */
   inline matrix(std::size_t n_rows, std::size_t n_cols)
-      : container(n_rows * n_cols), n_rows(n_rows), n_cols(n_cols) {}
+      : container(n_rows * n_cols), n_rows(n_rows), n_cols(n_cols) {
+    count_allocation();
+  }
 
   /**
    * \brief      Constructor
@@ -244,14 +590,28 @@ public:
    * \param[in]  fill    The element with which to fill the container
    */
   inline matrix(std::size_t n_rows, std::size_t n_cols, T fill)
-      : container(n_rows * n_cols, fill), n_rows(n_rows), n_cols(n_cols) {}
+      : container(n_rows * n_cols, fill), n_rows(n_rows), n_cols(n_cols) {
+    count_allocation();
+  }
+
+  /**
+   * \brief      Constructor with an allocator
+   *
+   * \param[in]  n_rows     The number of rows the matrix should have
+   * \param[in]  n_cols     The number of columns the matrix should have
+   * \param[in]  allocator  The allocator of the container
+   */
+  inline matrix(std::size_t n_rows, std::size_t n_cols, Allocator const &allocator)
+      : container(n_rows * n_cols, T(), allocator), n_rows(n_rows), n_cols(n_cols) {
+    count_allocation();
+  }
 
   /**
    * \brief      Move constructor
    *
    * \param[in]  other  The matrix to construct from
    */
-  inline matrix(matrix<T> &&other)
+  inline matrix(matrix &&other)
       : container(std::move(other.container)), n_rows(other.num_rows()), n_cols(other.num_cols()) {}
 
   /**
@@ -268,13 +628,19 @@ public:
   inline matrix(expression<E> const &other)
       : container(other.num_rows() * other.num_cols()), n_rows(other.num_rows()),
         n_cols(other.num_cols()) {
-    assign(other.get_const_derived());
+    count_allocation();
+    if constexpr (evaluates_into<E>::value) {
+      evaluate_into<detail::store_assign>(*this, other);
+    } else {
+      assign(other.get_const_derived());
+    }
   }
 
   /**
    * \brief      Assignment from another expression
    *
-   * This and the move constructor trigger evaluation of an expression
+   * This and the move constructor trigger evaluation of an expression. A product that does not
+   * read this matrix is written straight into it
    *
    * \param      other  The expression
    *
@@ -286,10 +652,23 @@ public:
   inline matrix &operator=(expression<E> const &other) {
     assert(n_rows >= other.num_rows());
     assert(n_cols >= other.num_cols());
-    assign(other.get_const_derived());
+    if (n_rows != other.num_rows() || n_cols != other.num_cols()) {
+      assign(other.get_const_derived());
+    } else {
+      detail::evaluate_checked<detail::store_assign>(*this, storage_begin(), storage_end(), other);
+    }
     return *this;
   }
 
+  /**
+   * \brief      Assignments from expressions that do not read this matrix, see noalias_assignment
+   *
+   * \return     The assignment proxy
+   */
+  inline noalias_assignment<matrix> noalias() {
+    return noalias_assignment<matrix>(*this);
+  }
+
   /**
    * \brief      Move assignment operator
    *
@@ -297,7 +676,7 @@ public:
    *
    * \return     This matrix
    */
-  inline matrix &operator=(matrix<T> &&other) {
+  inline matrix &operator=(matrix &&other) {
     if (this != &other) {
       container = std::move(other.container);
       n_rows = other.n_rows;
@@ -325,10 +704,40 @@ public:
    *
    * \return     The container
    */
-  inline std::vector<T> &get_container() {
+  inline std::vector<T, Allocator> &get_container() {
     return container;
   }
 
+  /**
+   * \brief      Get a pointer to the row-major element storage
+   *
+   * \return     Pointer to the first element
+   */
+  inline T *data() {
+    return container.data();
+  }
+
+  /**
+   * \brief      Get a const pointer to the row-major element storage
+   *
+   * \return     Pointer to the first element
+   */
+  inline T const *data() const {
+    return container.data();
+  }
+
+  /**
+   * \brief      Get the range of the element storage, for aliases()
+   *
+   * \return     Pointer to the first element or one past the last respectively
+   */
+  inline T const *storage_begin() const {
+    return container.data();
+  }
+  inline T const *storage_end() const {
+    return container.data() + container.size();
+  }
+
   /**
    * \brief      Gets number of rows in this matrix
    *
@@ -355,7 +764,7 @@ public:
    *
    * \return     Const reference to this matrix
    */
-  inline const matrix<T> &eval() const {
+  inline const matrix &eval() const {
     return *this;
   }
 
@@ -373,15 +782,27 @@ public:
   /**
    * \brief      Assign an expression to this matrix
    *
+   * Unrolled when the expression has a compile time shape within unroll::limit
+   *
    * \param      expr  The expression to assign
    *
    * \tparam     E     The type of the expression
    */
   template <typename E>
   inline void assign(expression<E> const &expr) {
-    for (std::size_t i = 0; i < n_rows; ++i) {
-      for (std::size_t j = 0; j < n_cols; ++j) {
-        container[i * n_cols + j] = expr.get_const_derived()(i, j);
+    E const &e = expr.get_const_derived();
+    if constexpr (unroll::fits(static_rows_v<E>, static_cols_v<E>)) {
+      constexpr std::size_t Rows = static_rows_v<E>, Cols = static_cols_v<E>;
+      assert(n_rows == Rows && n_cols == Cols);
+      unroll::static_for<Rows>([&](auto i) FASTMATRIX_INLINE_BODY {
+        unroll::static_for<Cols>(
+            [&](auto j) FASTMATRIX_INLINE_BODY { container[i * Cols + j] = e(i, j); });
+      });
+    } else {
+      for (std::size_t i = 0; i < n_rows; ++i) {
+        for (std::size_t j = 0; j < n_cols; ++j) {
+          container[i * n_cols + j] = e(i, j);
+        }
       }
     }
   }
@@ -394,7 +815,7 @@ public:
    *
    * \return     The output stream
    */
-  friend std::ostream &operator<<(std::ostream &ostream, const matrix<T> &mat) {
+  friend std::ostream &operator<<(std::ostream &ostream, const matrix &mat) {
     for (std::size_t i = 0; i < mat.n_rows; ++i) {
       for (std::size_t j = 0; j < mat.n_cols; ++j) {
         ostream << mat(i, j) << ", ";
@@ -414,7 +835,7 @@ public:
    * \return     This matrix
    */
   template <typename E>
-  inline matrix<T> &operator+=(expression<E> const &expr);
+  inline matrix &operator+=(expression<E> const &expr);
 
   /**
    * \brief      Multiplication assignment operator with an expression
@@ -426,7 +847,7 @@ public:
    * \return     This matrix
    */
   template <typename E>
-  inline matrix<T> &operator*=(expression<E> const &expr);
+  inline matrix &operator*=(expression<E> const &expr);
 
   /**
    * \brief      Subtraction assignment operator with an expression
@@ -438,7 +859,7 @@ public:
    * \return     This matrix
    */
   template <typename E>
-  inline matrix<T> &operator-=(expression<E> const &expr);
+  inline matrix &operator-=(expression<E> const &expr);
 
   /**
    * \brief      Addition assignment operator with a scalar
@@ -450,7 +871,7 @@ public:
    * \return     This matrix
    */
   template <typename Scalar, typename = enable_if_not_expression<Scalar>>
-  inline matrix<T> &operator+=(Scalar const &expr);
+  inline matrix &operator+=(Scalar const &expr);
 
   /**
    * \brief      Subtraction assignment operator with a scalar
@@ -462,7 +883,7 @@ public:
    * \return     This matrix
    */
   template <typename Scalar, typename = enable_if_not_expression<Scalar>>
-  inline matrix<T> &operator-=(Scalar const &expr);
+  inline matrix &operator-=(Scalar const &expr);
 
   /**
    * \brief      Multiplication assignment operator with a scalar
@@ -474,223 +895,1520 @@ public:
    * \return     This matrix
    */
   template <typename Scalar, typename = enable_if_not_expression<Scalar>>
-  inline matrix<T> &operator*=(Scalar const &expr);
+  inline matrix &operator*=(Scalar const &expr);
 };
-} // namespace fastmatrix
-
-namespace std {
-using namespace fastmatrix;
 
 /**
- * \brief      Overloading common_type trait for two matrices with different element types
- *
- * \tparam     T1    Type of elements of matrix 1
- * \tparam     T2    Type of elements of matrix 2
+ * Dynamically sized matrix whose storage comes from the current arena, or the heap if there is none
  */
-template <typename T1, typename T2>
-struct common_type<matrix<T1>, matrix<T2>> {
-  using type = matrix<std::common_type_t<T1, T2>>;
-};
+template <typename T>
+using arena_matrix = matrix<T, arena_allocator<T>>;
 
 /**
- * \brief      Overloading common_type trait for a matrix and a scalar
+ * \brief      Class for a matrix whose dimensions are known at compile time
  *
- * \tparam     T1    Type of elements of matrix 1
- * \tparam     T2    Type of scalar
- */
-template <typename T1, typename T2>
-struct common_type<matrix<T1>, T2> {
-  using type = matrix<std::common_type_t<T1, T2>>;
-};
-} // namespace std
-
-namespace fastmatrix {
-
-/**
- * \brief      Template specialization for storage type of scalar expressions
+ * Elements are stored inline in a std::array rather than in a heap allocated container, so
+ * constructing, copying and evaluating into a fixed_matrix never touches the allocator. Dimensions
+ * of expressions built from fixed matrices are checked at compile time
  *
- * \tparam     T     Type of scalar
+ * \tparam     T     The type of an element stored in the matrix
+ * \tparam     Rows  The number of rows of the matrix
+ * \tparam     Cols  The number of columns of the matrix
  */
-template <typename T>
-struct storage_type<scalar_expression<T>> {
-  using type = scalar_expression<T>;
-};
+template <typename T, std::size_t Rows, std::size_t Cols>
+class fixed_matrix : public expression<fixed_matrix<T, Rows, Cols>>,
+                     public block_access<fixed_matrix<T, Rows, Cols>> {
+  static_assert(Rows != dynamic && Cols != dynamic, "fixed_matrix dimensions must be non-zero");
 
-/**
- * \brief      Class for coefficient-wise (element-wise) binary operations on matrix expressions
- *
- * \tparam     Op    Operation to be performed on the two expressions
- * \tparam     E1    Type of expression 1, must be matrix expression
- * \tparam     E2    Type of expression 2, can be matrix or scalar expression
- */
-template <typename Op, typename E1, typename E2>
-class cwise_matrix_binary_operation : public expression<cwise_matrix_binary_operation<Op, E1, E2>> {
 private:
   /**
-   * Expression 1
+   * Container in which the matrix elements are stored, zero initialized
    */
-  E1 const &expr1;
+  std::array<T, Rows * Cols> container{};
 
+public:
   /**
-   * Expression 2, using storage_type trait as matrix expressions are stored as const references and
-   * scalar expressions are stored by value
+   * Return type of eval() method
    */
-  storage_type_t<E2> expr2;
+  using EvalReturnType = fixed_matrix<T, Rows, Cols>;
 
-public:
   /**
-   * Return type of eval() method
+   * Type of elements of this matrix
    */
-  using EvalReturnType = std::common_type_t<eval_return_type_t<E1>, eval_return_type_t<E2>>;
+  using ElementType = T;
 
   /**
-   * Type of elements of this expression
+   * Compile time dimensions of this matrix
    */
-  using ElementType = std::common_type_t<element_type_t<E1>, element_type_t<E2>>;
+  static constexpr std::size_t StaticRows = Rows;
+  static constexpr std::size_t StaticCols = Cols;
 
   /**
-   * \brief      Constructor
-   *
-   * \param      expr1  Expression 1
-   * \param      expr2  Expression 2
+   * \brief      Default constructor, all elements are zero
    */
-  inline cwise_matrix_binary_operation(expression<E1> const &expr1, expression<E2> const &expr2)
-      : expr1(expr1.get_const_derived()), expr2(expr2.get_const_derived()) {}
+  inline fixed_matrix() = default;
 
   /**
-   * \brief      Function call operator to get an element of this matrix
-   *
-   * This uses lazy evaluation when possible to apply an operation only to the required elements of
-   * expression 1 and 2
+   * \brief      Constructor
    *
-   * \param[in]  i     Row number of the element to get
-   * \param[in]  j     Column number of the element to get
+   * Exists so that generic code which sizes its temporaries at runtime also works with fixed
+   * matrices. The given dimensions must match the compile time ones
    *
-   * \return     The desired element
+   * \param[in]  n_rows  The number of rows, must equal Rows
+   * \param[in]  n_cols  The number of columns, must equal Cols
    */
-  inline ElementType operator()(std::size_t i, std::size_t j) const {
-    return Op::apply(expr1, expr2, i, j);
+  inline fixed_matrix(std::size_t n_rows, std::size_t n_cols) {
+    assert(n_rows == Rows);
+    assert(n_cols == Cols);
   }
 
   /**
-   * \brief      Evaluates this expression fully and returns the resultant matrix
+   * \brief      Constructor
    *
-   * This can also be triggered by a user of this library manually when they think that eagerly
+   * Fills the container with the given value
+   *
+   * \param[in]  n_rows  The number of rows, must equal Rows
+   * \param[in]  n_cols  The number of columns, must equal Cols
+   * \param[in]  fill    The element with which to fill the container
+   */
+  inline fixed_matrix(std::size_t n_rows, std::size_t n_cols, T fill) {
+    assert(n_rows == Rows);
+    assert(n_cols == Cols);
+    container.fill(fill);
+  }
+
+  /**
+   * \brief      Constructor from another expression
+   *
+   * \param      other  The expression
+   *
+   * \tparam     E      The type of the expression
+   */
+  template <typename E>
+  inline fixed_matrix(expression<E> const &other) {
+    static_assert(dimensions_match(static_rows_v<E>, Rows), "Row count of expression differs");
+    static_assert(dimensions_match(static_cols_v<E>, Cols), "Column count of expression differs");
+    assert(other.num_rows() == Rows);
+    assert(other.num_cols() == Cols);
+    if constexpr (evaluates_into<E>::value) {
+      evaluate_into<detail::store_assign>(*this, other);
+    } else {
+      assign(other.get_const_derived());
+    }
+  }
+
+  /**
+   * \brief      Assignment from another expression
+   *
+   * A product that does not read this matrix is written straight into it
+   *
+   * \param      other  The expression
+   *
+   * \tparam     E      The type of the expression
+   *
+   * \return     This matrix
+   */
+  template <typename E>
+  inline fixed_matrix &operator=(expression<E> const &other) {
+    static_assert(dimensions_match(static_rows_v<E>, Rows), "Row count of expression differs");
+    static_assert(dimensions_match(static_cols_v<E>, Cols), "Column count of expression differs");
+    assert(other.num_rows() == Rows);
+    assert(other.num_cols() == Cols);
+    detail::evaluate_checked<detail::store_assign>(*this, storage_begin(), storage_end(), other);
+    return *this;
+  }
+
+  /**
+   * \brief      Assignments from expressions that do not read this matrix, see noalias_assignment
+   *
+   * \return     The assignment proxy
+   */
+  inline noalias_assignment<fixed_matrix> noalias() {
+    return noalias_assignment<fixed_matrix>(*this);
+  }
+
+  /**
+   * \brief      Returns the identity matrix
+   *
+   * \return     Matrix with ones on the diagonal and zeros elsewhere
+   */
+  static inline fixed_matrix identity() {
+    static_assert(Rows == Cols, "Identity matrix must be square");
+    fixed_matrix result;
+    for (std::size_t i = 0; i < Rows; ++i) {
+      result.container[i * Cols + i] = T(1);
+    }
+    return result;
+  }
+
+  /**
+   * \brief      Function operator to return elements of this matrix
+   *
+   * \param[in]  i     Row number of the element to return
+   * \param[in]  j     Column number of the element to return
+   *
+   * \return     The desired element
+   */
+  inline T operator()(std::size_t i, std::size_t j) const {
+    assert(i < Rows);
+    assert(j < Cols);
+    return container[i * Cols + j];
+  }
+
+  /**
+   * \brief      Get a reference to the underlying storage container
+   *
+   * \return     The container
+   */
+  inline std::array<T, Rows * Cols> &get_container() {
+    return container;
+  }
+
+  /**
+   * \brief      Get a pointer to the row-major element storage
+   *
+   * \return     Pointer to the first element
+   */
+  inline T *data() {
+    return container.data();
+  }
+
+  /**
+   * \brief      Get a const pointer to the row-major element storage
+   *
+   * \return     Pointer to the first element
+   */
+  inline T const *data() const {
+    return container.data();
+  }
+
+  /**
+   * \brief      Get the range of the element storage, for aliases()
+   *
+   * \return     Pointer to the first element or one past the last respectively
+   */
+  inline T const *storage_begin() const {
+    return container.data();
+  }
+  inline T const *storage_end() const {
+    return container.data() + container.size();
+  }
+
+  /**
+   * \brief      Gets number of rows in this matrix
+   *
+   * \return     Number of rows
+   */
+  static constexpr std::size_t num_rows() {
+    return Rows;
+  }
+
+  /**
+   * \brief      Gets number of columns in this matrix
+   *
+   * \return     Number of columns
+   */
+  static constexpr std::size_t num_cols() {
+    return Cols;
+  }
+
+  /**
+   * \brief      Evaluate this expression
+   *
+   * \return     Const reference to this matrix
+   */
+  inline const fixed_matrix &eval() const {
+    return *this;
+  }
+
+  /**
+   * \brief      Set an element of this matrix
+   *
+   * \param[in]  i      Row number of the element to set
+   * \param[in]  j      Column number of this element to set
+   * \param[in]  value  The new value of the element
+   */
+  inline void set_elt(std::size_t i, std::size_t j, T value) {
+    assert(i < Rows);
+    assert(j < Cols);
+    container[i * Cols + j] = value;
+  }
+
+  /**
+   * \brief      Assign an expression to this matrix
+   *
+   * Unrolled when the shape is within unroll::limit
+   *
+   * \param      expr  The expression to assign
+   *
+   * \tparam     E     The type of the expression
+   */
+  template <typename E>
+  inline void assign(expression<E> const &expr) {
+    E const &e = expr.get_const_derived();
+    if constexpr (unroll::fits(Rows, Cols)) {
+      unroll::static_for<Rows>([&](auto i) FASTMATRIX_INLINE_BODY {
+        unroll::static_for<Cols>(
+            [&](auto j) FASTMATRIX_INLINE_BODY { container[i * Cols + j] = e(i, j); });
+      });
+    } else {
+      for (std::size_t i = 0; i < Rows; ++i) {
+        for (std::size_t j = 0; j < Cols; ++j) {
+          container[i * Cols + j] = e(i, j);
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief      The stream operator to print the matrix easily
+   *
+   * \param      ostream  The output stream
+   * \param[in]  mat      The matrix
+   *
+   * \return     The output stream
+   */
+  friend std::ostream &operator<<(std::ostream &ostream, const fixed_matrix &mat) {
+    for (std::size_t i = 0; i < Rows; ++i) {
+      for (std::size_t j = 0; j < Cols; ++j) {
+        ostream << mat(i, j) << ", ";
+      }
+      ostream << "\n";
+    }
+    return ostream;
+  }
+
+  /**
+   * \brief      Addition assignment operator with an expression
+   *
+   * \param      expr  The expression
+   *
+   * \tparam     E     The type of the expression
+   *
+   * \return     This matrix
+   */
+  template <typename E>
+  inline fixed_matrix &operator+=(expression<E> const &expr);
+
+  /**
+   * \brief      Multiplication assignment operator with an expression
+   *
+   * \param      expr  The expression
+   *
+   * \tparam     E     The type of the expression
+   *
+   * \return     This matrix
+   */
+  template <typename E>
+  inline fixed_matrix &operator*=(expression<E> const &expr);
+
+  /**
+   * \brief      Subtraction assignment operator with an expression
+   *
+   * \param      expr  The expression
+   *
+   * \tparam     E     The type of the expression
+   *
+   * \return     This matrix
+   */
+  template <typename E>
+  inline fixed_matrix &operator-=(expression<E> const &expr);
+
+  /**
+   * \brief      Addition assignment operator with a scalar
+   *
+   * \param      expr    The expression
+   *
+   * \tparam     Scalar  The type of the scalar
+   *
+   * \return     This matrix
+   */
+  template <typename Scalar, typename = enable_if_not_expression<Scalar>>
+  inline fixed_matrix &operator+=(Scalar const &expr);
+
+  /**
+   * \brief      Subtraction assignment operator with a scalar
+   *
+   * \param      expr    The expression
+   *
+   * \tparam     Scalar  The type of the scalar
+   *
+   * \return     This matrix
+   */
+  template <typename Scalar, typename = enable_if_not_expression<Scalar>>
+  inline fixed_matrix &operator-=(Scalar const &expr);
+
+  /**
+   * \brief      Multiplication assignment operator with a scalar
+   *
+   * \param      expr    The expression
+   *
+   * \tparam     Scalar  The type of the scalar
+   *
+   * \return     This matrix
+   */
+  template <typename Scalar, typename = enable_if_not_expression<Scalar>>
+  inline fixed_matrix &operator*=(Scalar const &expr);
+};
+} // namespace fastmatrix
+
+namespace std {
+using namespace fastmatrix;
+
+/**
+ * \brief      Overloading common_type trait for two matrices with different element types
+ *
+ * \tparam     T1    Type of elements of matrix 1
+ * \tparam     A1    Allocator of matrix 1, which the result takes
+ * \tparam     T2    Type of elements of matrix 2
+ * \tparam     A2    Allocator of matrix 2
+ */
+template <typename T1, typename A1, typename T2, typename A2>
+struct common_type<matrix<T1, A1>, matrix<T2, A2>> {
+  using type = matrix<std::common_type_t<T1, T2>,
+                      typename std::allocator_traits<A1>::template rebind_alloc<
+                          std::common_type_t<T1, T2>>>;
+};
+
+/**
+ * \brief      Overloading common_type trait for a matrix and a scalar
+ *
+ * \tparam     T1    Type of elements of matrix 1
+ * \tparam     A1    Allocator of matrix 1
+ * \tparam     T2    Type of scalar
+ */
+template <typename T1, typename A1, typename T2>
+struct common_type<matrix<T1, A1>, T2> {
+  using type = matrix<std::common_type_t<T1, T2>,
+                      typename std::allocator_traits<A1>::template rebind_alloc<
+                          std::common_type_t<T1, T2>>>;
+};
+
+/**
+ * \brief      Overloading common_type trait for two fixed matrices of the same dimensions
+ *
+ * \tparam     T1    Type of elements of matrix 1
+ * \tparam     T2    Type of elements of matrix 2
+ * \tparam     R     Number of rows
+ * \tparam     C     Number of columns
+ */
+template <typename T1, typename T2, std::size_t R, std::size_t C>
+struct common_type<fixed_matrix<T1, R, C>, fixed_matrix<T2, R, C>> {
+  using type = fixed_matrix<std::common_type_t<T1, T2>, R, C>;
+};
+
+/**
+ * \brief      Overloading common_type trait for a fixed matrix and a scalar
+ *
+ * \tparam     T1    Type of elements of the matrix
+ * \tparam     R     Number of rows
+ * \tparam     C     Number of columns
+ * \tparam     T2    Type of scalar
+ */
+template <typename T1, std::size_t R, std::size_t C, typename T2>
+struct common_type<fixed_matrix<T1, R, C>, T2> {
+  using type = fixed_matrix<std::common_type_t<T1, T2>, R, C>;
+};
+
+/**
+ * \brief      Overloading common_type trait for a fixed matrix and a dynamic matrix, which decays to
+ * a dynamic matrix
+ *
+ * \tparam     T1    Type of elements of the fixed matrix
+ * \tparam     R     Number of rows
+ * \tparam     C     Number of columns
+ * \tparam     T2    Type of elements of the dynamic matrix
+ * \tparam     A2    Allocator of the dynamic matrix
+ */
+template <typename T1, std::size_t R, std::size_t C, typename T2, typename A2>
+struct common_type<fixed_matrix<T1, R, C>, matrix<T2, A2>> {
+  using type = matrix<std::common_type_t<T1, T2>,
+                      typename std::allocator_traits<A2>::template rebind_alloc<
+                          std::common_type_t<T1, T2>>>;
+};
+
+/**
+ * \brief      Overloading common_type trait for a dynamic matrix and a fixed matrix, which decays to
+ * a dynamic matrix
+ *
+ * \tparam     T1    Type of elements of the dynamic matrix
+ * \tparam     A1    Allocator of the dynamic matrix
+ * \tparam     T2    Type of elements of the fixed matrix
+ * \tparam     R     Number of rows
+ * \tparam     C     Number of columns
+ */
+template <typename T1, typename A1, typename T2, std::size_t R, std::size_t C>
+struct common_type<matrix<T1, A1>, fixed_matrix<T2, R, C>> {
+  using type = matrix<std::common_type_t<T1, T2>,
+                      typename std::allocator_traits<A1>::template rebind_alloc<
+                          std::common_type_t<T1, T2>>>;
+};
+} // namespace std
+
+namespace fastmatrix {
+
+/**
+ * \brief      Template specialization for storage type of scalar expressions
+ *
+ * \tparam     T     Type of scalar
+ */
+template <typename T>
+struct storage_type<scalar_expression<T>> {
+  using type = scalar_expression<T>;
+};
+
+/**
+ * \brief      Trait returning the type a matrix product of two expressions evaluates to
+ *
+ * A product of two expressions whose outer dimensions are both known at compile time evaluates to
+ * a fixed_matrix, anything else evaluates to a dynamically sized matrix
+ *
+ * \tparam     E1    Type of expression 1
+ * \tparam     E2    Type of expression 2
+ */
+template <typename E1, typename E2,
+          bool Fixed = static_rows_v<E1> != dynamic && static_cols_v<E2> != dynamic>
+struct product_return_type {
+  using type = matrix<std::common_type_t<element_type_t<E1>, element_type_t<E2>>>;
+};
+
+/**
+ * \brief      Template specialization of product_return_type for products with compile time
+ * dimensions
+ *
+ * \tparam     E1    Type of expression 1
+ * \tparam     E2    Type of expression 2
+ */
+template <typename E1, typename E2>
+struct product_return_type<E1, E2, true> {
+  using type = fixed_matrix<std::common_type_t<element_type_t<E1>, element_type_t<E2>>,
+                            static_rows_v<E1>, static_cols_v<E2>>;
+};
+
+/**
+ * Convenience typedef of product_return_type
+ */
+template <typename E1, typename E2>
+using product_return_type_t = typename product_return_type<E1, E2>::type;
+
+/**
+ * \brief      Trait returning the matrix type to evaluate into given an element type and compile time
+ * dimensions, a fixed_matrix if both are known and a dynamically sized matrix otherwise
+ *
+ * \tparam     T     Type of elements
+ * \tparam     R     Number of rows, or dynamic
+ * \tparam     C     Number of columns, or dynamic
+ */
+template <typename T, std::size_t R, std::size_t C, bool Fixed = R != dynamic && C != dynamic>
+struct dense_matrix_type {
+  using type = matrix<T>;
+};
+
+/**
+ * \brief      Template specialization of dense_matrix_type for compile time dimensions
+ *
+ * \tparam     T     Type of elements
+ * \tparam     R     Number of rows
+ * \tparam     C     Number of columns
+ */
+template <typename T, std::size_t R, std::size_t C>
+struct dense_matrix_type<T, R, C, true> {
+  using type = fixed_matrix<T, R, C>;
+};
+
+/**
+ * Convenience typedef of dense_matrix_type
+ */
+template <typename T, std::size_t R, std::size_t C>
+using dense_matrix_type_t = typename dense_matrix_type<T, R, C>::type;
+
+/**
+ * \brief      Template specialization of has_direct_access for matrices
+ *
+ * \tparam     T          Type of elements
+ * \tparam     Allocator  Allocator of the container
+ */
+template <typename T, typename Allocator>
+struct has_direct_access<matrix<T, Allocator>> : std::true_type {};
+
+/**
+ * \brief      Template specialization of has_direct_access for fixed matrices
+ *
+ * \tparam     T     Type of elements
+ * \tparam     R     Number of rows
+ * \tparam     C     Number of columns
+ */
+template <typename T, std::size_t R, std::size_t C>
+struct has_direct_access<fixed_matrix<T, R, C>> : std::true_type {};
+
+/**
+ * \brief      Dot product of row i of an expression with a vector
+ *
+ * The products compute every element through this function, which makes it their customization
+ * point: expressions with a known sparsity structure overload it to skip structural zeros (see
+ * block_matrix). Terms are accumulated in column order, unrolled when the number of columns is
+ * known at compile time and within unroll::limit
+ *
+ * \param      expr  The expression
+ * \param[in]  i     Row number
+ * \param      v     Function returning element j of the vector
+ *
+ * \tparam     E     Type of the expression
+ * \tparam     V     Type of the function
+ *
+ * \return     The sum over j of expr(i, j) * v(j)
+ */
+template <typename E, typename V>
+inline auto row_dot(expression<E> const &expr, std::size_t i, V const &v) {
+  E const &e = expr.get_const_derived();
+  auto sum = e(i, 0) * v(0);
+  if constexpr (unroll::fits(static_cols_v<E>)) {
+    unroll::static_for<static_cols_v<E> - 1>(
+        [&](auto j) FASTMATRIX_INLINE_BODY { sum = e(i, j + 1) * v(j + 1) + sum; });
+  } else {
+    for (std::size_t j = 1; j < e.num_cols(); ++j) {
+      sum = e(i, j) * v(j) + sum;
+    }
+  }
+  return sum;
+}
+
+/**
+ * \brief      Class for coefficient-wise (element-wise) binary operations on matrix expressions
+ *
+ * \tparam     Op    Operation to be performed on the two expressions
+ * \tparam     E1    Type of expression 1, must be matrix expression
+ * \tparam     E2    Type of expression 2, can be matrix or scalar expression
+ */
+template <typename Op, typename E1, typename E2>
+class cwise_matrix_binary_operation : public expression<cwise_matrix_binary_operation<Op, E1, E2>> {
+private:
+  /**
+   * Expression 1
+   */
+  E1 const &expr1;
+
+  /**
+   * Expression 2, using storage_type trait as matrix expressions are stored as const references and
+   * scalar expressions are stored by value
+   */
+  storage_type_t<E2> expr2;
+
+public:
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = std::common_type_t<eval_return_type_t<E1>, eval_return_type_t<E2>>;
+
+  /**
+   * Type of elements of this expression
+   */
+  using ElementType = std::common_type_t<element_type_t<E1>, element_type_t<E2>>;
+
+  /**
+   * Compile time dimensions of this expression, which are those of expression 1
+   */
+  static constexpr std::size_t StaticRows = static_rows_v<E1>;
+  static constexpr std::size_t StaticCols = static_cols_v<E1>;
+
+  /**
+   * \brief      Constructor
+   *
+   * \param      expr1  Expression 1
+   * \param      expr2  Expression 2
+   */
+  inline cwise_matrix_binary_operation(expression<E1> const &expr1, expression<E2> const &expr2)
+      : expr1(expr1.get_const_derived()), expr2(expr2.get_const_derived()) {}
+
+  /**
+   * \brief      Get the operands of this operation
+   *
+   * \return     Expression 1 or 2 respectively
+   */
+  inline E1 const &lhs() const {
+    return expr1;
+  }
+  inline E2 const &rhs() const {
+    return expr2;
+  }
+
+  /**
+   * \brief      Function call operator to get an element of this matrix
+   *
+   * This uses lazy evaluation when possible to apply an operation only to the required elements of
+   * expression 1 and 2
+   *
+   * \param[in]  i     Row number of the element to get
+   * \param[in]  j     Column number of the element to get
+   *
+   * \return     The desired element
+   */
+  inline ElementType operator()(std::size_t i, std::size_t j) const {
+    return Op::apply(expr1, expr2, i, j);
+  }
+
+  /**
+   * \brief      Evaluates this expression fully and returns the resultant matrix
+   *
+   * This can also be triggered by a user of this library manually when they think that eagerly
    * evaluating an expression is beneficial, e.g.: a * (b + c) would benefit from eager evaluation
    * of b + c to prevent repeated calculations of the sum b + c. Thus, it could be re-written as
    * a * (b + c).eval()
    *
-   * \return     The result of evaluating this expression
+   * \return     The result of evaluating this expression
+   */
+  inline const EvalReturnType eval() const {
+    EvalReturnType temp(num_rows(), num_cols());
+    temp.assign((*this));
+    return temp;
+  }
+
+  /**
+   * \brief      Gets number of rows in this expression
+   *
+   * \return     Number of rows
+   */
+  inline std::size_t num_rows() const {
+    return expr1.num_rows();
+  }
+
+  /**
+   * \brief      Gets the number of columns in this expression
+   *
+   * \return     Number of columns
+   */
+  inline std::size_t num_cols() const {
+    return expr1.num_cols();
+  }
+};
+
+/**
+ * \brief      Makes a cwise matrix binary operation
+ *
+ * Helps with template argument inference, so that the types of operands need not be specified while
+ * specifying the operator
+ *
+ * \param      expr1  Expression 1
+ * \param      expr2  Expression 2
+ *
+ * \tparam     Op     Type of operation
+ * \tparam     E1     Type of expression 1
+ * \tparam     E2     Type of expression 2
+ *
+ * \return     A cwise matrix binary operation
+ */
+template <template <typename E1, typename E2> typename Op, typename E1, typename E2>
+cwise_matrix_binary_operation<Op<E1, E2>, E1, E2>
+make_cwise_matrix_binary_operation(expression<E1> const &expr1, expression<E2> const &expr2) {
+  return cwise_matrix_binary_operation<Op<E1, E2>, E1, E2>(expr1, expr2);
+}
+
+/**
+ * \brief      Class to represent a matrix product
+ *
+ * Matrix products are evaluated into a temporary as a whole, the first time any of their elements
+ * is needed, as statements like x = x * a would give incorrect results if each element were
+ * computed on demand. The full product is known before the first element of x is overwritten.
+ * Assigning a product to a matrix it does not read skips the temporary and writes the product
+ * straight into the matrix, see evaluate_into and aliases
+ *
+ * Deferring the evaluation until then lets a product whose result only feeds another product, as
+ * in a * b * c, be fused into a triple_product without ever being evaluated
+ *
+ * \tparam     E1    Type of expression 1
+ * \tparam     E2    Type of expression 2
+ */
+template <typename E1, typename E2>
+class matrix_product : public expression<matrix_product<E1, E2>> {
+public:
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = product_return_type_t<E1, E2>;
+
+  /**
+   * Type of an element in this matrix product
+   */
+  using ElementType = std::common_type_t<element_type_t<E1>, element_type_t<E2>>;
+
+  /**
+   * Compile time dimensions of this matrix product
+   */
+  static constexpr std::size_t StaticRows = static_rows_v<E1>;
+  static constexpr std::size_t StaticCols = static_cols_v<E2>;
+
+private:
+  /**
+   * Expression 1
+   */
+  E1 const &expr1;
+
+  /**
+   * Expression 2
+   */
+  E2 const &expr2;
+
+  /**
+   * Temporary to store the product of the two expressions, sized on evaluation
+   */
+  mutable EvalReturnType temp;
+
+  /**
+   * Whether temp holds the product yet
+   */
+  mutable bool evaluated = false;
+
+  /**
+   * Whether both operands are dense arrays of the same floating point type, in which case the
+   * product runs through the blocked SIMD kernels in fastmatrix_gemm.hpp instead of element access
+   */
+  static constexpr bool uses_gemm =
+      has_direct_access<E1>::value && has_direct_access<E2>::value &&
+      std::is_same<element_type_t<E1>, ElementType>::value &&
+      std::is_same<element_type_t<E2>, ElementType>::value && gemm::is_supported<ElementType>::value;
+
+  /**
+   * \brief      Computes the product into a dense destination, combined with it as Store says
+   *
+   * \param      out   The destination
+   */
+  template <typename Store, typename D>
+  inline void compute(D &out) const {
+    FASTMATRIX_COUNT(flops, 2 * num_rows() * expr1.num_cols() * num_cols());
+    FASTMATRIX_COUNT(bytes, (num_rows() * expr1.num_cols() + expr1.num_cols() * num_cols() +
+                             num_rows() * num_cols()) *
+                                sizeof(ElementType));
+    if constexpr (uses_gemm && std::is_same<Store, detail::store_assign>::value &&
+                  std::is_same<element_type_t<D>, ElementType>::value) {
+      if constexpr (unroll::fits(StaticRows, static_cols_v<E1>, StaticCols)) {
+        gemm::multiply_fixed<StaticRows, static_cols_v<E1>, StaticCols>(expr1.data(), expr2.data(),
+                                                                         out.data());
+      } else {
+        gemm::multiply(expr1.data(), expr2.data(), out.data(), num_rows(), expr1.num_cols(),
+                       num_cols());
+      }
+    } else if constexpr (unroll::fits(StaticRows, StaticCols)) {
+      unroll::static_for<StaticRows>([&](auto i) FASTMATRIX_INLINE_BODY {
+        unroll::static_for<StaticCols>([&](auto j) FASTMATRIX_INLINE_BODY {
+          Store::apply(out, i, j,
+                       row_dot(expr1, i,
+                               [&](std::size_t k) FASTMATRIX_INLINE_BODY { return expr2(k, j); }));
+        });
+      });
+    } else {
+      for (std::size_t i = 0; i < num_rows(); ++i) {
+        for (std::size_t j = 0; j < num_cols(); ++j) {
+          Store::apply(out, i, j,
+                       row_dot(expr1, i,
+                               [&](std::size_t k) FASTMATRIX_INLINE_BODY { return expr2(k, j); }));
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief      Computes the product into the temporary unless that has already been done
+   */
+  inline void evaluate() const {
+    if (evaluated) {
+      return;
+    }
+    if constexpr (StaticRows == dynamic || StaticCols == dynamic) {
+      temp = EvalReturnType(num_rows(), num_cols());
+    }
+    FASTMATRIX_COUNT(temporaries, 1);
+    compute<detail::store_assign>(temp);
+    evaluated = true;
+  }
+
+public:
+  /**
+   * \brief      Constructor
+   *
+   * Only stores the operands, the product is computed when it is first accessed
+   *
+   * \param      expr1  Expression 1
+   * \param      expr2  Expression 2
+   */
+  inline matrix_product(expression<E1> const &expr1, expression<E2> const &expr2)
+      : expr1(expr1.get_const_derived()), expr2(expr2.get_const_derived()) {}
+
+  /**
+   * \brief      Get the left operand of this product
+   *
+   * \return     Expression 1
+   */
+  inline E1 const &lhs() const {
+    return expr1;
+  }
+
+  /**
+   * \brief      Get the right operand of this product
+   *
+   * \return     Expression 2
+   */
+  inline E2 const &rhs() const {
+    return expr2;
+  }
+
+  /**
+   * \brief      Writes the product into a destination it does not alias, see evaluate_into
+   *
+   * Dense destinations get the product directly, except that the blocked kernels only overwrite,
+   * so adding a product they compute still goes through the temporary
+   *
+   * \param      dst    The destination
+   *
+   * \tparam     Store  How to combine the product with the destination
+   * \tparam     D      Type of the destination
+   */
+  template <typename Store, typename D>
+  inline void store_into(D &dst) const {
+    assert(dst.num_rows() == num_rows());
+    assert(dst.num_cols() == num_cols());
+    if constexpr (has_direct_access<D>::value &&
+                  (!uses_gemm || std::is_same<Store, detail::store_assign>::value)) {
+      if (!evaluated) {
+        compute<Store>(dst);
+        return;
+      }
+    }
+    Store::assign(dst, eval());
+  }
+
+  /**
+   * \brief      Get a const pointer to the row-major storage of the evaluated product
+   *
+   * \return     Pointer to the first element
+   */
+  inline ElementType const *data() const {
+    evaluate();
+    return temp.data();
+  }
+
+  /**
+   * \brief      Function call operator to get an element of the matrix product
+   *
+   * \param[in]  i     Row number of the element to get
+   * \param[in]  j     Column number of the element to get
+   *
+   * \return     The desired element
+   */
+  inline ElementType operator()(std::size_t i, std::size_t j) const {
+    evaluate();
+    return temp(i, j);
+  }
+
+  /**
+   * \brief      Evaluate and return the result of this expression
+   *
+   * \return     Reference to the temporary holding the product
+   */
+  inline EvalReturnType const &eval() const {
+    evaluate();
+    return temp;
+  }
+
+  /**
+   * \brief      Get number of rows of this matrix product
+   *
+   * \return     Number of rows
+   */
+  inline std::size_t num_rows() const {
+    return expr1.num_rows();
+  }
+
+  /**
+   * \brief      Get number of columns of this matrix product
+   *
+   * \return     Number of columns
+   */
+  inline std::size_t num_cols() const {
+    return expr2.num_cols();
+  }
+};
+
+/**
+ * \brief      Template specialization of has_direct_access for matrix products, whose result is held
+ * in a matrix temporary
+ *
+ * \tparam     E1    Type of expression 1
+ * \tparam     E2    Type of expression 2
+ */
+template <typename E1, typename E2>
+struct has_direct_access<matrix_product<E1, E2>> : std::true_type {};
+
+/**
+ * \brief      Zero-copy view of the transpose of an expression
+ *
+ * Reads through to the wrapped expression with its indices swapped. Assigning a transpose view of a
+ * matrix to that same matrix goes through a temporary, see aliases
+ *
+ * \tparam     E     Type of the wrapped expression
+ */
+template <typename E>
+class transpose_expression : public expression<transpose_expression<E>> {
+private:
+  /**
+   * The wrapped expression
+   */
+  E const &expr;
+
+public:
+  /**
+   * Type of elements of this expression
+   */
+  using ElementType = element_type_t<E>;
+
+  /**
+   * Compile time dimensions of this expression, those of the wrapped expression swapped
+   */
+  static constexpr std::size_t StaticRows = static_cols_v<E>;
+  static constexpr std::size_t StaticCols = static_rows_v<E>;
+
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = dense_matrix_type_t<ElementType, StaticRows, StaticCols>;
+
+  /**
+   * \brief      Constructor
+   *
+   * \param      expr  The expression to transpose
+   */
+  inline transpose_expression(expression<E> const &expr) : expr(expr.get_const_derived()) {}
+
+  /**
+   * \brief      Get the expression being transposed
+   *
+   * \return     The wrapped expression
+   */
+  inline E const &nested() const {
+    return expr;
+  }
+
+  /**
+   * \brief      Function call operator to get an element of the transpose
+   *
+   * \param[in]  i     Row number of the element to get
+   * \param[in]  j     Column number of the element to get
+   *
+   * \return     Element (j, i) of the wrapped expression
+   */
+  inline ElementType operator()(std::size_t i, std::size_t j) const {
+    return expr(j, i);
+  }
+
+  /**
+   * \brief      Evaluates the transpose into a new matrix
+   *
+   * \return     The transposed matrix
+   */
+  inline const EvalReturnType eval() const {
+    EvalReturnType temp(num_rows(), num_cols());
+    temp.assign(*this);
+    return temp;
+  }
+
+  /**
+   * \brief      Gets number of rows of the transpose
+   *
+   * \return     Number of columns of the wrapped expression
+   */
+  inline std::size_t num_rows() const {
+    return expr.num_cols();
+  }
+
+  /**
+   * \brief      Gets number of columns of the transpose
+   *
+   * \return     Number of rows of the wrapped expression
+   */
+  inline std::size_t num_cols() const {
+    return expr.num_rows();
+  }
+};
+
+/**
+ * \brief      Makes a transpose view of an expression
+ *
+ * \param      expr  The expression
+ *
+ * \tparam     E     Type of the expression
+ *
+ * \return     The transpose view
+ */
+template <typename E>
+inline transpose_expression<E> transpose(expression<E> const &expr) {
+  return transpose_expression<E>(expr);
+}
+
+/**
+ * \brief      Zero-copy view of a rectangular block of a matrix, made by the segment() and block()
+ * methods of the matrix
+ *
+ * Reads and writes go straight to the elements of the viewed matrix, so a view can be used in an
+ * expression or be assigned one without copying the block out and back. An expression that reads
+ * the viewed matrix, such as an overlapping view, is evaluated into a temporary before it is
+ * assigned. Setting an element of a view of a symmetric_matrix also sets its mirror.
+ *
+ * The view holds a reference to the matrix, which must outlive it
+ *
+ * \tparam     M     Type of the viewed matrix, const for a read-only view
+ * \tparam     Rows  Number of rows of the block, or dynamic
+ * \tparam     Cols  Number of columns of the block, or dynamic
+ */
+template <typename M, std::size_t Rows, std::size_t Cols>
+class block_view : public expression<block_view<M, Rows, Cols>> {
+private:
+  /**
+   * The viewed matrix
+   */
+  M &mat;
+
+  /**
+   * Position of the first element of the block in the matrix
+   */
+  std::size_t row0, col0;
+
+  /**
+   * Dimensions of the block
+   */
+  std::size_t n_rows, n_cols;
+
+public:
+  /**
+   * Type of elements of this expression
+   */
+  using ElementType = element_type_t<std::remove_const_t<M>>;
+
+  /**
+   * Compile time dimensions of this expression
+   */
+  static constexpr std::size_t StaticRows = Rows;
+  static constexpr std::size_t StaticCols = Cols;
+
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = dense_matrix_type_t<ElementType, Rows, Cols>;
+
+  /**
+   * \brief      Constructor
+   *
+   * \param      mat     The viewed matrix
+   * \param[in]  row     First row of the block
+   * \param[in]  col     First column of the block
+   * \param[in]  n_rows  Number of rows, must equal Rows unless it is dynamic
+   * \param[in]  n_cols  Number of columns, must equal Cols unless it is dynamic
+   */
+  inline block_view(M &mat, std::size_t row, std::size_t col, std::size_t n_rows, std::size_t n_cols)
+      : mat(mat), row0(row), col0(col), n_rows(n_rows), n_cols(n_cols) {
+    assert(Rows == dynamic || n_rows == Rows);
+    assert(Cols == dynamic || n_cols == Cols);
+    assert(row + n_rows <= mat.num_rows());
+    assert(col + n_cols <= mat.num_cols());
+  }
+
+  /**
+   * \brief      Get the viewed matrix
+   *
+   * \return     The matrix
+   */
+  inline M const &viewed() const {
+    return mat;
+  }
+
+  /**
+   * \brief      Assignment from another expression, element by element into the viewed matrix
+   *
+   * \param      other  The expression
+   *
+   * \tparam     E      The type of the expression
+   *
+   * \return     This view
+   */
+  template <typename E>
+  inline block_view &operator=(expression<E> const &other) {
+    static_assert(dimensions_match(static_rows_v<E>, Rows), "Row count of expression differs");
+    static_assert(dimensions_match(static_cols_v<E>, Cols), "Column count of expression differs");
+    assert(other.num_rows() == num_rows());
+    assert(other.num_cols() == num_cols());
+    detail::evaluate_checked<detail::store_assign>(*this, mat.storage_begin(), mat.storage_end(),
+                                                   other);
+    return *this;
+  }
+
+  /**
+   * \brief      Assignment from another view, copies the elements rather than rebinding the view
+   *
+   * \param      other  The view
+   *
+   * \return     This view
+   */
+  inline block_view &operator=(block_view const &other) {
+    assert(other.num_rows() == num_rows());
+    assert(other.num_cols() == num_cols());
+    detail::evaluate_checked<detail::store_assign>(*this, mat.storage_begin(), mat.storage_end(),
+                                                   other);
+    return *this;
+  }
+
+  /**
+   * \brief      Function call operator to get an element of the block
+   *
+   * \param[in]  i     Row number within the block
+   * \param[in]  j     Column number within the block
+   *
+   * \return     The element of the viewed matrix
+   */
+  inline ElementType operator()(std::size_t i, std::size_t j) const {
+    assert(i < num_rows());
+    assert(j < num_cols());
+    return mat(row0 + i, col0 + j);
+  }
+
+  /**
+   * \brief      Set an element of the block in the viewed matrix
+   *
+   * \param[in]  i      Row number within the block
+   * \param[in]  j      Column number within the block
+   * \param[in]  value  The new value of the element
+   */
+  inline void set_elt(std::size_t i, std::size_t j, ElementType value) {
+    assert(i < num_rows());
+    assert(j < num_cols());
+    mat.set_elt(row0 + i, col0 + j, value);
+  }
+
+  /**
+   * \brief      Assign an expression to the block
+   *
+   * \param      expr  The expression to assign
+   *
+   * \tparam     E     The type of the expression
+   */
+  template <typename E>
+  inline void assign(expression<E> const &expr) {
+    for (std::size_t i = 0; i < num_rows(); ++i) {
+      for (std::size_t j = 0; j < num_cols(); ++j) {
+        set_elt(i, j, expr.get_const_derived()(i, j));
+      }
+    }
+  }
+
+  /**
+   * \brief      Addition assignment operator with an expression
+   *
+   * \param      expr  The expression
+   *
+   * \tparam     E     The type of the expression
+   *
+   * \return     This view
+   */
+  template <typename E>
+  inline block_view &operator+=(expression<E> const &expr);
+
+  /**
+   * \brief      Subtraction assignment operator with an expression
+   *
+   * \param      expr  The expression
+   *
+   * \tparam     E     The type of the expression
+   *
+   * \return     This view
+   */
+  template <typename E>
+  inline block_view &operator-=(expression<E> const &expr);
+
+  /**
+   * \brief      Multiplication assignment operator with a scalar
+   *
+   * \param      expr    The expression
+   *
+   * \tparam     Scalar  The type of the scalar
+   *
+   * \return     This view
+   */
+  template <typename Scalar, typename = enable_if_not_expression<Scalar>>
+  inline block_view &operator*=(Scalar const &expr);
+
+  /**
+   * \brief      Evaluates the block into a new matrix
+   *
+   * \return     A copy of the block
    */
   inline const EvalReturnType eval() const {
     EvalReturnType temp(num_rows(), num_cols());
-    temp.assign((*this));
+    temp.assign(*this);
     return temp;
   }
 
   /**
-   * \brief      Gets number of rows in this expression
+   * \brief      Gets number of rows of the block
    *
    * \return     Number of rows
    */
   inline std::size_t num_rows() const {
-    return expr1.num_rows();
+    if constexpr (Rows != dynamic) {
+      return Rows;
+    } else {
+      return n_rows;
+    }
   }
 
   /**
-   * \brief      Gets the number of columns in this expression
+   * \brief      Gets number of columns of the block
    *
    * \return     Number of columns
    */
   inline std::size_t num_cols() const {
-    return expr1.num_cols();
+    if constexpr (Cols != dynamic) {
+      return Cols;
+    } else {
+      return n_cols;
+    }
   }
 };
 
 /**
- * \brief      Makes a cwise matrix binary operation
- *
- * Helps with template argument inference, so that the types of operands need not be specified while
- * specifying the operator
- *
- * \param      expr1  Expression 1
- * \param      expr2  Expression 2
+ * \brief      Tag type for a triple_product without a fused addend
+ */
+struct no_addend {};
+
+namespace detail {
+
+/**
+ * Longest row buffer of a dynamic size kept on the stack, by multiply_in_place and triple_product.
+ * multiply_in_place is only used below gemm::blocked_threshold multiply-adds, so its rows always fit
+ */
+constexpr std::size_t stack_row_capacity = [] {
+  std::size_t n = 1;
+  while (n * n < gemm::blocked_threshold) {
+    ++n;
+  }
+  return n;
+}();
+
+/**
+ * \brief      Allocator for scratch storage of a result evaluated into a destination
  *
- * \tparam     Op     Type of operation
- * \tparam     E1     Type of expression 1
- * \tparam     E2     Type of expression 2
+ * The allocator of the destination when it has one, so evaluating into an arena_matrix draws its
+ * scratch from the same arena, or the standard allocator otherwise
  *
- * \return     A cwise matrix binary operation
+ * \tparam     T     Type of the scratch elements
  */
-template <template <typename E1, typename E2> typename Op, typename E1, typename E2>
-cwise_matrix_binary_operation<Op<E1, E2>, E1, E2>
-make_cwise_matrix_binary_operation(expression<E1> const &expr1, expression<E2> const &expr2) {
-  return cwise_matrix_binary_operation<Op<E1, E2>, E1, E2>(expr1, expr2);
+template <typename T, typename D>
+inline std::allocator<T> scratch_allocator(D &) {
+  return std::allocator<T>();
+}
+
+template <typename T, typename U, typename Allocator>
+inline auto scratch_allocator(matrix<U, Allocator> &dst) {
+  return typename std::allocator_traits<Allocator>::template rebind_alloc<T>(
+      dst.get_container().get_allocator());
 }
 
+} // namespace detail
+
 /**
- * \brief      Class to represent a matrix product
+ * \brief      Class to represent a fused product of three expressions, optionally plus a fourth
+ *
+ * Built by the operators for a * b * c and a * b * c + d, where the a * b product is never
+ * evaluated on its own. Each row of the result is computed as (row i of a) * b into a single row
+ * buffer, which is then multiplied by c and added to row i of d, so no intermediate matrix is ever
+ * formed. Covariance propagation F * P * transpose(F) + Q is the typical use, where transpose(F) is
+ * a view and needs no copy either.
  *
- * Matrix products are eagerly evaluated and stored in a temporary, as statements like x = x * a can
- * cause incorrect results if lazily evaluated
+ * Like matrix_product, the result is evaluated into a temporary as a whole on first access
  *
  * \tparam     E1    Type of expression 1
  * \tparam     E2    Type of expression 2
+ * \tparam     E3    Type of expression 3
+ * \tparam     E4    Type of the addend, or no_addend
  */
-template <typename E1, typename E2>
-class matrix_product : public expression<matrix_product<E1, E2>> {
+template <typename E1, typename E2, typename E3, typename E4 = no_addend>
+class triple_product : public expression<triple_product<E1, E2, E3, E4>> {
 public:
   /**
-   * Return type of eval() method
+   * Type of an element in this product
    */
-  using EvalReturnType = std::common_type_t<eval_return_type_t<E1>, eval_return_type_t<E2>>;
+  using ElementType = std::common_type_t<element_type_t<matrix_product<E1, E2>>, element_type_t<E3>>;
 
   /**
-   * Type of an element in this matrix product
+   * Compile time dimensions of this product
    */
-  using ElementType = std::common_type_t<element_type_t<E1>, element_type_t<E2>>;
+  static constexpr std::size_t StaticRows = static_rows_v<E1>;
+  static constexpr std::size_t StaticCols = static_cols_v<E3>;
+
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = dense_matrix_type_t<ElementType, StaticRows, StaticCols>;
 
 private:
   /**
-   * Expression 1
+   * Expressions 1, 2 and 3
    */
   E1 const &expr1;
+  E2 const &expr2;
+  E3 const &expr3;
 
   /**
-   * Expression 2
+   * Addend, null if E4 is no_addend
    */
-  E2 const &expr2;
+  E4 const *addend;
 
   /**
-   * Temporary to store the product of the two expressions
+   * Temporary to store the result, sized on evaluation
    */
-  EvalReturnType temp;
+  mutable EvalReturnType temp;
 
-public:
   /**
-   * \brief      Constructor
+   * Whether temp holds the result yet
+   */
+  mutable bool evaluated = false;
+
+  /**
+   * \brief      Computes the result into a dense destination, combined with it as Store says
    *
-   * Evaluates the matrix product of the two given expressions and stores it in a temporary
+   * \param      out   The destination
+   */
+  template <typename Store, typename D>
+  inline void compute(D &out) const {
+    std::size_t const n2 = expr2.num_cols();
+    FASTMATRIX_COUNT(flops,
+                     2 * num_rows() * expr1.num_cols() * n2 + 2 * num_rows() * n2 * num_cols());
+    FASTMATRIX_COUNT(bytes, (num_rows() * expr1.num_cols() + expr2.num_rows() * n2 +
+                             n2 * num_cols() + num_rows() * num_cols()) *
+                                sizeof(ElementType));
+
+    // One row of expr1 * expr2, kept on the stack unless it is long and its length only known at
+    // run time, in which case it comes from the allocator of the destination
+    if constexpr (static_cols_v<E2> != dynamic) {
+      std::array<ElementType, static_cols_v<E2>> row;
+      compute_rows<Store>(out, row);
+    } else if (n2 <= detail::stack_row_capacity) {
+      std::array<ElementType, detail::stack_row_capacity> row;
+      compute_rows<Store>(out, row);
+    } else {
+      auto allocator = detail::scratch_allocator<ElementType>(out);
+      std::vector<ElementType, decltype(allocator)> row(n2, ElementType(), allocator);
+      compute_rows<Store>(out, row);
+    }
+  }
+
+  /**
+   * \brief      The row loop of compute
    *
-   * \param      expr1  Expression 1
-   * \param      expr2  Expression 2
+   * \param      out   The destination
+   * \param      row   Buffer of at least expr2.num_cols() elements
    */
-  inline matrix_product(expression<E1> const &expr1, expression<E2> const &expr2)
-      : expr1(expr1.get_const_derived()), expr2(expr2.get_const_derived()),
-        temp(expr1.num_rows(), expr2.num_cols()) {
+  template <typename Store, typename D, typename Row>
+  inline void compute_rows(D &out, Row &row) const {
+    std::size_t const n2 = expr2.num_cols();
+    std::size_t const n3 = num_cols();
     for (std::size_t i = 0; i < num_rows(); ++i) {
-      for (std::size_t j = 0; j < num_cols(); ++j) {
-        temp.set_elt(i, j, expr1.get_const_derived()(i, 0) * expr2.get_const_derived()(0, j));
-        for (std::size_t k = 1; k < expr1.num_cols(); ++k) {
-          temp.set_elt(
-              i, j, expr1.get_const_derived()(i, k) * expr2.get_const_derived()(k, j) + temp(i, j));
+      for (std::size_t k = 0; k < n2; ++k) {
+        row[k] = row_dot(expr1, i, [&](std::size_t j) { return expr2(j, k); });
+      }
+      for (std::size_t l = 0; l < n3; ++l) {
+        ElementType sum = row[0] * expr3(0, l);
+        for (std::size_t k = 1; k < n2; ++k) {
+          sum = row[k] * expr3(k, l) + sum;
+        }
+        if constexpr (!std::is_same<E4, no_addend>::value) {
+          sum = sum + (*addend)(i, l);
         }
+        Store::apply(out, i, l, sum);
       }
     }
   }
 
   /**
-   * \brief      Function call operator to get an element of the matrix product
+   * \brief      Computes the result into the temporary unless that has already been done
+   */
+  inline void evaluate() const {
+    if (evaluated) {
+      return;
+    }
+    if constexpr (StaticRows == dynamic || StaticCols == dynamic) {
+      temp = EvalReturnType(num_rows(), num_cols());
+    }
+    FASTMATRIX_COUNT(temporaries, 1);
+    compute<detail::store_assign>(temp);
+    evaluated = true;
+  }
+
+public:
+  /**
+   * \brief      Constructor
+   *
+   * \param      expr1   Expression 1
+   * \param      expr2   Expression 2
+   * \param      expr3   Expression 3
+   * \param      addend  Pointer to the addend, null if E4 is no_addend
+   */
+  inline triple_product(E1 const &expr1, E2 const &expr2, E3 const &expr3, E4 const *addend)
+      : expr1(expr1), expr2(expr2), expr3(expr3), addend(addend) {}
+
+  /**
+   * \brief      Get the operands of this product
+   *
+   * \return     Expression 1, 2 or 3 respectively
+   */
+  inline E1 const &first() const {
+    return expr1;
+  }
+  inline E2 const &second() const {
+    return expr2;
+  }
+  inline E3 const &third() const {
+    return expr3;
+  }
+
+  /**
+   * \brief      Get the addend
+   *
+   * \return     Pointer to the addend, null if E4 is no_addend
+   */
+  inline E4 const *get_addend() const {
+    return addend;
+  }
+
+  /**
+   * \brief      Writes the result into a destination it does not alias, see evaluate_into
+   *
+   * \param      dst    The destination
+   *
+   * \tparam     Store  How to combine the result with the destination
+   * \tparam     D      Type of the destination
+   */
+  template <typename Store, typename D>
+  inline void store_into(D &dst) const {
+    assert(dst.num_rows() == num_rows());
+    assert(dst.num_cols() == num_cols());
+    if constexpr (has_direct_access<D>::value) {
+      if (!evaluated) {
+        compute<Store>(dst);
+        return;
+      }
+    }
+    Store::assign(dst, eval());
+  }
+
+  /**
+   * \brief      Get a const pointer to the row-major storage of the evaluated result
+   *
+   * \return     Pointer to the first element
+   */
+  inline ElementType const *data() const {
+    evaluate();
+    return temp.data();
+  }
+
+  /**
+   * \brief      Function call operator to get an element of the result
    *
    * \param[in]  i     Row number of the element to get
    * \param[in]  j     Column number of the element to get
@@ -698,23 +2416,22 @@ public:
    * \return     The desired element
    */
   inline ElementType operator()(std::size_t i, std::size_t j) const {
+    evaluate();
     return temp(i, j);
   }
 
   /**
    * \brief      Evaluate and return the result of this expression
    *
-   * Since the matrix product expression is eagerly evaluated as soon as it is constructed, this
-   * method simply returns a const reference to the temporary in which the result has been stored
-   *
-   * \return     Reference to the product
+   * \return     Reference to the temporary holding the result
    */
   inline EvalReturnType const &eval() const {
+    evaluate();
     return temp;
   }
 
   /**
-   * \brief      Get number of rows of this matrix product
+   * \brief      Get number of rows of this product
    *
    * \return     Number of rows
    */
@@ -723,15 +2440,27 @@ public:
   }
 
   /**
-   * \brief      Get number of columns of this matrix product
+   * \brief      Get number of columns of this product
    *
    * \return     Number of columns
    */
   inline std::size_t num_cols() const {
-    return expr2.num_cols();
+    return expr3.num_cols();
   }
 };
 
+/**
+ * \brief      Template specialization of has_direct_access for triple products, whose result is held
+ * in a matrix temporary
+ *
+ * \tparam     E1    Type of expression 1
+ * \tparam     E2    Type of expression 2
+ * \tparam     E3    Type of expression 3
+ * \tparam     E4    Type of the addend
+ */
+template <typename E1, typename E2, typename E3, typename E4>
+struct has_direct_access<triple_product<E1, E2, E3, E4>> : std::true_type {};
+
 /**
  * \brief      Operator representing element-wise matrix addition between two expressions
  *
@@ -805,12 +2534,159 @@ struct cwise_matrix_subtract {
   }
 };
 
+namespace detail {
+
+/**
+ * \brief      Overwrites the destination with the result
+ */
+struct store_assign {
+  template <typename D, typename V>
+  static inline void apply(D &dst, std::size_t i, std::size_t j, V const &value) {
+    dst.set_elt(i, j, value);
+  }
+
+  template <typename D, typename E>
+  static inline void assign(D &dst, expression<E> const &expr) {
+    dst.assign(expr.get_const_derived());
+  }
+};
+
+/**
+ * \brief      Adds the result to the destination
+ */
+struct store_add {
+  template <typename D, typename V>
+  static inline void apply(D &dst, std::size_t i, std::size_t j, V const &value) {
+    dst.set_elt(i, j, dst(i, j) + value);
+  }
+
+  template <typename D, typename E>
+  static inline void assign(D &dst, expression<E> const &expr) {
+    dst.assign(make_cwise_matrix_binary_operation<cwise_matrix_add>(dst, expr));
+  }
+};
+
+/**
+ * \brief      Subtracts the result from the destination
+ */
+struct store_subtract {
+  template <typename D, typename V>
+  static inline void apply(D &dst, std::size_t i, std::size_t j, V const &value) {
+    dst.set_elt(i, j, dst(i, j) - value);
+  }
+
+  template <typename D, typename E>
+  static inline void assign(D &dst, expression<E> const &expr) {
+    dst.assign(make_cwise_matrix_binary_operation<cwise_matrix_subtract>(dst, expr));
+  }
+};
+
+/**
+ * \brief      Multiplies a matrix by a square expression that does not read it, in place
+ *
+ * Row i of the product only needs row i of the matrix, so each row is copied into the buffer and
+ * overwritten by its product with the expression, accumulated in the same i-k-j order as the small
+ * GEMM kernel and with the same rounding as row_dot
+ *
+ * \param      dst   The matrix
+ * \param      rhs   The expression, dst.num_cols() x dst.num_cols()
+ * \param      row   Buffer of dst.num_cols() elements
+ */
+template <typename D, typename E, typename Row>
+inline void multiply_in_place(D &dst, E const &rhs, Row &row) {
+  std::size_t const n = dst.num_cols();
+  FASTMATRIX_COUNT(flops, 2 * dst.num_rows() * n * n);
+  FASTMATRIX_COUNT(bytes, (2 * dst.num_rows() * n + n * n) * sizeof(element_type_t<D>));
+  for (std::size_t i = 0; i < dst.num_rows(); ++i) {
+    for (std::size_t k = 0; k < n; ++k) {
+      row[k] = dst(i, k);
+    }
+    for (std::size_t j = 0; j < n; ++j) {
+      dst.set_elt(i, j, row[0] * rhs(0, j));
+    }
+    for (std::size_t k = 1; k < n; ++k) {
+      for (std::size_t j = 0; j < n; ++j) {
+        dst.set_elt(i, j, row[k] * rhs(k, j) + dst(i, j));
+      }
+    }
+  }
+}
+
+} // namespace detail
+
+template <typename Store, typename D, typename E>
+inline void evaluate_into(D &dst, expression<E> const &expr) {
+  if constexpr (evaluates_into<E>::value) {
+    expr.get_const_derived().template store_into<Store>(dst);
+  } else {
+    Store::assign(dst, expr);
+  }
+}
+
+// Overloads of aliases for the expressions of this file. Matrices compare their storage with the
+// range, expressions ask their operands
+
+template <typename T>
+inline bool aliases(scalar_expression<T> const &, void const *, void const *) {
+  return false;
+}
+
+template <typename T, typename Allocator>
+inline bool aliases(matrix<T, Allocator> const &m, void const *first, void const *last) {
+  return detail::overlaps(m.data(), m.data() + m.num_rows() * m.num_cols(), first, last);
+}
+
+template <typename T, std::size_t R, std::size_t C>
+inline bool aliases(fixed_matrix<T, R, C> const &m, void const *first, void const *last) {
+  return detail::overlaps(m.data(), m.data() + R * C, first, last);
+}
+
+template <typename Op, typename E1, typename E2>
+inline bool aliases(cwise_matrix_binary_operation<Op, E1, E2> const &expr, void const *first,
+                    void const *last) {
+  return aliases(expr.lhs(), first, last) || aliases(expr.rhs(), first, last);
+}
+
+template <typename E1, typename E2>
+inline bool aliases(matrix_product<E1, E2> const &expr, void const *first, void const *last) {
+  return aliases(expr.lhs(), first, last) || aliases(expr.rhs(), first, last);
+}
+
+template <typename E>
+inline bool aliases(transpose_expression<E> const &expr, void const *first, void const *last) {
+  return aliases(expr.nested(), first, last);
+}
+
+template <typename M, std::size_t Rows, std::size_t Cols>
+inline bool aliases(block_view<M, Rows, Cols> const &expr, void const *first, void const *last) {
+  return aliases(expr.viewed(), first, last);
+}
+
+template <typename E1, typename E2, typename E3, typename E4>
+inline bool aliases(triple_product<E1, E2, E3, E4> const &expr, void const *first,
+                    void const *last) {
+  bool result = aliases(expr.first(), first, last) || aliases(expr.second(), first, last) ||
+                aliases(expr.third(), first, last);
+  if constexpr (!std::is_same<E4, no_addend>::value) {
+    result = result || aliases(*expr.get_addend(), first, last);
+  }
+  return result;
+}
+
+template <typename E1, typename E2>
+struct evaluates_into<matrix_product<E1, E2>> : std::true_type {};
+
+template <typename E1, typename E2, typename E3, typename E4>
+struct evaluates_into<triple_product<E1, E2, E3, E4>> : std::true_type {};
+
 // The below functions and methods are simply arithmetic operator overloads to easily construct
 // expression classes. e.g. a + b constructs a cwise_matrix_binary_operation with cwise_matrix_add
 // as the operation
 
 template <typename E1, typename E2>
 inline auto operator+(expression<E1> const &expr1, expression<E2> const &expr2) {
+  static_assert(dimensions_match(static_rows_v<E1>, static_rows_v<E2>), "Row counts differ");
+  static_assert(dimensions_match(static_cols_v<E1>, static_cols_v<E2>), "Column counts differ");
   assert(expr1.num_rows() == expr2.num_rows());
   assert(expr1.num_cols() == expr2.num_cols());
   return make_cwise_matrix_binary_operation<cwise_matrix_add>(expr1, expr2);
@@ -828,10 +2704,31 @@ inline auto operator+(T const &scalar, expression<E> const &expr) {
 
 template <typename E1, typename E2>
 inline auto operator*(expression<E1> const &expr1, expression<E2> const &expr2) {
+  static_assert(dimensions_match(static_cols_v<E1>, static_rows_v<E2>),
+                "Inner dimensions of matrix product differ");
   assert(expr1.num_cols() == expr2.num_rows());
   return matrix_product(expr1, expr2);
 }
 
+template <typename E1, typename E2, typename E3>
+inline auto operator*(matrix_product<E1, E2> const &product, expression<E3> const &expr3) {
+  static_assert(dimensions_match(static_cols_v<E2>, static_rows_v<E3>),
+                "Inner dimensions of matrix product differ");
+  assert(product.num_cols() == expr3.num_rows());
+  return triple_product<E1, E2, E3>(product.lhs(), product.rhs(), expr3.get_const_derived(),
+                                    nullptr);
+}
+
+template <typename E1, typename E2, typename E3, typename E4>
+inline auto operator+(triple_product<E1, E2, E3> const &product, expression<E4> const &expr4) {
+  static_assert(dimensions_match(static_rows_v<E1>, static_rows_v<E4>), "Row counts differ");
+  static_assert(dimensions_match(static_cols_v<E3>, static_cols_v<E4>), "Column counts differ");
+  assert(product.num_rows() == expr4.num_rows());
+  assert(product.num_cols() == expr4.num_cols());
+  return triple_product<E1, E2, E3, E4>(product.first(), product.second(), product.third(),
+                                        &expr4.get_const_derived());
+}
+
 template <typename E, typename T, typename = enable_if_not_expression<T>>
 inline auto operator*(expression<E> const &expr, T const &scalar) {
   return make_cwise_matrix_binary_operation<cwise_matrix_multiply>(expr, scalar_expression(scalar));
@@ -844,6 +2741,8 @@ inline auto operator*(T const &scalar, expression<E> const &expr) {
 
 template <typename E1, typename E2>
 inline auto operator-(expression<E1> const &expr1, expression<E2> const &expr2) {
+  static_assert(dimensions_match(static_rows_v<E1>, static_rows_v<E2>), "Row counts differ");
+  static_assert(dimensions_match(static_cols_v<E1>, static_cols_v<E2>), "Column counts differ");
   assert(expr1.num_rows() == expr2.num_rows());
   assert(expr1.num_cols() == expr2.num_cols());
   return make_cwise_matrix_binary_operation<cwise_matrix_subtract>(expr1, expr2);
@@ -859,54 +2758,158 @@ inline auto operator-(T const &scalar, expression<E> const &expr) {
   return expr - scalar;
 }
 
-template <typename T>
+template <typename T, typename Allocator>
 template <typename E>
-inline matrix<T> &matrix<T>::operator+=(expression<E> const &expr) {
+inline matrix<T, Allocator> &matrix<T, Allocator>::operator+=(expression<E> const &expr) {
   assert(n_rows == expr.num_rows());
   assert(n_cols == expr.num_cols());
-  assign(make_cwise_matrix_binary_operation<cwise_matrix_add>(*this, expr));
+  detail::evaluate_checked<detail::store_add>(*this, storage_begin(), storage_end(), expr);
   return *this;
 }
 
-template <typename T>
+template <typename T, typename Allocator>
 template <typename Scalar, typename>
-inline matrix<T> &matrix<T>::operator+=(Scalar const &scalar) {
+inline matrix<T, Allocator> &matrix<T, Allocator>::operator+=(Scalar const &scalar) {
   assign(make_cwise_matrix_binary_operation<cwise_matrix_add>(*this, scalar_expression(scalar)));
   return *this;
 }
 
-template <typename T>
+template <typename T, typename Allocator>
 template <typename E>
-inline matrix<T> &matrix<T>::operator*=(expression<E> const &expr) {
-  assert(n_rows == expr.num_cols());
-  assign(matrix_product(*this, expr));
+inline matrix<T, Allocator> &matrix<T, Allocator>::operator*=(expression<E> const &expr) {
+  assert(n_cols == expr.num_rows());
+  assert(n_cols == expr.num_cols());
+  // Large products are left to the blocked GEMM kernels, which need a separate destination
+  if (n_rows * n_cols * n_cols >= gemm::blocked_threshold ||
+      aliases(expr.get_const_derived(), storage_begin(), storage_end())) {
+    assign(matrix_product(*this, expr));
+    return *this;
+  }
+  std::array<T, detail::stack_row_capacity> row;
+  detail::multiply_in_place(*this, expr.get_const_derived(), row);
   return *this;
 }
 
-template <typename T>
+template <typename T, typename Allocator>
 template <typename Scalar, typename>
-inline matrix<T> &matrix<T>::operator*=(Scalar const &scalar) {
+inline matrix<T, Allocator> &matrix<T, Allocator>::operator*=(Scalar const &scalar) {
   assign(
       make_cwise_matrix_binary_operation<cwise_matrix_multiply>(*this, scalar_expression(scalar)));
   return *this;
 }
 
-template <typename T>
+template <typename T, typename Allocator>
 template <typename E>
-inline matrix<T> &matrix<T>::operator-=(expression<E> const &expr) {
+inline matrix<T, Allocator> &matrix<T, Allocator>::operator-=(expression<E> const &expr) {
   assert(n_rows == expr.num_rows());
   assert(n_cols == expr.num_cols());
-  assign(make_cwise_matrix_binary_operation<cwise_matrix_subtract>(*this, expr));
+  detail::evaluate_checked<detail::store_subtract>(*this, storage_begin(), storage_end(), expr);
   return *this;
 }
 
-template <typename T>
+template <typename T, typename Allocator>
+template <typename Scalar, typename>
+inline matrix<T, Allocator> &matrix<T, Allocator>::operator-=(Scalar const &scalar) {
+  assign(
+      make_cwise_matrix_binary_operation<cwise_matrix_subtract>(*this, scalar_expression(scalar)));
+  return *this;
+}
+
+template <typename T, std::size_t Rows, std::size_t Cols>
+template <typename E>
+inline fixed_matrix<T, Rows, Cols> &
+fixed_matrix<T, Rows, Cols>::operator+=(expression<E> const &expr) {
+  static_assert(dimensions_match(static_rows_v<E>, Rows), "Row counts differ");
+  static_assert(dimensions_match(static_cols_v<E>, Cols), "Column counts differ");
+  assert(Rows == expr.num_rows());
+  assert(Cols == expr.num_cols());
+  detail::evaluate_checked<detail::store_add>(*this, storage_begin(), storage_end(), expr);
+  return *this;
+}
+
+template <typename T, std::size_t Rows, std::size_t Cols>
+template <typename Scalar, typename>
+inline fixed_matrix<T, Rows, Cols> &fixed_matrix<T, Rows, Cols>::operator+=(Scalar const &scalar) {
+  assign(make_cwise_matrix_binary_operation<cwise_matrix_add>(*this, scalar_expression(scalar)));
+  return *this;
+}
+
+template <typename T, std::size_t Rows, std::size_t Cols>
+template <typename E>
+inline fixed_matrix<T, Rows, Cols> &
+fixed_matrix<T, Rows, Cols>::operator*=(expression<E> const &expr) {
+  static_assert(dimensions_match(static_rows_v<E>, Cols) && dimensions_match(static_cols_v<E>, Cols),
+                "Multiplication assignment requires a square right hand side");
+  assert(Cols == expr.num_rows());
+  assert(Cols == expr.num_cols());
+  if (aliases(expr.get_const_derived(), data(), data() + Rows * Cols)) {
+    assign(matrix_product(*this, expr));
+    return *this;
+  }
+  std::array<T, Cols> row;
+  detail::multiply_in_place(*this, expr.get_const_derived(), row);
+  return *this;
+}
+
+template <typename T, std::size_t Rows, std::size_t Cols>
+template <typename Scalar, typename>
+inline fixed_matrix<T, Rows, Cols> &fixed_matrix<T, Rows, Cols>::operator*=(Scalar const &scalar) {
+  assign(
+      make_cwise_matrix_binary_operation<cwise_matrix_multiply>(*this, scalar_expression(scalar)));
+  return *this;
+}
+
+template <typename T, std::size_t Rows, std::size_t Cols>
+template <typename E>
+inline fixed_matrix<T, Rows, Cols> &
+fixed_matrix<T, Rows, Cols>::operator-=(expression<E> const &expr) {
+  static_assert(dimensions_match(static_rows_v<E>, Rows), "Row counts differ");
+  static_assert(dimensions_match(static_cols_v<E>, Cols), "Column counts differ");
+  assert(Rows == expr.num_rows());
+  assert(Cols == expr.num_cols());
+  detail::evaluate_checked<detail::store_subtract>(*this, storage_begin(), storage_end(), expr);
+  return *this;
+}
+
+template <typename T, std::size_t Rows, std::size_t Cols>
 template <typename Scalar, typename>
-inline matrix<T> &matrix<T>::operator-=(Scalar const &scalar) {
+inline fixed_matrix<T, Rows, Cols> &fixed_matrix<T, Rows, Cols>::operator-=(Scalar const &scalar) {
   assign(
       make_cwise_matrix_binary_operation<cwise_matrix_subtract>(*this, scalar_expression(scalar)));
   return *this;
 }
+
+template <typename M, std::size_t Rows, std::size_t Cols>
+template <typename E>
+inline block_view<M, Rows, Cols> &block_view<M, Rows, Cols>::operator+=(expression<E> const &expr) {
+  static_assert(dimensions_match(static_rows_v<E>, Rows), "Row counts differ");
+  static_assert(dimensions_match(static_cols_v<E>, Cols), "Column counts differ");
+  assert(num_rows() == expr.num_rows());
+  assert(num_cols() == expr.num_cols());
+  detail::evaluate_checked<detail::store_add>(*this, mat.storage_begin(), mat.storage_end(),
+                                              expr);
+  return *this;
+}
+
+template <typename M, std::size_t Rows, std::size_t Cols>
+template <typename E>
+inline block_view<M, Rows, Cols> &block_view<M, Rows, Cols>::operator-=(expression<E> const &expr) {
+  static_assert(dimensions_match(static_rows_v<E>, Rows), "Row counts differ");
+  static_assert(dimensions_match(static_cols_v<E>, Cols), "Column counts differ");
+  assert(num_rows() == expr.num_rows());
+  assert(num_cols() == expr.num_cols());
+  detail::evaluate_checked<detail::store_subtract>(*this, mat.storage_begin(), mat.storage_end(),
+                                                   expr);
+  return *this;
+}
+
+template <typename M, std::size_t Rows, std::size_t Cols>
+template <typename Scalar, typename>
+inline block_view<M, Rows, Cols> &block_view<M, Rows, Cols>::operator*=(Scalar const &scalar) {
+  assign(
+      make_cwise_matrix_binary_operation<cwise_matrix_multiply>(*this, scalar_expression(scalar)));
+  return *this;
+}
 } // namespace fastmatrix
 
 #endif // FASTMATRIX_FASTMATRIX_HPP
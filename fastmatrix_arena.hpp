@@ -0,0 +1,369 @@
+#ifndef FASTMATRIX_ARENA_HPP
+#define FASTMATRIX_ARENA_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+/**
+ * Bump allocation of matrix storage from a fixed block of memory, as an alternative to the heap
+ * for dynamically sized matrices.
+ *
+ * An arena hands out its block front to back and frees it all at once; an arena_scope installs it
+ * as the calling thread's current arena and rewinds it on exit, so everything a filter tick
+ * allocates is released together at the end of the tick:
+ *
+ *   static fastmatrix::static_arena<4096> scratch; // no heap at all, for MCUs
+ *   void tick() {
+ *     fastmatrix::arena_scope scope(scratch);
+ *     fastmatrix::arena_matrix<float> m(6, 6);    // storage comes from scratch
+ *     ...
+ *   }                                             // scratch is back where the tick found it
+ *
+ * matrix<T, arena_allocator<T>> (arena_matrix<T>) draws from the current arena whenever one is
+ * installed and from the heap otherwise. Building with -DFASTMATRIX_DEFAULT_ARENA makes that the
+ * allocator of matrix<T> itself, so existing code, and the temporaries its products evaluate into,
+ * moves to the arena under a scope without any change to its bodies.
+ *
+ * A matrix must not outlive the scope its storage was allocated in. An allocation that does not
+ * fit is counted in overflows() and taken from the heap instead; size the block with high_water(),
+ * and build with -DFASTMATRIX_ARENA_NO_HEAP where there is no heap to fall back to, which turns an
+ * overflow, or an arena_allocator used with no arena installed, into an assertion and std::abort().
+ */
+namespace fastmatrix {
+
+/**
+ * The current arena is per thread on hosts; avr-gcc has no thread local storage, and there is only
+ * one thread anyway
+ */
+#if defined(__AVR__)
+#define FASTMATRIX_ARENA_THREAD_LOCAL
+#else
+#define FASTMATRIX_ARENA_THREAD_LOCAL thread_local
+#endif
+
+/**
+ * \brief      Bump allocator over a block of memory, either one given to it or one it allocates
+ */
+class arena {
+public:
+  /**
+   * Position in the block, from mark() and for rewind()
+   */
+  using marker = std::size_t;
+
+  /**
+   * \brief      Constructor over a block owned by the caller, which must outlive the arena
+   *
+   * \param      buffer  The block
+   * \param[in]  bytes   Its size
+   */
+  inline arena(void *buffer, std::size_t bytes)
+      : begin(static_cast<unsigned char *>(buffer)), end(begin + bytes), top(begin), peak(0),
+        overflow_count(0), owned(false) {}
+
+#if defined(FASTMATRIX_ARENA_NO_HEAP)
+  /**
+   * Without a heap the block must be given, by the constructor above or a static_arena
+   */
+  explicit arena(std::size_t bytes) = delete;
+
+  inline ~arena() {}
+#else
+  /**
+   * \brief      Constructor allocating the block from the heap, once
+   *
+   * \param[in]  bytes  Size of the block
+   */
+  inline explicit arena(std::size_t bytes)
+      : begin(static_cast<unsigned char *>(::operator new(bytes))), end(begin + bytes), top(begin),
+        peak(0), overflow_count(0), owned(true) {}
+
+  inline ~arena() {
+    if (owned) {
+      ::operator delete(begin);
+    }
+  }
+#endif
+
+  arena(arena const &) = delete;
+  arena &operator=(arena const &) = delete;
+
+  /**
+   * \brief      Allocates from the top of the block, or from the heap if it does not fit
+   *
+   * \param[in]  bytes      The size
+   * \param[in]  alignment  The alignment, a power of two
+   *
+   * \return     Pointer to the storage
+   */
+  inline void *allocate(std::size_t bytes, std::size_t alignment) {
+    std::uintptr_t const aligned = (reinterpret_cast<std::uintptr_t>(top) + alignment - 1) &
+                                   ~std::uintptr_t(alignment - 1);
+    unsigned char *const p = reinterpret_cast<unsigned char *>(aligned);
+    if (p <= end && std::size_t(end - p) >= bytes) {
+      top = p + bytes;
+      if (used() > peak) {
+        peak = used();
+      }
+      return p;
+    }
+    ++overflow_count;
+    return heap_allocate(bytes, alignment);
+  }
+
+  /**
+   * \brief      Frees storage from allocate(). Only the most recent allocation goes back to the
+   * block, the rest waits for a rewind
+   *
+   * \param      p      The storage
+   * \param[in]  bytes  Its size
+   */
+  inline void deallocate(void *p, std::size_t bytes, std::size_t alignment) {
+    unsigned char *const q = static_cast<unsigned char *>(p);
+    if (!owns(q)) {
+      heap_deallocate(p, alignment);
+    } else if (q + bytes == top) {
+      top = q;
+    }
+  }
+
+  /**
+   * \brief      Allocates from the heap with the given alignment, for storage that does not come
+   * from an arena. Asserts and aborts instead when built with FASTMATRIX_ARENA_NO_HEAP
+   *
+   * \param[in]  bytes      The size
+   * \param[in]  alignment  The alignment, a power of two
+   *
+   * \return     Pointer to the storage
+   */
+  static inline void *heap_allocate(std::size_t bytes, std::size_t alignment) {
+#if defined(FASTMATRIX_ARENA_NO_HEAP)
+    (void)bytes;
+    (void)alignment;
+    assert(!"arena exhausted or not installed");
+    std::abort();
+#else
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      return ::operator new(bytes, std::align_val_t(alignment));
+    }
+    return ::operator new(bytes);
+#endif
+  }
+
+  /**
+   * \brief      Frees storage from heap_allocate
+   */
+  static inline void heap_deallocate(void *p, std::size_t alignment) {
+#if defined(FASTMATRIX_ARENA_NO_HEAP)
+    (void)p;
+    (void)alignment;
+#else
+    if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+      ::operator delete(p, std::align_val_t(alignment));
+    } else {
+      ::operator delete(p);
+    }
+#endif
+  }
+
+  /**
+   * \brief      Whether the storage was allocated from the block
+   */
+  inline bool owns(void const *p) const {
+    unsigned char const *const q = static_cast<unsigned char const *>(p);
+    return q >= begin && q < end;
+  }
+
+  inline marker mark() const {
+    return marker(top - begin);
+  }
+
+  /**
+   * \brief      Frees everything allocated since the mark was taken
+   *
+   * \param[in]  m     The mark
+   */
+  inline void rewind(marker m) {
+    top = begin + m;
+  }
+
+  inline void reset() {
+    top = begin;
+  }
+
+  inline std::size_t used() const {
+    return std::size_t(top - begin);
+  }
+
+  inline std::size_t capacity() const {
+    return std::size_t(end - begin);
+  }
+
+  /**
+   * \brief      Most bytes in use at once, padding included
+   */
+  inline std::size_t high_water() const {
+    return peak;
+  }
+
+  /**
+   * \brief      Allocations that did not fit and came from the heap
+   */
+  inline std::size_t overflows() const {
+    return overflow_count;
+  }
+
+  /**
+   * \brief      The arena installed on the calling thread by the innermost arena_scope, or null
+   */
+  static inline arena *current() {
+    return current_slot();
+  }
+
+private:
+  friend class arena_scope;
+
+  static inline arena *&current_slot() {
+    static FASTMATRIX_ARENA_THREAD_LOCAL arena *installed = nullptr;
+    return installed;
+  }
+
+  unsigned char *begin;
+  unsigned char *end;
+  unsigned char *top;
+  std::size_t peak;
+  std::size_t overflow_count;
+  bool owned;
+};
+
+/**
+ * \brief      Arena whose block is a member, so it can live in static storage with no heap at all
+ *
+ * \tparam     Bytes  Size of the block
+ */
+template <std::size_t Bytes>
+class static_arena : public arena {
+public:
+  inline static_arena() : arena(storage, Bytes) {}
+
+private:
+  alignas(std::max_align_t) unsigned char storage[Bytes];
+};
+
+/**
+ * \brief      Installs an arena as the calling thread's current one for its lifetime, then frees
+ * what was allocated from it meanwhile and reinstalls the previous one. Scopes nest
+ */
+class arena_scope {
+public:
+  inline explicit arena_scope(arena &a)
+      : installed(a), previous(arena::current_slot()), start(a.mark()) {
+    arena::current_slot() = &a;
+  }
+
+  inline ~arena_scope() {
+    installed.rewind(start);
+    arena::current_slot() = previous;
+  }
+
+  arena_scope(arena_scope const &) = delete;
+  arena_scope &operator=(arena_scope const &) = delete;
+
+private:
+  arena &installed;
+  arena *previous;
+  arena::marker start;
+};
+
+/**
+ * \brief      Standard allocator drawing from an arena: the given one, or the current one at the
+ * time the allocator is default constructed, or the heap if there is none (see heap_allocate)
+ *
+ * \tparam     T     Type of the elements
+ */
+template <typename T>
+class arena_allocator {
+public:
+  using value_type = T;
+  // A matrix keeps the allocator it was constructed with: moving one drawn from a scope's arena into
+  // a longer-lived matrix copies the elements into the latter's own storage instead of handing it
+  // memory that the scope rewinds. Swapping does exchange allocators along with storage
+  using propagate_on_container_move_assignment = std::false_type;
+  using propagate_on_container_swap = std::true_type;
+
+  inline arena_allocator() noexcept : source(arena::current()) {}
+
+  inline explicit arena_allocator(arena &a) noexcept : source(&a) {}
+
+  template <typename U>
+  inline arena_allocator(arena_allocator<U> const &other) noexcept : source(other.get_arena()) {}
+
+  inline T *allocate(std::size_t n) {
+    if (!source) {
+      return static_cast<T *>(arena::heap_allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T *>(source->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  inline void deallocate(T *p, std::size_t n) {
+    if (!source) {
+      arena::heap_deallocate(p, alignof(T));
+    } else {
+      source->deallocate(p, n * sizeof(T), alignof(T));
+    }
+  }
+
+  /**
+   * \brief      The arena allocated from, null for the heap
+   */
+  inline arena *get_arena() const {
+    return source;
+  }
+
+  template <typename U>
+  inline bool operator==(arena_allocator<U> const &other) const {
+    return source == other.get_arena();
+  }
+
+  template <typename U>
+  inline bool operator!=(arena_allocator<U> const &other) const {
+    return source != other.get_arena();
+  }
+
+private:
+  arena *source;
+};
+
+/**
+ * \brief      Whether storage from an allocator comes from the heap, for the instrumentation's
+ * allocation counts
+ */
+template <typename A>
+inline bool allocates_from_heap(A const &) {
+  return true;
+}
+
+template <typename T>
+inline bool allocates_from_heap(arena_allocator<T> const &a) {
+  return a.get_arena() == nullptr;
+}
+
+/**
+ * Allocator of matrix<T> unless another one is given
+ */
+#if defined(FASTMATRIX_DEFAULT_ARENA)
+template <typename T>
+using default_allocator = arena_allocator<T>;
+#else
+template <typename T>
+using default_allocator = std::allocator<T>;
+#endif
+
+} // namespace fastmatrix
+
+#endif // FASTMATRIX_ARENA_HPP
@@ -0,0 +1,264 @@
+#ifndef FASTMATRIX_BLOCK_HPP
+#define FASTMATRIX_BLOCK_HPP
+
+#include "fastmatrix.hpp"
+
+namespace fastmatrix {
+
+/**
+ * \brief      Compile time structure of a block of a block_matrix
+ */
+enum class block_kind {
+  /**
+   * All elements are zero and cannot be set
+   */
+  zero,
+
+  /**
+   * Square block with ones on its diagonal and zeros elsewhere, which cannot be set
+   */
+  identity,
+
+  /**
+   * Arbitrary elements
+   */
+  dense
+};
+
+/**
+ * \brief      Class for a fixed size matrix of 2 x 2 blocks whose sparsity structure is known at
+ * compile time
+ *
+ * The matrix is split after row SplitRow and column SplitCol, and each of the four blocks is
+ * declared zero, identity or dense. A split equal to the matrix size leaves the blocks past it
+ * empty, their kind is then irrelevant. Products with a block_matrix on the left, including the
+ * congruence transforms of fastmatrix_symmetric.hpp, only multiply-add over the dense blocks and
+ * copy through the identity ones, which is the shape of the Jacobians of a Kalman filter: the bias
+ * rows of F are identity, the bias columns of H are zero.
+ *
+ * Elements are stored densely, so reading any element is as cheap as with fixed_matrix. Only
+ * elements of dense blocks can be set
+ *
+ * \tparam     T            The type of an element stored in the matrix
+ * \tparam     Rows         The number of rows of the matrix
+ * \tparam     Cols         The number of columns of the matrix
+ * \tparam     SplitRow     Number of rows of the top blocks
+ * \tparam     SplitCol     Number of columns of the left blocks
+ * \tparam     TopLeft      Kind of the top left block
+ * \tparam     TopRight     Kind of the top right block
+ * \tparam     BottomLeft   Kind of the bottom left block
+ * \tparam     BottomRight  Kind of the bottom right block
+ */
+template <typename T, std::size_t Rows, std::size_t Cols, std::size_t SplitRow, std::size_t SplitCol,
+          block_kind TopLeft, block_kind TopRight, block_kind BottomLeft, block_kind BottomRight>
+class block_matrix : public expression<block_matrix<T, Rows, Cols, SplitRow, SplitCol, TopLeft,
+                                                    TopRight, BottomLeft, BottomRight>> {
+  static_assert(SplitRow <= Rows && SplitCol <= Cols, "Split past the end of the matrix");
+  static_assert(TopLeft != block_kind::identity || SplitRow == SplitCol,
+                "Identity block must be square");
+  static_assert(TopRight != block_kind::identity || SplitRow == Cols - SplitCol,
+                "Identity block must be square");
+  static_assert(BottomLeft != block_kind::identity || Rows - SplitRow == SplitCol,
+                "Identity block must be square");
+  static_assert(BottomRight != block_kind::identity || Rows - SplitRow == Cols - SplitCol,
+                "Identity block must be square");
+
+public:
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = fixed_matrix<T, Rows, Cols>;
+
+  /**
+   * Type of elements of this matrix
+   */
+  using ElementType = T;
+
+  /**
+   * Compile time dimensions of this matrix
+   */
+  static constexpr std::size_t StaticRows = Rows;
+  static constexpr std::size_t StaticCols = Cols;
+
+private:
+  /**
+   * All elements, including the constant ones of zero and identity blocks
+   */
+  fixed_matrix<T, Rows, Cols> elements;
+
+  /**
+   * \brief      Adds the terms of one block to a row dot product
+   *
+   * \param      sum   The running sum
+   * \param[in]  i     Row number in the matrix
+   * \param[in]  r     Row number within the block
+   * \param[in]  c0    First column of the block
+   * \param[in]  c1    One past the last column of the block
+   * \param      v     Function returning element j of the vector
+   *
+   * \tparam     Kind  Kind of the block
+   */
+  template <block_kind Kind, typename S, typename V>
+  inline void accumulate(S &sum, std::size_t i, std::size_t r, std::size_t c0, std::size_t c1,
+                         V const &v) const {
+    if constexpr (Kind == block_kind::dense) {
+      for (std::size_t j = c0; j < c1; ++j) {
+        sum = elements(i, j) * v(j) + sum;
+      }
+    } else if constexpr (Kind == block_kind::identity) {
+      sum = v(c0 + r) + sum;
+    }
+  }
+
+  /**
+   * \brief      Dot product of a row in a given row of blocks with a vector
+   *
+   * \tparam     Left   Kind of the left block in that row of blocks
+   * \tparam     Right  Kind of the right block in that row of blocks
+   */
+  template <block_kind Left, block_kind Right, typename V>
+  inline auto block_row_dot(std::size_t i, std::size_t r, V const &v) const {
+    decltype(T() * v(0)) sum(0);
+    accumulate<Left>(sum, i, r, 0, SplitCol, v);
+    accumulate<Right>(sum, i, r, SplitCol, Cols, v);
+    return sum;
+  }
+
+public:
+  /**
+   * \brief      Default constructor, dense blocks are zero
+   */
+  inline block_matrix() {
+    for (std::size_t i = 0; i < Rows; ++i) {
+      for (std::size_t j = 0; j < Cols; ++j) {
+        if (kind(i, j) == block_kind::identity) {
+          elements.set_elt(i, j, (i < SplitRow ? i : i - SplitRow) ==
+                                         (j < SplitCol ? j : j - SplitCol)
+                                     ? T(1)
+                                     : T(0));
+        }
+      }
+    }
+  }
+
+  /**
+   * \brief      Constructor
+   *
+   * Exists so that generic code which sizes its matrices at runtime also works with block
+   * matrices. The given dimensions must match the compile time ones
+   *
+   * \param[in]  n_rows  The number of rows, must equal Rows
+   * \param[in]  n_cols  The number of columns, must equal Cols
+   */
+  inline block_matrix(std::size_t n_rows, std::size_t n_cols) : block_matrix() {
+    assert(n_rows == Rows);
+    assert(n_cols == Cols);
+  }
+
+  /**
+   * \brief      Gets the kind of the block an element belongs to
+   *
+   * \param[in]  i     Row number of the element
+   * \param[in]  j     Column number of the element
+   *
+   * \return     The kind of its block
+   */
+  static constexpr block_kind kind(std::size_t i, std::size_t j) {
+    return i < SplitRow ? (j < SplitCol ? TopLeft : TopRight)
+                        : (j < SplitCol ? BottomLeft : BottomRight);
+  }
+
+  /**
+   * \brief      Function operator to return elements of this matrix
+   *
+   * \param[in]  i     Row number of the element to return
+   * \param[in]  j     Column number of the element to return
+   *
+   * \return     The desired element
+   */
+  inline T operator()(std::size_t i, std::size_t j) const {
+    return elements(i, j);
+  }
+
+  /**
+   * \brief      Gets number of rows in this matrix
+   *
+   * \return     Number of rows
+   */
+  static constexpr std::size_t num_rows() {
+    return Rows;
+  }
+
+  /**
+   * \brief      Gets number of columns in this matrix
+   *
+   * \return     Number of columns
+   */
+  static constexpr std::size_t num_cols() {
+    return Cols;
+  }
+
+  /**
+   * \brief      Evaluate this expression
+   *
+   * \return     Const reference to the dense elements
+   */
+  inline EvalReturnType const &eval() const {
+    return elements;
+  }
+
+  /**
+   * \brief      Set an element of a dense block
+   *
+   * \param[in]  i      Row number of the element to set
+   * \param[in]  j      Column number of this element to set
+   * \param[in]  value  The new value of the element
+   */
+  inline void set_elt(std::size_t i, std::size_t j, T value) {
+    assert(kind(i, j) == block_kind::dense);
+    elements.set_elt(i, j, value);
+  }
+
+  /**
+   * \brief      Dot product of row i with a vector, see row_dot
+   *
+   * Only the dense blocks are multiplied, an identity block adds its single term directly and a
+   * zero block adds nothing
+   *
+   * \param[in]  i     Row number
+   * \param      v     Function returning element j of the vector
+   *
+   * \tparam     V     Type of the function
+   *
+   * \return     The sum over j of (*this)(i, j) * v(j)
+   */
+  template <typename V>
+  inline auto dot_row(std::size_t i, V const &v) const {
+    if (i < SplitRow) {
+      return block_row_dot<TopLeft, TopRight>(i, i, v);
+    }
+    return block_row_dot<BottomLeft, BottomRight>(i, i - SplitRow, v);
+  }
+
+  /**
+   * \brief      Overload of row_dot that skips the structural zeros of the matrix
+   */
+  template <typename V>
+  friend inline auto row_dot(block_matrix const &m, std::size_t i, V const &v) {
+    return m.dot_row(i, v);
+  }
+};
+
+/**
+ * \brief      Overload of aliases for block matrices, whose elements are stored inline
+ */
+template <typename T, std::size_t Rows, std::size_t Cols, std::size_t SplitRow, std::size_t SplitCol,
+          block_kind TopLeft, block_kind TopRight, block_kind BottomLeft, block_kind BottomRight>
+inline bool aliases(block_matrix<T, Rows, Cols, SplitRow, SplitCol, TopLeft, TopRight, BottomLeft,
+                                 BottomRight> const &m,
+                    void const *first, void const *last) {
+  return detail::overlaps(&m, &m + 1, first, last);
+}
+} // namespace fastmatrix
+
+#endif // FASTMATRIX_BLOCK_HPP
@@ -0,0 +1,321 @@
+#ifndef FASTMATRIX_FIXED_POINT_HPP
+#define FASTMATRIX_FIXED_POINT_HPP
+
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+
+namespace fastmatrix {
+
+namespace detail {
+/**
+ * \brief      Trait returning the signed integer type twice as wide as T, which holds the exact
+ * result of a product of two T
+ */
+template <typename T>
+struct wider_integer;
+
+template <>
+struct wider_integer<std::int8_t> {
+  using type = std::int16_t;
+};
+
+template <>
+struct wider_integer<std::int16_t> {
+  using type = std::int32_t;
+};
+
+template <>
+struct wider_integer<std::int32_t> {
+  using type = std::int64_t;
+};
+} // namespace detail
+
+/**
+ * \brief      Signed fixed point number with saturating arithmetic, usable as the element type of
+ * every fastmatrix class on targets without a floating point unit
+ *
+ * The value is Raw / 2^FracBits. Results that do not fit are clamped to the largest or smallest
+ * representable value instead of wrapping around, so an overflowing filter degrades instead of
+ * flipping signs. Products and quotients are computed in an integer type twice as wide and rounded
+ * to nearest, sums and differences are exact unless they saturate.
+ *
+ * Conversions from and to floating point are explicit so that no float arithmetic slips into code
+ * meant to run on integers only; they are meant for constants, inputs and outputs
+ *
+ * \tparam     FracBits  Number of fractional bits
+ * \tparam     Raw       Signed integer type holding the value
+ */
+template <int FracBits, typename Raw>
+class fixed_point {
+  static_assert(std::is_integral<Raw>::value && std::is_signed<Raw>::value,
+                "Raw type must be a signed integer");
+  static_assert(FracBits > 0 && FracBits < std::numeric_limits<Raw>::digits + 1,
+                "Fractional bits must fit in the raw type");
+
+public:
+  /**
+   * Type of the underlying integer
+   */
+  using RawType = Raw;
+
+  /**
+   * Integer type holding the exact product of two raw values
+   */
+  using WideType = typename detail::wider_integer<Raw>::type;
+
+  /**
+   * Number of fractional bits
+   */
+  static constexpr int fractional_bits = FracBits;
+
+private:
+  Raw raw;
+
+  static constexpr WideType one = WideType(1) << FracBits;
+
+  /**
+   * \brief      Clamps a wide value to the range of the raw type
+   */
+  template <typename W>
+  static constexpr Raw saturate(W value) {
+    return value > W(std::numeric_limits<Raw>::max())   ? std::numeric_limits<Raw>::max()
+           : value < W(std::numeric_limits<Raw>::min()) ? std::numeric_limits<Raw>::min()
+                                                        : Raw(value);
+  }
+
+  /**
+   * \brief      Rounds a floating point value to the nearest raw value, saturating; NaN becomes 0
+   */
+  static constexpr Raw from_floating(double value) {
+    double scaled = value * double(one);
+    if (!(scaled == scaled)) {
+      return Raw(0);
+    }
+    if (scaled >= double(std::numeric_limits<Raw>::max())) {
+      return std::numeric_limits<Raw>::max();
+    }
+    if (scaled <= double(std::numeric_limits<Raw>::min())) {
+      return std::numeric_limits<Raw>::min();
+    }
+    return Raw(scaled < 0.0 ? scaled - 0.5 : scaled + 0.5);
+  }
+
+  struct raw_tag {};
+  constexpr fixed_point(Raw value, raw_tag) : raw(value) {}
+
+public:
+  /**
+   * \brief      Default constructor, the value is zero
+   */
+  constexpr fixed_point() : raw(0) {}
+
+  /**
+   * \brief      Constructor from an integer, saturating
+   */
+  explicit constexpr fixed_point(int value)
+      : raw(saturate(std::int64_t(value) * std::int64_t(std::int64_t(1) << FracBits))) {}
+
+  /**
+   * \brief      Constructor from a float, rounded to nearest and saturating
+   */
+  explicit constexpr fixed_point(float value) : raw(from_floating(value)) {}
+
+  /**
+   * \brief      Constructor from a double, rounded to nearest and saturating
+   */
+  explicit constexpr fixed_point(double value) : raw(from_floating(value)) {}
+
+  /**
+   * \brief      Creates a number from its raw representation
+   *
+   * \param[in]  value  The raw value, the number is value / 2^FracBits
+   */
+  static constexpr fixed_point from_raw(Raw value) {
+    return fixed_point(value, raw_tag());
+  }
+
+  /**
+   * \brief      Gets the raw representation
+   */
+  constexpr Raw raw_value() const {
+    return raw;
+  }
+
+  explicit constexpr operator float() const {
+    return float(raw) / float(one);
+  }
+
+  explicit constexpr operator double() const {
+    return double(raw) / double(one);
+  }
+
+  friend constexpr fixed_point operator+(fixed_point a, fixed_point b) {
+    return from_raw(saturate(WideType(a.raw) + WideType(b.raw)));
+  }
+
+  friend constexpr fixed_point operator-(fixed_point a, fixed_point b) {
+    return from_raw(saturate(WideType(a.raw) - WideType(b.raw)));
+  }
+
+  friend constexpr fixed_point operator-(fixed_point a) {
+    return from_raw(saturate(-WideType(a.raw)));
+  }
+
+  friend constexpr fixed_point operator*(fixed_point a, fixed_point b) {
+    // round half up, the shift of a negative value is arithmetic on every supported compiler
+    WideType product = WideType(a.raw) * WideType(b.raw);
+    return from_raw(saturate((product + (WideType(1) << (FracBits - 1))) >> FracBits));
+  }
+
+  /**
+   * \brief      Division, rounded to nearest. Dividing by zero saturates towards the sign of the
+   * dividend, 0 / 0 is 0
+   */
+  friend constexpr fixed_point operator/(fixed_point a, fixed_point b) {
+    if (b.raw == 0) {
+      return from_raw(a.raw > 0   ? std::numeric_limits<Raw>::max()
+                      : a.raw < 0 ? std::numeric_limits<Raw>::min()
+                                  : Raw(0));
+    }
+    WideType numerator = WideType(a.raw) * one;
+    WideType half = (b.raw < 0 ? -WideType(b.raw) : WideType(b.raw)) / 2;
+    numerator += (numerator < 0) == (b.raw < 0) ? half : -half;
+    return from_raw(saturate(numerator / WideType(b.raw)));
+  }
+
+  constexpr fixed_point &operator+=(fixed_point other) {
+    return *this = *this + other;
+  }
+
+  constexpr fixed_point &operator-=(fixed_point other) {
+    return *this = *this - other;
+  }
+
+  constexpr fixed_point &operator*=(fixed_point other) {
+    return *this = *this * other;
+  }
+
+  constexpr fixed_point &operator/=(fixed_point other) {
+    return *this = *this / other;
+  }
+
+  friend constexpr bool operator==(fixed_point a, fixed_point b) {
+    return a.raw == b.raw;
+  }
+
+  friend constexpr bool operator!=(fixed_point a, fixed_point b) {
+    return a.raw != b.raw;
+  }
+
+  friend constexpr bool operator<(fixed_point a, fixed_point b) {
+    return a.raw < b.raw;
+  }
+
+  friend constexpr bool operator>(fixed_point a, fixed_point b) {
+    return a.raw > b.raw;
+  }
+
+  friend constexpr bool operator<=(fixed_point a, fixed_point b) {
+    return a.raw <= b.raw;
+  }
+
+  friend constexpr bool operator>=(fixed_point a, fixed_point b) {
+    return a.raw >= b.raw;
+  }
+
+  /**
+   * \brief      Absolute value, saturating
+   */
+  friend constexpr fixed_point abs(fixed_point a) {
+    return a.raw < 0 ? -a : a;
+  }
+
+  /**
+   * \brief      Square root rounded down, computed digit by digit on the integer a * 2^FracBits.
+   * Negative arguments give 0
+   */
+  friend inline fixed_point sqrt(fixed_point a) {
+    if (a.raw <= 0) {
+      return fixed_point();
+    }
+    using Unsigned = std::make_unsigned_t<WideType>;
+    Unsigned n = Unsigned(a.raw) << FracBits;
+    Unsigned root = 0;
+    Unsigned bit = Unsigned(1) << (std::numeric_limits<Unsigned>::digits - 2);
+    while (bit > n) {
+      bit >>= 2;
+    }
+    while (bit != 0) {
+      if (n >= root + bit) {
+        n -= root + bit;
+        root = (root >> 1) + bit;
+      } else {
+        root >>= 1;
+      }
+      bit >>= 2;
+    }
+    return from_raw(saturate(WideType(root)));
+  }
+
+  friend std::ostream &operator<<(std::ostream &os, fixed_point a) {
+    return os << double(a);
+  }
+};
+
+/**
+ * Q15: 16 bits, range [-1, 1)
+ */
+using q15 = fixed_point<15, std::int16_t>;
+
+/**
+ * Q31: 32 bits, range [-1, 1)
+ */
+using q31 = fixed_point<31, std::int32_t>;
+
+/**
+ * Q4.27: 32 bits, range [-16, 16) with a resolution of 7.5e-9. Q15 and Q31 cannot hold the
+ * intermediate values of a Kalman filter (gains and innovations reach past 1), this is the
+ * 32 bit format EKF is instantiated with
+ */
+using q4_27 = fixed_point<27, std::int32_t>;
+
+} // namespace fastmatrix
+
+/**
+ * \brief      Limits of a fixed point type, epsilon is one step of the raw value, which is what
+ * tolerances such as the pivot threshold of ldlt need
+ */
+namespace std {
+template <int FracBits, typename Raw>
+class numeric_limits<fastmatrix::fixed_point<FracBits, Raw>> {
+  using type = fastmatrix::fixed_point<FracBits, Raw>;
+
+public:
+  static constexpr bool is_specialized = true;
+  static constexpr bool is_signed = true;
+  static constexpr bool is_integer = false;
+  static constexpr bool is_exact = true;
+  static constexpr bool is_bounded = true;
+  static constexpr int digits = std::numeric_limits<Raw>::digits;
+
+  static constexpr type min() {
+    return type::from_raw(1);
+  }
+
+  static constexpr type max() {
+    return type::from_raw(std::numeric_limits<Raw>::max());
+  }
+
+  static constexpr type lowest() {
+    return type::from_raw(std::numeric_limits<Raw>::min());
+  }
+
+  static constexpr type epsilon() {
+    return type::from_raw(1);
+  }
+};
+} // namespace std
+
+#endif // FASTMATRIX_FIXED_POINT_HPP
@@ -0,0 +1,419 @@
+#ifndef FASTMATRIX_GEMM_HPP
+#define FASTMATRIX_GEMM_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "fastmatrix_unroll.hpp"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace fastmatrix {
+namespace gemm {
+
+/**
+ * \brief      Trait for whether the GEMM kernels support an element type
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+struct is_supported : std::integral_constant<bool, std::is_same<T, float>::value ||
+                                                       std::is_same<T, double>::value> {};
+
+/**
+ * \brief      Thin wrapper around the widest SIMD register available for an element type
+ *
+ * The primary template is the portable fallback which treats a single scalar as a register. The
+ * specializations below are selected by the instruction sets the compiler targets, so building with
+ * e.g. -mavx2 -mfma picks the AVX2 kernels without any source changes
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+struct simd {
+  using reg = T;
+  static constexpr std::size_t width = 1;
+  static inline reg zero() { return T(0); }
+  static inline reg load(T const *p) { return *p; }
+  static inline void store(T *p, reg r) { *p = r; }
+  static inline reg broadcast(T x) { return x; }
+  static inline reg add(reg a, reg b) { return a + b; }
+  static inline reg fmadd(reg a, reg b, reg c) { return a * b + c; }
+};
+
+#if defined(__AVX__)
+template <>
+struct simd<float> {
+  using reg = __m256;
+  static constexpr std::size_t width = 8;
+  static inline reg zero() { return _mm256_setzero_ps(); }
+  static inline reg load(float const *p) { return _mm256_loadu_ps(p); }
+  static inline void store(float *p, reg r) { _mm256_storeu_ps(p, r); }
+  static inline reg broadcast(float x) { return _mm256_set1_ps(x); }
+  static inline reg add(reg a, reg b) { return _mm256_add_ps(a, b); }
+#if defined(__FMA__)
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+};
+
+template <>
+struct simd<double> {
+  using reg = __m256d;
+  static constexpr std::size_t width = 4;
+  static inline reg zero() { return _mm256_setzero_pd(); }
+  static inline reg load(double const *p) { return _mm256_loadu_pd(p); }
+  static inline void store(double *p, reg r) { _mm256_storeu_pd(p, r); }
+  static inline reg broadcast(double x) { return _mm256_set1_pd(x); }
+  static inline reg add(reg a, reg b) { return _mm256_add_pd(a, b); }
+#if defined(__FMA__)
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm256_fmadd_pd(a, b, c); }
+#else
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm256_add_pd(_mm256_mul_pd(a, b), c); }
+#endif
+};
+#elif defined(__SSE2__)
+template <>
+struct simd<float> {
+  using reg = __m128;
+  static constexpr std::size_t width = 4;
+  static inline reg zero() { return _mm_setzero_ps(); }
+  static inline reg load(float const *p) { return _mm_loadu_ps(p); }
+  static inline void store(float *p, reg r) { _mm_storeu_ps(p, r); }
+  static inline reg broadcast(float x) { return _mm_set1_ps(x); }
+  static inline reg add(reg a, reg b) { return _mm_add_ps(a, b); }
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+};
+
+template <>
+struct simd<double> {
+  using reg = __m128d;
+  static constexpr std::size_t width = 2;
+  static inline reg zero() { return _mm_setzero_pd(); }
+  static inline reg load(double const *p) { return _mm_loadu_pd(p); }
+  static inline void store(double *p, reg r) { _mm_storeu_pd(p, r); }
+  static inline reg broadcast(double x) { return _mm_set1_pd(x); }
+  static inline reg add(reg a, reg b) { return _mm_add_pd(a, b); }
+  static inline reg fmadd(reg a, reg b, reg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+};
+#elif defined(__ARM_NEON)
+template <>
+struct simd<float> {
+  using reg = float32x4_t;
+  static constexpr std::size_t width = 4;
+  static inline reg zero() { return vdupq_n_f32(0.0f); }
+  static inline reg load(float const *p) { return vld1q_f32(p); }
+  static inline void store(float *p, reg r) { vst1q_f32(p, r); }
+  static inline reg broadcast(float x) { return vdupq_n_f32(x); }
+  static inline reg add(reg a, reg b) { return vaddq_f32(a, b); }
+#if defined(__aarch64__)
+  static inline reg fmadd(reg a, reg b, reg c) { return vfmaq_f32(c, a, b); }
+#else
+  static inline reg fmadd(reg a, reg b, reg c) { return vmlaq_f32(c, a, b); }
+#endif
+};
+
+#if defined(__aarch64__)
+template <>
+struct simd<double> {
+  using reg = float64x2_t;
+  static constexpr std::size_t width = 2;
+  static inline reg zero() { return vdupq_n_f64(0.0); }
+  static inline reg load(double const *p) { return vld1q_f64(p); }
+  static inline void store(double *p, reg r) { vst1q_f64(p, r); }
+  static inline reg broadcast(double x) { return vdupq_n_f64(x); }
+  static inline reg add(reg a, reg b) { return vaddq_f64(a, b); }
+  static inline reg fmadd(reg a, reg b, reg c) { return vfmaq_f64(c, a, b); }
+};
+#endif
+#endif
+
+/**
+ * \brief      Register blocking and cache tiling parameters for an element type
+ *
+ * The micro-kernel keeps an MR x NR tile of C in MR * NV registers. KC x NR slivers of packed B
+ * are sized to stay in L1, MC x KC blocks of packed A in L2 and KC x NC panels of packed B in L3
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+struct blocking {
+  static constexpr std::size_t MR = 4;
+  static constexpr std::size_t NV = simd<T>::width == 1 ? 4 : 2;
+  static constexpr std::size_t NR = NV * simd<T>::width;
+  static constexpr std::size_t KC = 256;
+  static constexpr std::size_t MC = 128;
+  static constexpr std::size_t NC = 2048;
+};
+
+/**
+ * Products with fewer multiply-adds than this skip packing and use the small kernel
+ */
+constexpr std::size_t blocked_threshold = 32 * 32 * 32;
+
+/**
+ * \brief      Multiplies small row-major matrices, C = A * B
+ *
+ * Accumulates rows of C in i-k-j order so that the innermost loop streams contiguous rows of B and
+ * C, which the compiler can vectorize
+ *
+ * \param      a     Pointer to m x k matrix A
+ * \param      b     Pointer to k x n matrix B
+ * \param      c     Pointer to m x n matrix C, overwritten
+ * \param[in]  m     Number of rows of A and C
+ * \param[in]  k     Number of columns of A and rows of B
+ * \param[in]  n     Number of columns of B and C
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+inline void multiply_small(T const *a, T const *b, T *c, std::size_t m, std::size_t k,
+                           std::size_t n) {
+  for (std::size_t i = 0; i < m; ++i) {
+    T *c_row = c + i * n;
+    T const a_i0 = a[i * k];
+    for (std::size_t j = 0; j < n; ++j) {
+      c_row[j] = a_i0 * b[j];
+    }
+    for (std::size_t p = 1; p < k; ++p) {
+      T const a_ip = a[i * k + p];
+      T const *b_row = b + p * n;
+      for (std::size_t j = 0; j < n; ++j) {
+        c_row[j] += a_ip * b_row[j];
+      }
+    }
+  }
+}
+
+/**
+ * \brief      Multiplies row-major matrices whose dimensions are known at compile time, C = A * B
+ *
+ * Same i-k-j order and rounding as multiply_small, fully unrolled with C accumulated in locals and
+ * stored last, so the compiler is free to keep it in registers and vectorize across rows whatever
+ * C points to. For products within unroll::limit in every dimension
+ *
+ * \param      a     Pointer to M x K matrix A
+ * \param      b     Pointer to K x N matrix B
+ * \param      c     Pointer to M x N matrix C, overwritten
+ *
+ * \tparam     M     Number of rows of A and C
+ * \tparam     K     Number of columns of A and rows of B
+ * \tparam     N     Number of columns of B and C
+ * \tparam     T     Element type
+ */
+template <std::size_t M, std::size_t K, std::size_t N, typename T>
+FASTMATRIX_ALWAYS_INLINE void multiply_fixed(T const *a, T const *b, T *c) {
+  static_assert(unroll::fits(M, K, N), "Dimensions too large to unroll");
+  T acc[M * N];
+  unroll::static_for<M>([&](auto i) FASTMATRIX_INLINE_BODY {
+    unroll::static_for<N>(
+        [&](auto j) FASTMATRIX_INLINE_BODY { acc[i * N + j] = a[i * K] * b[j]; });
+    unroll::static_for<K - 1>([&](auto q) FASTMATRIX_INLINE_BODY {
+      constexpr std::size_t p = q + 1;
+      unroll::static_for<N>([&](auto j) FASTMATRIX_INLINE_BODY {
+        acc[i * N + j] += a[i * K + p] * b[p * N + j];
+      });
+    });
+  });
+  unroll::static_for<M * N>([&](auto ij) FASTMATRIX_INLINE_BODY { c[ij] = acc[ij]; });
+}
+
+/**
+ * \brief      Packs an mc x kc block of row-major A into MR-row slivers, zero padding the last one
+ *
+ * \param      a     Pointer to the top left element of the block
+ * \param[in]  lda   Row stride of A
+ * \param[in]  mc    Number of rows in the block
+ * \param[in]  kc    Number of columns in the block
+ * \param      out   Packed buffer of at least ceil(mc / MR) * MR * kc elements
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+inline void pack_a(T const *a, std::size_t lda, std::size_t mc, std::size_t kc, T *out) {
+  constexpr std::size_t MR = blocking<T>::MR;
+  for (std::size_t ir = 0; ir < mc; ir += MR) {
+    std::size_t const mr = std::min(MR, mc - ir);
+    for (std::size_t p = 0; p < kc; ++p) {
+      for (std::size_t r = 0; r < MR; ++r) {
+        *out++ = r < mr ? a[(ir + r) * lda + p] : T(0);
+      }
+    }
+  }
+}
+
+/**
+ * \brief      Packs a kc x nc panel of row-major B into NR-column slivers, zero padding the last one
+ *
+ * \param      b     Pointer to the top left element of the panel
+ * \param[in]  ldb   Row stride of B
+ * \param[in]  kc    Number of rows in the panel
+ * \param[in]  nc    Number of columns in the panel
+ * \param      out   Packed buffer of at least ceil(nc / NR) * NR * kc elements
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+inline void pack_b(T const *b, std::size_t ldb, std::size_t kc, std::size_t nc, T *out) {
+  constexpr std::size_t NR = blocking<T>::NR;
+  for (std::size_t jr = 0; jr < nc; jr += NR) {
+    std::size_t const nr = std::min(NR, nc - jr);
+    for (std::size_t p = 0; p < kc; ++p) {
+      T const *b_row = b + p * ldb + jr;
+      for (std::size_t col = 0; col < NR; ++col) {
+        *out++ = col < nr ? b_row[col] : T(0);
+      }
+    }
+  }
+}
+
+/**
+ * \brief      Register-blocked micro-kernel, C[0:mr, 0:nr] += packed A sliver * packed B sliver
+ *
+ * \param[in]  kc    Depth of the slivers
+ * \param      a     Packed MR x kc sliver of A
+ * \param      b     Packed kc x NR sliver of B
+ * \param      c     Pointer to the top left element of the C tile
+ * \param[in]  ldc   Row stride of C
+ * \param[in]  mr    Number of valid rows in the tile, at most MR
+ * \param[in]  nr    Number of valid columns in the tile, at most NR
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+inline void micro_kernel(std::size_t kc, T const *a, T const *b, T *c, std::size_t ldc,
+                         std::size_t mr, std::size_t nr) {
+  using V = simd<T>;
+  using reg = typename V::reg;
+  constexpr std::size_t MR = blocking<T>::MR;
+  constexpr std::size_t NV = blocking<T>::NV;
+  constexpr std::size_t NR = blocking<T>::NR;
+  constexpr std::size_t W = V::width;
+
+  reg acc[MR][NV];
+  for (std::size_t r = 0; r < MR; ++r) {
+    for (std::size_t v = 0; v < NV; ++v) {
+      acc[r][v] = V::zero();
+    }
+  }
+
+  for (std::size_t p = 0; p < kc; ++p) {
+    reg b_regs[NV];
+    for (std::size_t v = 0; v < NV; ++v) {
+      b_regs[v] = V::load(b + p * NR + v * W);
+    }
+    for (std::size_t r = 0; r < MR; ++r) {
+      reg const a_reg = V::broadcast(a[p * MR + r]);
+      for (std::size_t v = 0; v < NV; ++v) {
+        acc[r][v] = V::fmadd(a_reg, b_regs[v], acc[r][v]);
+      }
+    }
+  }
+
+  if (mr == MR && nr == NR) {
+    for (std::size_t r = 0; r < MR; ++r) {
+      for (std::size_t v = 0; v < NV; ++v) {
+        T *dst = c + r * ldc + v * W;
+        V::store(dst, V::add(V::load(dst), acc[r][v]));
+      }
+    }
+  } else {
+    T tile[MR * NR];
+    for (std::size_t r = 0; r < MR; ++r) {
+      for (std::size_t v = 0; v < NV; ++v) {
+        V::store(tile + r * NR + v * W, acc[r][v]);
+      }
+    }
+    for (std::size_t r = 0; r < mr; ++r) {
+      for (std::size_t col = 0; col < nr; ++col) {
+        c[r * ldc + col] += tile[r * NR + col];
+      }
+    }
+  }
+}
+
+/**
+ * \brief      Multiplies large row-major matrices with cache tiling and packed operands, C = A * B
+ *
+ * \param      a     Pointer to m x k matrix A
+ * \param      b     Pointer to k x n matrix B
+ * \param      c     Pointer to m x n matrix C, overwritten
+ * \param[in]  m     Number of rows of A and C
+ * \param[in]  k     Number of columns of A and rows of B
+ * \param[in]  n     Number of columns of B and C
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+inline void multiply_blocked(T const *a, T const *b, T *c, std::size_t m, std::size_t k,
+                             std::size_t n) {
+  using B = blocking<T>;
+  std::fill(c, c + m * n, T(0));
+
+  std::size_t const mc_max = std::min(B::MC, (m + B::MR - 1) / B::MR * B::MR);
+  std::size_t const nc_max = std::min(B::NC, (n + B::NR - 1) / B::NR * B::NR);
+  std::size_t const kc_max = std::min(B::KC, k);
+  std::vector<T> a_packed(mc_max * kc_max);
+  std::vector<T> b_packed(nc_max * kc_max);
+
+  for (std::size_t jc = 0; jc < n; jc += B::NC) {
+    std::size_t const nc = std::min(B::NC, n - jc);
+    for (std::size_t pc = 0; pc < k; pc += B::KC) {
+      std::size_t const kc = std::min(B::KC, k - pc);
+      pack_b(b + pc * n + jc, n, kc, nc, b_packed.data());
+      for (std::size_t ic = 0; ic < m; ic += B::MC) {
+        std::size_t const mc = std::min(B::MC, m - ic);
+        pack_a(a + ic * k + pc, k, mc, kc, a_packed.data());
+        for (std::size_t jr = 0; jr < nc; jr += B::NR) {
+          std::size_t const nr = std::min(B::NR, nc - jr);
+          for (std::size_t ir = 0; ir < mc; ir += B::MR) {
+            std::size_t const mr = std::min(B::MR, mc - ir);
+            micro_kernel(kc, a_packed.data() + ir * kc, b_packed.data() + jr * kc,
+                         c + (ic + ir) * n + jc + jr, n, mr, nr);
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * \brief      Multiplies row-major matrices, C = A * B
+ *
+ * Small products, such as the ones in an EKF step, use a simple kernel that needs no scratch
+ * memory. Larger ones are tiled for the cache hierarchy and run through the SIMD micro-kernel
+ *
+ * \param      a     Pointer to m x k matrix A
+ * \param      b     Pointer to k x n matrix B
+ * \param      c     Pointer to m x n matrix C, overwritten, must not alias A or B
+ * \param[in]  m     Number of rows of A and C
+ * \param[in]  k     Number of columns of A and rows of B
+ * \param[in]  n     Number of columns of B and C
+ *
+ * \tparam     T     Element type
+ */
+template <typename T>
+inline void multiply(T const *a, T const *b, T *c, std::size_t m, std::size_t k, std::size_t n) {
+  if (m == 0 || n == 0) {
+    return;
+  }
+  if (k == 0) {
+    std::fill(c, c + m * n, T(0));
+  } else if (m * n * k < blocked_threshold) {
+    multiply_small(a, b, c, m, k, n);
+  } else {
+    multiply_blocked(a, b, c, m, k, n);
+  }
+}
+
+} // namespace gemm
+} // namespace fastmatrix
+
+#endif // FASTMATRIX_GEMM_HPP
@@ -0,0 +1,463 @@
+#ifndef FASTMATRIX_INSTRUMENTATION_HPP
+#define FASTMATRIX_INSTRUMENTATION_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#if defined(FASTMATRIX_INSTRUMENTATION)
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#endif
+
+/**
+ * Compile time switchable instrumentation of the hot paths: scoped timers, counters of matrix
+ * allocations, product temporaries, flops and bytes, and exports of the results as JSON and as a
+ * Chrome trace (chrome://tracing, Perfetto).
+ *
+ * Building with -DFASTMATRIX_INSTRUMENTATION turns it on. Without it FASTMATRIX_SCOPE and
+ * FASTMATRIX_COUNT expand to nothing, their arguments are not evaluated and the instrumented code
+ * compiles to what it was without them; the snapshot and export functions stay available and report
+ * an empty, disabled snapshot, so callers need no #ifdefs of their own.
+ *
+ *   void filter::predict() {
+ *     FASTMATRIX_SCOPE("filter.predict");
+ *     ...
+ *   }
+ *   fastmatrix::instrumentation::write_json(std::cout, fastmatrix::instrumentation::take_snapshot());
+ *
+ * Each thread records into data of its own without locking. A snapshot reads every thread's data,
+ * so take it once the instrumented threads are done or paused.
+ */
+namespace fastmatrix {
+namespace instrumentation {
+
+/**
+ * \brief      Counts of durations in log-linear buckets
+ *
+ * Exact below 8 ns, then 8 buckets per power of two, so a value is placed within 12.5% up to
+ * 2^40 ns. One thread records into a histogram, read it once that thread is done
+ */
+class histogram {
+public:
+  static constexpr int sub_buckets = 8;
+  static constexpr int buckets = 39 * sub_buckets;
+
+  inline histogram() : counts{}, n(0), total(0), largest(0) {}
+
+  /**
+   * \brief      Adds a value
+   *
+   * \param[in]  ns    The value, in nanoseconds
+   */
+  inline void record(std::int64_t ns) {
+    ++counts[bucket(ns)];
+    ++n;
+    total += ns;
+    largest = std::max(largest, ns);
+  }
+
+  /**
+   * \brief      Adds the values of another histogram
+   *
+   * \param[in]  other  The other histogram
+   */
+  inline void merge(histogram const &other) {
+    for (int i = 0; i < buckets; ++i) {
+      counts[i] += other.counts[i];
+    }
+    n += other.n;
+    total += other.total;
+    largest = std::max(largest, other.largest);
+  }
+
+  inline std::uint64_t count() const {
+    return n;
+  }
+
+  inline std::int64_t max() const {
+    return largest;
+  }
+
+  inline double mean() const {
+    return n ? double(total) / n : 0.0;
+  }
+
+  /**
+   * \brief      Gets a percentile
+   *
+   * \param[in]  p     The fraction of the values, in [0, 1]
+   *
+   * \return     Upper edge of the bucket holding the p-th fraction of the values
+   */
+  inline std::int64_t percentile(double p) const {
+    if (n == 0) {
+      return 0;
+    }
+    std::uint64_t const rank = std::uint64_t(p * (n - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (int i = 0; i < buckets; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(upper_edge(i), largest);
+      }
+    }
+    return largest;
+  }
+
+private:
+  static inline int bucket(std::int64_t ns) {
+    if (ns < sub_buckets) {
+      return ns < 0 ? 0 : int(ns);
+    }
+    std::uint64_t const v =
+        std::min<std::uint64_t>(std::uint64_t(ns), (std::uint64_t(1) << 41) - 1);
+    int const e = 63 - __builtin_clzll(v); // v in [2^e, 2^(e+1)), e >= 3
+    int const sub = int(v >> (e - 3)) & (sub_buckets - 1);
+    return (e - 2) * sub_buckets + sub;
+  }
+
+  static inline std::int64_t upper_edge(int bucket) {
+    if (bucket < sub_buckets) {
+      return bucket;
+    }
+    int const e = bucket / sub_buckets + 2;
+    int const sub = bucket % sub_buckets;
+    std::int64_t const lower = std::int64_t(sub_buckets + sub) << (e - 3);
+    return lower + (std::int64_t(1) << (e - 3)) - 1;
+  }
+
+  std::uint64_t counts[buckets];
+  std::uint64_t n;
+  std::int64_t total;
+  std::int64_t largest;
+};
+
+/**
+ * Quantities the library counts. Flops and bytes are the nominal counts of the dense operation,
+ * operands and result read or written once, whether or not structural zeros were skipped
+ */
+enum class counter : std::size_t {
+  allocations,     ///< heap allocations of matrix storage
+  allocated_bytes, ///< their size
+  temporaries,     ///< product expressions evaluated into a temporary
+  flops,           ///< multiplies and adds of products and decompositions
+  bytes            ///< bytes of operands and results those touched
+};
+
+constexpr std::size_t counter_count = 5;
+
+inline char const *counter_name(std::size_t c) {
+  static char const *const names[counter_count] = {"allocations", "allocated_bytes", "temporaries",
+                                                   "flops", "bytes"};
+  return names[c];
+}
+
+/**
+ * Totals of one FASTMATRIX_SCOPE site over every thread: the duration of each call and the counts
+ * made while inside it, nested scopes included
+ */
+struct site_snapshot {
+  std::string name;
+  histogram calls;
+  std::uint64_t counters[counter_count] = {};
+};
+
+struct snapshot {
+  bool enabled = false;
+  std::size_t threads = 0;
+  std::uint64_t counters[counter_count] = {}; ///< over every thread, inside scopes or not
+  std::vector<site_snapshot> sites;
+  std::uint64_t trace_events = 0;
+  std::uint64_t dropped_trace_events = 0; ///< past max_trace_events of their thread
+};
+
+#if defined(FASTMATRIX_INSTRUMENTATION)
+constexpr bool enabled = true;
+
+/**
+ * Trace events kept per thread, reserved when the thread first records; later scopes still count in
+ * the histograms
+ */
+constexpr std::size_t max_trace_events = std::size_t(1) << 16;
+
+/**
+ * Sites whose names and per thread totals are reserved up front. Past the first scope of a thread,
+ * which registers it, recording allocates nothing until there are more sites than this, so code
+ * checked for allocations can be instrumented as long as its outermost scope opens before the check
+ */
+constexpr std::size_t reserved_sites = 256;
+
+namespace detail {
+
+struct trace_event {
+  std::uint32_t site;
+  std::int64_t begin_ns;
+  std::int64_t duration_ns;
+};
+
+struct site_totals {
+  histogram calls;
+  std::uint64_t counters[counter_count] = {};
+};
+
+struct thread_record {
+  std::uint32_t id = 0;
+  std::uint64_t counters[counter_count] = {};
+  std::vector<site_totals> sites;
+  std::vector<trace_event> events;
+  std::uint64_t dropped_events = 0;
+};
+
+/**
+ * Site names and the records of every thread that has recorded, kept after the thread exits
+ */
+struct registry {
+  std::mutex mutex;
+  std::vector<char const *> sites;
+  std::vector<std::shared_ptr<thread_record>> threads;
+
+  inline registry() {
+    sites.reserve(reserved_sites);
+  }
+};
+
+inline registry &global() {
+  static registry r;
+  return r;
+}
+
+inline std::int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+inline thread_record &this_thread() {
+  thread_local thread_record *record = [] {
+    auto r = std::make_shared<thread_record>();
+    r->events.reserve(max_trace_events);
+    r->sites.reserve(reserved_sites);
+    registry &g = global();
+    std::lock_guard<std::mutex> lock(g.mutex);
+    r->id = std::uint32_t(g.threads.size());
+    g.threads.push_back(r);
+    return r.get();
+  }();
+  return *record;
+}
+
+} // namespace detail
+
+/**
+ * \brief      Gets the index of a site, the same for every site of that name
+ *
+ * \param[in]  name  The site name, a string that outlives the program such as a literal
+ *
+ * \return     The index
+ */
+inline std::uint32_t register_site(char const *name) {
+  detail::registry &g = detail::global();
+  std::lock_guard<std::mutex> lock(g.mutex);
+  for (std::size_t i = 0; i < g.sites.size(); ++i) {
+    if (!std::strcmp(g.sites[i], name)) {
+      return std::uint32_t(i);
+    }
+  }
+  g.sites.push_back(name);
+  return std::uint32_t(g.sites.size() - 1);
+}
+
+inline void count(counter c, std::uint64_t n) {
+  detail::this_thread().counters[std::size_t(c)] += n;
+}
+
+/**
+ * \brief      Times its own lifetime, see FASTMATRIX_SCOPE
+ */
+class scope {
+public:
+  inline explicit scope(std::uint32_t site) : record(detail::this_thread()), site(site) {
+    std::copy(record.counters, record.counters + counter_count, start);
+    begin = detail::now_ns();
+  }
+
+  inline ~scope() {
+    std::int64_t const end = detail::now_ns();
+    if (record.sites.size() <= site) {
+      record.sites.resize(site + 1); // first call of the site on this thread, within the reserve
+    }
+    detail::site_totals &totals = record.sites[site];
+    totals.calls.record(end - begin);
+    for (std::size_t c = 0; c < counter_count; ++c) {
+      totals.counters[c] += record.counters[c] - start[c];
+    }
+    if (record.events.size() < max_trace_events) {
+      record.events.push_back({site, begin, end - begin});
+    } else {
+      ++record.dropped_events;
+    }
+  }
+
+  scope(scope const &) = delete;
+  scope &operator=(scope const &) = delete;
+
+private:
+  detail::thread_record &record;
+  std::uint32_t site;
+  std::uint64_t start[counter_count];
+  std::int64_t begin;
+};
+
+/**
+ * \brief      Sums the records of every thread, sites merged by name
+ *
+ * \return     The snapshot
+ */
+inline snapshot take_snapshot() {
+  detail::registry &g = detail::global();
+  std::lock_guard<std::mutex> lock(g.mutex);
+  snapshot s;
+  s.enabled = true;
+  s.threads = g.threads.size();
+  for (char const *name : g.sites) {
+    s.sites.emplace_back();
+    s.sites.back().name = name;
+  }
+  for (auto const &t : g.threads) {
+    for (std::size_t c = 0; c < counter_count; ++c) {
+      s.counters[c] += t->counters[c];
+    }
+    for (std::size_t i = 0; i < t->sites.size(); ++i) {
+      s.sites[i].calls.merge(t->sites[i].calls);
+      for (std::size_t c = 0; c < counter_count; ++c) {
+        s.sites[i].counters[c] += t->sites[i].counters[c];
+      }
+    }
+    s.trace_events += t->events.size();
+    s.dropped_trace_events += t->dropped_events;
+  }
+  return s;
+}
+
+/**
+ * \brief      Clears the records of every thread, which must not be recording meanwhile
+ */
+inline void reset() {
+  detail::registry &g = detail::global();
+  std::lock_guard<std::mutex> lock(g.mutex);
+  for (auto const &t : g.threads) {
+    std::fill(t->counters, t->counters + counter_count, 0);
+    t->sites.assign(t->sites.size(), detail::site_totals());
+    t->events.clear();
+    t->dropped_events = 0;
+  }
+}
+
+/**
+ * \brief      Writes the trace events of every thread in the Chrome trace event format, one complete
+ * ("X") event per scope call
+ *
+ * \param      out   The stream
+ */
+inline void write_chrome_trace(std::ostream &out) {
+  detail::registry &g = detail::global();
+  std::lock_guard<std::mutex> lock(g.mutex);
+  std::int64_t origin = INT64_MAX;
+  for (auto const &t : g.threads) {
+    for (auto const &e : t->events) {
+      origin = std::min(origin, e.begin_ns);
+    }
+  }
+  out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  char const *separator = "\n";
+  for (auto const &t : g.threads) {
+    for (auto const &e : t->events) {
+      out << separator << "{\"name\":\"" << g.sites[e.site] << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+          << t->id << ",\"ts\":" << double(e.begin_ns - origin) * 1e-3
+          << ",\"dur\":" << double(e.duration_ns) * 1e-3 << "}";
+      separator = ",\n";
+    }
+  }
+  out << "\n]}\n";
+}
+#else
+constexpr bool enabled = false;
+
+inline snapshot take_snapshot() {
+  return snapshot();
+}
+
+inline void reset() {}
+
+inline void write_chrome_trace(std::ostream &out) {
+  out << "{\"traceEvents\":[]}\n";
+}
+#endif
+
+/**
+ * \brief      Writes a snapshot as JSON: the counters, then per site the call count, the duration
+ * percentiles in nanoseconds and the counters per call
+ *
+ * \param      out   The stream
+ * \param[in]  s     The snapshot
+ */
+inline void write_json(std::ostream &out, snapshot const &s) {
+  out << "{\n  \"enabled\": " << (s.enabled ? "true" : "false") << ",\n  \"threads\": " << s.threads
+      << ",\n  \"counters\": {";
+  for (std::size_t c = 0; c < counter_count; ++c) {
+    out << (c ? ", " : "") << "\"" << counter_name(c) << "\": " << s.counters[c];
+  }
+  out << "},\n  \"trace_events\": " << s.trace_events
+      << ",\n  \"dropped_trace_events\": " << s.dropped_trace_events << ",\n  \"sites\": [";
+  char const *separator = "\n";
+  for (auto const &site : s.sites) {
+    histogram const &h = site.calls;
+    out << separator << "    {\"name\": \"" << site.name << "\", \"calls\": " << h.count()
+        << ", \"mean_ns\": " << h.mean() << ", \"p50_ns\": " << h.percentile(0.5)
+        << ", \"p90_ns\": " << h.percentile(0.9) << ", \"p99_ns\": " << h.percentile(0.99)
+        << ", \"max_ns\": " << h.max() << ", \"per_call\": {";
+    for (std::size_t c = 0; c < counter_count; ++c) {
+      out << (c ? ", " : "") << "\"" << counter_name(c)
+          << "\": " << (h.count() ? double(site.counters[c]) / h.count() : 0.0);
+    }
+    out << "}}";
+    separator = ",\n";
+  }
+  out << "\n  ]\n}\n";
+}
+
+} // namespace instrumentation
+} // namespace fastmatrix
+
+#define FASTMATRIX_INSTRUMENTATION_CONCAT_(a, b) a##b
+#define FASTMATRIX_INSTRUMENTATION_CONCAT(a, b) FASTMATRIX_INSTRUMENTATION_CONCAT_(a, b)
+
+#if defined(FASTMATRIX_INSTRUMENTATION)
+/**
+ * Times the rest of the enclosing block under the given site name, with the counts made inside it
+ */
+#define FASTMATRIX_SCOPE(name)                                                                     \
+  static std::uint32_t const FASTMATRIX_INSTRUMENTATION_CONCAT(fastmatrix_site_, __LINE__) =      \
+      ::fastmatrix::instrumentation::register_site(name);                                         \
+  ::fastmatrix::instrumentation::scope FASTMATRIX_INSTRUMENTATION_CONCAT(fastmatrix_scope_,       \
+                                                                         __LINE__)(               \
+      FASTMATRIX_INSTRUMENTATION_CONCAT(fastmatrix_site_, __LINE__))
+
+/**
+ * Adds n to one of the counters, e.g. FASTMATRIX_COUNT(flops, 2 * m * k * n)
+ */
+#define FASTMATRIX_COUNT(name, n)                                                                  \
+  ::fastmatrix::instrumentation::count(::fastmatrix::instrumentation::counter::name,              \
+                                       std::uint64_t(n))
+#else
+#define FASTMATRIX_SCOPE(name) static_cast<void>(0)
+#define FASTMATRIX_COUNT(name, n) static_cast<void>(0)
+#endif
+
+#endif
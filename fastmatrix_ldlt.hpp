@@ -0,0 +1,192 @@
+#ifndef FASTMATRIX_LDLT_HPP
+#define FASTMATRIX_LDLT_HPP
+
+#include <limits>
+
+#include "fastmatrix_symmetric.hpp"
+
+namespace fastmatrix {
+
+/**
+ * \brief      Outcome of a matrix decomposition
+ */
+enum class decomposition_status {
+  /**
+   * The decomposition succeeded and can be used to solve
+   */
+  success,
+
+  /**
+   * A pivot was not positive, or too small relative to its diagonal element, so the matrix is not
+   * (numerically) symmetric positive definite
+   */
+  not_positive_definite,
+
+  /**
+   * Nothing has been decomposed yet
+   */
+  uninitialized
+};
+
+/**
+ * \brief      LDL^T decomposition of a symmetric positive definite matrix
+ *
+ * Factors A = L * D * transpose(L) with L unit lower triangular and D diagonal, without pivoting
+ * and without square roots. Solving A * X = B with the factors is cheaper and better conditioned
+ * than forming the inverse of A and multiplying by it, which is how a Kalman gain
+ * K = P * transpose(H) * S^-1 should be computed.
+ *
+ * The factors share one packed symmetric_matrix: D on its diagonal and L below it. Nothing is
+ * allocated when N is known at compile time
+ *
+ * \tparam     T     Type of elements
+ * \tparam     N     Number of rows and columns of the decomposed matrix, or dynamic
+ */
+template <typename T, std::size_t N = dynamic>
+class ldlt {
+private:
+  /**
+   * D on the diagonal, L strictly below it
+   */
+  symmetric_matrix<T, N> factors;
+
+  /**
+   * Outcome of the last call to compute()
+   */
+  decomposition_status state = decomposition_status::uninitialized;
+
+public:
+  /**
+   * \brief      Default constructor, call compute() before solving
+   */
+  inline ldlt() = default;
+
+  /**
+   * \brief      Constructor that decomposes the given matrix, check status() before solving
+   *
+   * \param      a     The symmetric matrix to decompose
+   *
+   * \tparam     E     Type of the expression
+   */
+  template <typename E>
+  inline explicit ldlt(expression<E> const &a) {
+    compute(a);
+  }
+
+  /**
+   * \brief      Decomposes a symmetric positive definite matrix
+   *
+   * Only the lower triangle of the expression is read
+   *
+   * \param      a     The symmetric matrix to decompose
+   *
+   * \tparam     E     Type of the expression
+   *
+   * \return     success, or not_positive_definite if a pivot is not positive
+   */
+  template <typename E>
+  inline decomposition_status compute(expression<E> const &a) {
+    static_assert(dimensions_match(static_rows_v<E>, N), "Row count of expression differs");
+    static_assert(dimensions_match(static_cols_v<E>, N), "Column count of expression differs");
+    assert(a.num_rows() == a.num_cols());
+    E const &m = a.get_const_derived();
+    std::size_t const n = m.num_rows();
+    FASTMATRIX_COUNT(flops, n * n * n / 3 + n * n);
+    FASTMATRIX_COUNT(bytes, n * (n + 1) * sizeof(T));
+    if constexpr (N == dynamic) {
+      if (factors.num_rows() != n) {
+        factors = symmetric_matrix<T, N>(n);
+      }
+    }
+
+    for (std::size_t j = 0; j < n; ++j) {
+      T d = m(j, j);
+      for (std::size_t k = 0; k < j; ++k) {
+        T const l_jk = factors(j, k);
+        d = d - l_jk * l_jk * factors(k, k);
+      }
+      // Rejects negative and NaN pivots as well as ones lost to cancellation
+      if (!(d > std::numeric_limits<T>::epsilon() * m(j, j))) {
+        state = decomposition_status::not_positive_definite;
+        return state;
+      }
+      factors.set_elt(j, j, d);
+      for (std::size_t i = j + 1; i < n; ++i) {
+        T sum = m(i, j);
+        for (std::size_t k = 0; k < j; ++k) {
+          sum = sum - factors(i, k) * factors(j, k) * factors(k, k);
+        }
+        factors.set_elt(i, j, sum / d);
+      }
+    }
+    state = decomposition_status::success;
+    return state;
+  }
+
+  /**
+   * \brief      Gets the outcome of the last decomposition
+   *
+   * \return     The status
+   */
+  inline decomposition_status status() const {
+    return state;
+  }
+
+  /**
+   * \brief      Solves A * X = B, overwriting B with X
+   *
+   * Each column of B goes through a forward substitution with L, a division by D and a back
+   * substitution with transpose(L). Must only be called after a successful compute()
+   *
+   * \param      b     Right hand side with as many rows as A, replaced by the solution
+   *
+   * \tparam     B     Type of the right hand side, a matrix type with set_elt
+   */
+  template <typename B>
+  inline void solve_in_place(B &b) const {
+    assert(state == decomposition_status::success);
+    assert(b.num_rows() == factors.num_rows());
+    std::size_t const n = factors.num_rows();
+    FASTMATRIX_COUNT(flops, 2 * n * n * b.num_cols());
+    FASTMATRIX_COUNT(bytes, (n * (n + 1) / 2 + 2 * n * b.num_cols()) * sizeof(T));
+    for (std::size_t c = 0; c < b.num_cols(); ++c) {
+      for (std::size_t i = 1; i < n; ++i) {
+        T sum = b(i, c);
+        for (std::size_t k = 0; k < i; ++k) {
+          sum = sum - factors(i, k) * b(k, c);
+        }
+        b.set_elt(i, c, sum);
+      }
+      for (std::size_t i = 0; i < n; ++i) {
+        b.set_elt(i, c, b(i, c) / factors(i, i));
+      }
+      for (std::size_t i = n; i-- > 0;) {
+        T sum = b(i, c);
+        for (std::size_t k = i + 1; k < n; ++k) {
+          sum = sum - factors(k, i) * b(k, c);
+        }
+        b.set_elt(i, c, sum);
+      }
+    }
+  }
+
+  /**
+   * \brief      Solves A * X = B
+   *
+   * \param      b     Right hand side with as many rows as A
+   *
+   * \tparam     E     Type of the right hand side expression
+   *
+   * \return     The solution X
+   */
+  template <typename E>
+  inline eval_return_type_t<E> solve(expression<E> const &b) const {
+    eval_return_type_t<E> x(b.num_rows(), b.num_cols());
+    x.assign(b.get_const_derived());
+    solve_in_place(x);
+    return x;
+  }
+};
+} // namespace fastmatrix
+
+#endif // FASTMATRIX_LDLT_HPP
@@ -0,0 +1,847 @@
+#ifndef FASTMATRIX_SYMMETRIC_HPP
+#define FASTMATRIX_SYMMETRIC_HPP
+
+#include "fastmatrix.hpp"
+
+namespace fastmatrix {
+
+/**
+ * \brief      Class for a symmetric matrix stored as its packed upper triangle
+ *
+ * Only the n * (n + 1) / 2 elements on and above the diagonal are stored, row by row. Reading (i, j)
+ * and (j, i) returns the same element, so the matrix stays exactly symmetric no matter what is
+ * assigned to it. Assigning an expression evaluates only its upper triangle, which halves the work
+ * of cwise operations between symmetric operands. The expression is assumed to be symmetric, its
+ * lower triangle is never read
+ *
+ * \tparam     T     The type of an element stored in the matrix
+ * \tparam     N     The number of rows and columns, or dynamic to size it at runtime
+ */
+template <typename T, std::size_t N = dynamic>
+class symmetric_matrix : public expression<symmetric_matrix<T, N>>,
+                         public block_access<symmetric_matrix<T, N>> {
+public:
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = symmetric_matrix<T, N>;
+
+  /**
+   * Type of elements of this matrix
+   */
+  using ElementType = T;
+
+  /**
+   * Compile time dimensions of this matrix
+   */
+  static constexpr std::size_t StaticRows = N;
+  static constexpr std::size_t StaticCols = N;
+
+private:
+  /**
+   * Container in which the packed upper triangle is stored, inline if N is known at compile time
+   */
+  std::conditional_t<N != dynamic, std::array<T, N *(N + 1) / 2>, std::vector<T>> container{};
+
+  /**
+   * Number of rows and columns of this matrix
+   */
+  std::size_t n = N;
+
+  /**
+   * \brief      Position of an element of the upper triangle in the packed container
+   *
+   * \param[in]  i     Row number, at most j
+   * \param[in]  j     Column number
+   *
+   * \return     Index into the container
+   */
+  inline std::size_t packed_index(std::size_t i, std::size_t j) const {
+    return i * (2 * num_rows() - i + 1) / 2 + (j - i);
+  }
+
+public:
+  /**
+   * \brief      Default constructor, all elements are zero
+   */
+  inline symmetric_matrix() = default;
+
+  /**
+   * \brief      Constructor for a dynamically sized symmetric matrix
+   *
+   * \param[in]  n     The number of rows and columns
+   */
+  inline explicit symmetric_matrix(std::size_t n) : n(n) {
+    if constexpr (N == dynamic) {
+      container.resize(n * (n + 1) / 2);
+      if (n) {
+        FASTMATRIX_COUNT(allocations, 1);
+        FASTMATRIX_COUNT(allocated_bytes, container.size() * sizeof(T));
+      }
+    } else {
+      assert(n == N);
+    }
+  }
+
+  /**
+   * \brief      Constructor
+   *
+   * Exists so that generic code which sizes its temporaries by rows and columns also works with
+   * symmetric matrices
+   *
+   * \param[in]  n_rows  The number of rows
+   * \param[in]  n_cols  The number of columns, must equal n_rows
+   */
+  inline symmetric_matrix(std::size_t n_rows, std::size_t n_cols) : symmetric_matrix(n_rows) {
+    assert(n_rows == n_cols);
+  }
+
+  /**
+   * \brief      Constructor from another expression, which must be symmetric
+   *
+   * \param      other  The expression
+   *
+   * \tparam     E      The type of the expression
+   */
+  template <typename E>
+  inline symmetric_matrix(expression<E> const &other) : symmetric_matrix(other.num_rows()) {
+    static_assert(dimensions_match(static_rows_v<E>, N), "Row count of expression differs");
+    static_assert(dimensions_match(static_cols_v<E>, N), "Column count of expression differs");
+    assert(other.num_rows() == other.num_cols());
+    if constexpr (evaluates_into<E>::value) {
+      evaluate_into<detail::store_assign>(*this, other);
+    } else {
+      assign(other.get_const_derived());
+    }
+  }
+
+  /**
+   * \brief      Assignment from another expression, which must be symmetric
+   *
+   * A symmetric product that does not read this matrix is written straight into it
+   *
+   * \param      other  The expression
+   *
+   * \tparam     E      The type of the expression
+   *
+   * \return     This matrix
+   */
+  template <typename E>
+  inline symmetric_matrix &operator=(expression<E> const &other) {
+    static_assert(dimensions_match(static_rows_v<E>, N), "Row count of expression differs");
+    static_assert(dimensions_match(static_cols_v<E>, N), "Column count of expression differs");
+    assert(other.num_rows() == num_rows());
+    assert(other.num_cols() == num_cols());
+    detail::evaluate_checked<detail::store_assign>(*this, storage_begin(), storage_end(), other);
+    return *this;
+  }
+
+  /**
+   * \brief      Assignments from expressions that do not read this matrix, see noalias_assignment
+   *
+   * \return     The assignment proxy
+   */
+  inline noalias_assignment<symmetric_matrix> noalias() {
+    return noalias_assignment<symmetric_matrix>(*this);
+  }
+
+  /**
+   * \brief      Function operator to return elements of this matrix
+   *
+   * \param[in]  i     Row number of the element to return
+   * \param[in]  j     Column number of the element to return
+   *
+   * \return     The desired element
+   */
+  inline T operator()(std::size_t i, std::size_t j) const {
+    assert(i < num_rows());
+    assert(j < num_cols());
+    return i <= j ? container[packed_index(i, j)] : container[packed_index(j, i)];
+  }
+
+  /**
+   * \brief      Set an element of this matrix, which also sets its mirror across the diagonal
+   *
+   * \param[in]  i      Row number of the element to set
+   * \param[in]  j      Column number of this element to set
+   * \param[in]  value  The new value of the element
+   */
+  inline void set_elt(std::size_t i, std::size_t j, T value) {
+    assert(i < num_rows());
+    assert(j < num_cols());
+    container[i <= j ? packed_index(i, j) : packed_index(j, i)] = value;
+  }
+
+  /**
+   * \brief      Get a reference to the packed storage container
+   *
+   * \return     The container
+   */
+  inline auto &get_container() {
+    return container;
+  }
+  inline auto const &get_container() const {
+    return container;
+  }
+
+  /**
+   * \brief      Get the range of the packed storage, for aliases()
+   *
+   * \return     Pointer to the first element or one past the last respectively
+   */
+  inline T const *storage_begin() const {
+    return container.data();
+  }
+  inline T const *storage_end() const {
+    return container.data() + container.size();
+  }
+
+  /**
+   * \brief      Gets number of rows in this matrix
+   *
+   * \return     Number of rows
+   */
+  inline std::size_t num_rows() const {
+    if constexpr (N != dynamic) {
+      return N;
+    } else {
+      return n;
+    }
+  }
+
+  /**
+   * \brief      Gets number of columns in this matrix
+   *
+   * \return     Number of columns
+   */
+  inline std::size_t num_cols() const {
+    return num_rows();
+  }
+
+  /**
+   * \brief      Evaluate this expression
+   *
+   * \return     Const reference to this matrix
+   */
+  inline const symmetric_matrix &eval() const {
+    return *this;
+  }
+
+  /**
+   * \brief      Assign a symmetric expression to this matrix, evaluating only its upper triangle
+   *
+   * \param      expr  The expression to assign
+   *
+   * \tparam     E     The type of the expression
+   */
+  template <typename E>
+  inline void assign(expression<E> const &expr) {
+    std::size_t index = 0;
+    for (std::size_t i = 0; i < num_rows(); ++i) {
+      for (std::size_t j = i; j < num_cols(); ++j) {
+        container[index++] = expr.get_const_derived()(i, j);
+      }
+    }
+  }
+
+  /**
+   * \brief      The stream operator to print the matrix easily
+   *
+   * \param      ostream  The output stream
+   * \param[in]  mat      The matrix
+   *
+   * \return     The output stream
+   */
+  friend std::ostream &operator<<(std::ostream &ostream, const symmetric_matrix &mat) {
+    for (std::size_t i = 0; i < mat.num_rows(); ++i) {
+      for (std::size_t j = 0; j < mat.num_cols(); ++j) {
+        ostream << mat(i, j) << ", ";
+      }
+      ostream << "\n";
+    }
+    return ostream;
+  }
+
+  /**
+   * \brief      Addition assignment operator with a symmetric expression
+   *
+   * \param      expr  The expression
+   *
+   * \tparam     E     The type of the expression
+   *
+   * \return     This matrix
+   */
+  template <typename E>
+  inline symmetric_matrix &operator+=(expression<E> const &expr) {
+    detail::evaluate_checked<detail::store_add>(*this, storage_begin(), storage_end(), expr);
+    return *this;
+  }
+
+  /**
+   * \brief      Subtraction assignment operator with a symmetric expression
+   *
+   * \param      expr  The expression
+   *
+   * \tparam     E     The type of the expression
+   *
+   * \return     This matrix
+   */
+  template <typename E>
+  inline symmetric_matrix &operator-=(expression<E> const &expr) {
+    detail::evaluate_checked<detail::store_subtract>(*this, storage_begin(), storage_end(), expr);
+    return *this;
+  }
+
+  /**
+   * \brief      Multiplication assignment operator with a scalar
+   *
+   * \param      scalar  The scalar
+   *
+   * \tparam     Scalar  The type of the scalar
+   *
+   * \return     This matrix
+   */
+  template <typename Scalar, typename = enable_if_not_expression<Scalar>>
+  inline symmetric_matrix &operator*=(Scalar const &scalar) {
+    for (auto &element : container) {
+      element *= scalar;
+    }
+    return *this;
+  }
+};
+
+/**
+ * \brief      Trait for whether a type is a symmetric_matrix, whose upper triangle the symmetric
+ * products can write directly
+ *
+ * \tparam     T     Type
+ */
+template <typename T>
+struct is_symmetric_matrix : std::false_type {};
+
+template <typename T, std::size_t N>
+struct is_symmetric_matrix<symmetric_matrix<T, N>> : std::true_type {};
+
+template <typename T, std::size_t N>
+inline bool aliases(symmetric_matrix<T, N> const &m, void const *first, void const *last) {
+  return detail::overlaps(m.storage_begin(), m.storage_end(), first, last);
+}
+
+/**
+ * \brief      Class to represent the congruence transform A * S * transpose(A), optionally plus C
+ *
+ * The result is symmetric whenever S (and C) are, so only its upper triangle is computed. Each row
+ * of A * S is formed once in a row buffer and dotted with the rows of A at or below it, which skips
+ * the strictly lower half of the second product entirely. This is the covariance propagation
+ * F * P * transpose(F) + Q and the innovation covariance H * P * transpose(H) + R of a Kalman
+ * filter.
+ *
+ * Like matrix_product, the result is evaluated into a temporary as a whole on first access
+ *
+ * \tparam     EA    Type of the transforming expression A
+ * \tparam     ES    Type of the symmetric expression S
+ * \tparam     EC    Type of the symmetric addend C, or no_addend
+ */
+template <typename EA, typename ES, typename EC = no_addend>
+class congruence_product : public expression<congruence_product<EA, ES, EC>> {
+public:
+  /**
+   * Type of an element in this expression
+   */
+  using ElementType = std::common_type_t<element_type_t<EA>, element_type_t<ES>>;
+
+  /**
+   * Compile time dimensions of this expression
+   */
+  static constexpr std::size_t StaticRows = static_rows_v<EA>;
+  static constexpr std::size_t StaticCols = static_rows_v<EA>;
+
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = symmetric_matrix<ElementType, StaticRows>;
+
+private:
+  /**
+   * Expression A
+   */
+  EA const &a;
+
+  /**
+   * Expression S
+   */
+  ES const &s;
+
+  /**
+   * Addend, null if EC is no_addend
+   */
+  EC const *addend;
+
+  /**
+   * Temporary to store the result, sized on evaluation
+   */
+  mutable EvalReturnType temp;
+
+  /**
+   * Whether temp holds the result yet
+   */
+  mutable bool evaluated = false;
+
+  /**
+   * \brief      Computes the upper triangle of the result into a symmetric destination, combined
+   * with it as Store says
+   *
+   * \param      out   The destination
+   */
+  template <typename Store, typename D>
+  inline void compute(D &out) const {
+    std::size_t const m = num_rows();
+    std::size_t const n = a.num_cols();
+    FASTMATRIX_COUNT(flops, 2 * m * n * n + m * (m + 1) * n);
+    FASTMATRIX_COUNT(bytes, (m * n + n * n + m * (m + 1) / 2) * sizeof(ElementType));
+
+    // One row of A * S, kept on the stack when its length is known at compile time
+    std::conditional_t<static_cols_v<EA> != dynamic, std::array<ElementType, static_cols_v<EA>>,
+                       std::vector<ElementType>>
+        row{};
+    if constexpr (static_cols_v<EA> == dynamic) {
+      row.resize(n);
+    }
+
+    // Both stages go through row_dot, so structural zeros of A are skipped when it has any
+    for (std::size_t i = 0; i < m; ++i) {
+      for (std::size_t k = 0; k < n; ++k) {
+        row[k] = row_dot(a, i, [&](std::size_t j) { return s(j, k); });
+      }
+      for (std::size_t l = i; l < m; ++l) {
+        ElementType sum = row_dot(a, l, [&](std::size_t k) { return row[k]; });
+        if constexpr (!std::is_same<EC, no_addend>::value) {
+          sum = sum + (*addend)(i, l);
+        }
+        Store::apply(out, i, l, sum);
+      }
+    }
+  }
+
+  /**
+   * \brief      Computes the upper triangle of the result into the temporary unless that has already
+   * been done
+   */
+  inline void evaluate() const {
+    if (evaluated) {
+      return;
+    }
+    if constexpr (StaticRows == dynamic) {
+      temp = EvalReturnType(num_rows());
+    }
+    FASTMATRIX_COUNT(temporaries, 1);
+    compute<detail::store_assign>(temp);
+    evaluated = true;
+  }
+
+public:
+  /**
+   * \brief      Constructor
+   *
+   * \param      a       Expression A
+   * \param      s       Expression S
+   * \param      addend  Pointer to the addend, null if EC is no_addend
+   */
+  inline congruence_product(EA const &a, ES const &s, EC const *addend)
+      : a(a), s(s), addend(addend) {}
+
+  /**
+   * \brief      Get the operands of this expression
+   *
+   * \return     Expression A or S respectively
+   */
+  inline EA const &transform() const {
+    return a;
+  }
+  inline ES const &symmetric() const {
+    return s;
+  }
+
+  /**
+   * \brief      Get the addend
+   *
+   * \return     Pointer to the addend, null if EC is no_addend
+   */
+  inline EC const *get_addend() const {
+    return addend;
+  }
+
+  /**
+   * \brief      Writes the result into a destination it does not alias, see evaluate_into. Only a
+   * symmetric destination gets it directly, as that is all that stores just the upper triangle
+   *
+   * \param      dst    The destination
+   *
+   * \tparam     Store  How to combine the result with the destination
+   * \tparam     D      Type of the destination
+   */
+  template <typename Store, typename D>
+  inline void store_into(D &dst) const {
+    assert(dst.num_rows() == num_rows());
+    assert(dst.num_cols() == num_cols());
+    if constexpr (is_symmetric_matrix<D>::value) {
+      if (!evaluated) {
+        compute<Store>(dst);
+        return;
+      }
+    }
+    Store::assign(dst, eval());
+  }
+
+  /**
+   * \brief      Function call operator to get an element of the result
+   *
+   * \param[in]  i     Row number of the element to get
+   * \param[in]  j     Column number of the element to get
+   *
+   * \return     The desired element
+   */
+  inline ElementType operator()(std::size_t i, std::size_t j) const {
+    evaluate();
+    return temp(i, j);
+  }
+
+  /**
+   * \brief      Evaluate and return the result of this expression
+   *
+   * \return     Reference to the temporary holding the result
+   */
+  inline EvalReturnType const &eval() const {
+    evaluate();
+    return temp;
+  }
+
+  /**
+   * \brief      Get number of rows of the result
+   *
+   * \return     Number of rows of A
+   */
+  inline std::size_t num_rows() const {
+    return a.num_rows();
+  }
+
+  /**
+   * \brief      Get number of columns of the result
+   *
+   * \return     Number of rows of A
+   */
+  inline std::size_t num_cols() const {
+    return a.num_rows();
+  }
+};
+
+/**
+ * \brief      Class to represent a matrix product that is known to be symmetric
+ *
+ * Products such as K * (H * P) in a Kalman covariance update are symmetric by construction but not
+ * in a way the library can detect. Wrapping them in this expression computes only the upper
+ * triangle, which is all a symmetric_matrix reads. The lower triangle of the operands' product is
+ * assumed to mirror the upper one
+ *
+ * \tparam     E1    Type of expression 1
+ * \tparam     E2    Type of expression 2
+ */
+template <typename E1, typename E2>
+class symmetric_product : public expression<symmetric_product<E1, E2>> {
+public:
+  /**
+   * Type of an element in this expression
+   */
+  using ElementType = std::common_type_t<element_type_t<E1>, element_type_t<E2>>;
+
+  /**
+   * Compile time dimensions of this expression
+   */
+  static constexpr std::size_t StaticRows = static_rows_v<E1>;
+  static constexpr std::size_t StaticCols = static_rows_v<E1>;
+
+  /**
+   * Return type of eval() method
+   */
+  using EvalReturnType = symmetric_matrix<ElementType, StaticRows>;
+
+private:
+  /**
+   * Expression 1
+   */
+  E1 const &expr1;
+
+  /**
+   * Expression 2
+   */
+  E2 const &expr2;
+
+  /**
+   * Temporary to store the result, sized on evaluation
+   */
+  mutable EvalReturnType temp;
+
+  /**
+   * Whether temp holds the result yet
+   */
+  mutable bool evaluated = false;
+
+  /**
+   * \brief      Computes the upper triangle of the product into a symmetric destination, combined
+   * with it as Store says
+   *
+   * \param      out   The destination
+   */
+  template <typename Store, typename D>
+  inline void compute(D &out) const {
+    FASTMATRIX_COUNT(flops, num_rows() * (num_rows() + 1) * expr1.num_cols());
+    FASTMATRIX_COUNT(bytes, (2 * num_rows() * expr1.num_cols() + num_rows() * (num_rows() + 1) / 2) *
+                                sizeof(ElementType));
+    for (std::size_t i = 0; i < num_rows(); ++i) {
+      for (std::size_t j = i; j < num_cols(); ++j) {
+        ElementType sum = expr1(i, 0) * expr2(0, j);
+        for (std::size_t k = 1; k < expr1.num_cols(); ++k) {
+          sum = expr1(i, k) * expr2(k, j) + sum;
+        }
+        Store::apply(out, i, j, sum);
+      }
+    }
+  }
+
+  /**
+   * \brief      Computes the upper triangle of the product into the temporary unless that has
+   * already been done
+   */
+  inline void evaluate() const {
+    if (evaluated) {
+      return;
+    }
+    if constexpr (StaticRows == dynamic) {
+      temp = EvalReturnType(num_rows());
+    }
+    FASTMATRIX_COUNT(temporaries, 1);
+    compute<detail::store_assign>(temp);
+    evaluated = true;
+  }
+
+public:
+  /**
+   * \brief      Constructor
+   *
+   * \param      expr1  Expression 1
+   * \param      expr2  Expression 2
+   */
+  inline symmetric_product(expression<E1> const &expr1, expression<E2> const &expr2)
+      : expr1(expr1.get_const_derived()), expr2(expr2.get_const_derived()) {}
+
+  /**
+   * \brief      Get the operands of this product
+   *
+   * \return     Expression 1 or 2 respectively
+   */
+  inline E1 const &lhs() const {
+    return expr1;
+  }
+  inline E2 const &rhs() const {
+    return expr2;
+  }
+
+  /**
+   * \brief      Writes the product into a destination it does not alias, see evaluate_into. Only a
+   * symmetric destination gets it directly, as that is all that stores just the upper triangle
+   *
+   * \param      dst    The destination
+   *
+   * \tparam     Store  How to combine the product with the destination
+   * \tparam     D      Type of the destination
+   */
+  template <typename Store, typename D>
+  inline void store_into(D &dst) const {
+    assert(dst.num_rows() == num_rows());
+    assert(dst.num_cols() == num_cols());
+    if constexpr (is_symmetric_matrix<D>::value) {
+      if (!evaluated) {
+        compute<Store>(dst);
+        return;
+      }
+    }
+    Store::assign(dst, eval());
+  }
+
+  /**
+   * \brief      Function call operator to get an element of the product
+   *
+   * \param[in]  i     Row number of the element to get
+   * \param[in]  j     Column number of the element to get
+   *
+   * \return     The desired element
+   */
+  inline ElementType operator()(std::size_t i, std::size_t j) const {
+    evaluate();
+    return temp(i, j);
+  }
+
+  /**
+   * \brief      Evaluate and return the result of this expression
+   *
+   * \return     Reference to the temporary holding the product
+   */
+  inline EvalReturnType const &eval() const {
+    evaluate();
+    return temp;
+  }
+
+  /**
+   * \brief      Get number of rows of this product
+   *
+   * \return     Number of rows
+   */
+  inline std::size_t num_rows() const {
+    return expr1.num_rows();
+  }
+
+  /**
+   * \brief      Get number of columns of this product
+   *
+   * \return     Number of columns
+   */
+  inline std::size_t num_cols() const {
+    return expr2.num_cols();
+  }
+};
+
+/**
+ * \brief      Makes the congruence transform a * s * transpose(a) of a symmetric expression
+ *
+ * \param      a     The transforming expression
+ * \param      s     The symmetric expression
+ *
+ * \tparam     EA    Type of the transforming expression
+ * \tparam     ES    Type of the symmetric expression
+ *
+ * \return     The congruence transform
+ */
+template <typename EA, typename ES>
+inline congruence_product<EA, ES> congruence(expression<EA> const &a, expression<ES> const &s) {
+  static_assert(dimensions_match(static_cols_v<EA>, static_rows_v<ES>),
+                "Inner dimensions of congruence transform differ");
+  static_assert(dimensions_match(static_rows_v<ES>, static_cols_v<ES>),
+                "Congruence transform requires a square middle operand");
+  assert(a.num_cols() == s.num_rows());
+  assert(s.num_rows() == s.num_cols());
+  return congruence_product<EA, ES>(a.get_const_derived(), s.get_const_derived(), nullptr);
+}
+
+/**
+ * \brief      Makes a product of two expressions that is known to be symmetric
+ *
+ * \param      expr1  Expression 1
+ * \param      expr2  Expression 2
+ *
+ * \tparam     E1     Type of expression 1
+ * \tparam     E2     Type of expression 2
+ *
+ * \return     The symmetric product
+ */
+template <typename E1, typename E2>
+inline symmetric_product<E1, E2> make_symmetric_product(expression<E1> const &expr1,
+                                                        expression<E2> const &expr2) {
+  static_assert(dimensions_match(static_cols_v<E1>, static_rows_v<E2>),
+                "Inner dimensions of matrix product differ");
+  static_assert(dimensions_match(static_rows_v<E1>, static_cols_v<E2>),
+                "Symmetric product must be square");
+  assert(expr1.num_cols() == expr2.num_rows());
+  assert(expr1.num_rows() == expr2.num_cols());
+  return symmetric_product<E1, E2>(expr1, expr2);
+}
+
+template <typename EA, typename ES, typename EC>
+inline bool aliases(congruence_product<EA, ES, EC> const &expr, void const *first,
+                    void const *last) {
+  bool result = aliases(expr.transform(), first, last) || aliases(expr.symmetric(), first, last);
+  if constexpr (!std::is_same<EC, no_addend>::value) {
+    result = result || aliases(*expr.get_addend(), first, last);
+  }
+  return result;
+}
+
+template <typename E1, typename E2>
+inline bool aliases(symmetric_product<E1, E2> const &expr, void const *first, void const *last) {
+  return aliases(expr.lhs(), first, last) || aliases(expr.rhs(), first, last);
+}
+
+template <typename EA, typename ES, typename EC>
+struct evaluates_into<congruence_product<EA, ES, EC>> : std::true_type {};
+
+template <typename E1, typename E2>
+struct evaluates_into<symmetric_product<E1, E2>> : std::true_type {};
+
+template <typename EA, typename ES, typename EC>
+inline auto operator+(congruence_product<EA, ES> const &product, expression<EC> const &addend) {
+  static_assert(dimensions_match(static_rows_v<EA>, static_rows_v<EC>), "Row counts differ");
+  static_assert(dimensions_match(static_rows_v<EA>, static_cols_v<EC>), "Column counts differ");
+  assert(product.num_rows() == addend.num_rows());
+  assert(product.num_cols() == addend.num_cols());
+  return congruence_product<EA, ES, EC>(product.transform(), product.symmetric(),
+                                        &addend.get_const_derived());
+}
+} // namespace fastmatrix
+
+namespace std {
+using namespace fastmatrix;
+
+/**
+ * \brief      Overloading common_type trait for two symmetric matrices, so that cwise operations
+ * between them evaluate to a symmetric matrix
+ *
+ * \tparam     T1    Type of elements of matrix 1
+ * \tparam     T2    Type of elements of matrix 2
+ * \tparam     N     Number of rows and columns
+ */
+template <typename T1, typename T2, std::size_t N>
+struct common_type<symmetric_matrix<T1, N>, symmetric_matrix<T2, N>> {
+  using type = symmetric_matrix<std::common_type_t<T1, T2>, N>;
+};
+
+/**
+ * \brief      Overloading common_type trait for a symmetric matrix and a scalar
+ *
+ * \tparam     T1    Type of elements of the matrix
+ * \tparam     N     Number of rows and columns
+ * \tparam     T2    Type of scalar
+ */
+template <typename T1, std::size_t N, typename T2>
+struct common_type<symmetric_matrix<T1, N>, T2> {
+  using type = symmetric_matrix<std::common_type_t<T1, T2>, N>;
+};
+
+/**
+ * \brief      Overloading common_type trait for a symmetric matrix and a dense one, which decays to
+ * the dense type
+ */
+template <typename T1, std::size_t N, typename T2, std::size_t R, std::size_t C>
+struct common_type<symmetric_matrix<T1, N>, fixed_matrix<T2, R, C>> {
+  using type = fixed_matrix<std::common_type_t<T1, T2>, R, C>;
+};
+
+template <typename T1, std::size_t R, std::size_t C, typename T2, std::size_t N>
+struct common_type<fixed_matrix<T1, R, C>, symmetric_matrix<T2, N>> {
+  using type = fixed_matrix<std::common_type_t<T1, T2>, R, C>;
+};
+
+template <typename T1, std::size_t N, typename T2, typename A2>
+struct common_type<symmetric_matrix<T1, N>, matrix<T2, A2>> {
+  using type = matrix<std::common_type_t<T1, T2>,
+                      typename std::allocator_traits<A2>::template rebind_alloc<
+                          std::common_type_t<T1, T2>>>;
+};
+
+template <typename T1, typename A1, typename T2, std::size_t N>
+struct common_type<matrix<T1, A1>, symmetric_matrix<T2, N>> {
+  using type = matrix<std::common_type_t<T1, T2>,
+                      typename std::allocator_traits<A1>::template rebind_alloc<
+                          std::common_type_t<T1, T2>>>;
+};
+} // namespace std
+
+#endif // FASTMATRIX_SYMMETRIC_HPP
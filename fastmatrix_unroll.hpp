@@ -0,0 +1,70 @@
+#ifndef FASTMATRIX_UNROLL_HPP
+#define FASTMATRIX_UNROLL_HPP
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Compile time unrolling of the element loops of small fixed size expressions.
+ *
+ * For shapes like 3x1, 4x4 or 7x7 the trip counts are known at compile time but the loop control,
+ * index arithmetic and the compiler's reluctance to fully unroll nested loops at -O2 cost as much
+ * as the arithmetic. static_for expands a loop body once per index, with the index as a constant
+ * expression, so the kernels built on it compile to the straight-line code one would write by hand
+ */
+namespace fastmatrix {
+namespace unroll {
+
+/**
+ * Largest number of rows, columns or inner product terms that is fully unrolled. Past that the code
+ * size outweighs the loop overhead and the loops are kept
+ */
+constexpr std::size_t limit = 8;
+
+/**
+ * \brief      Whether every given compile time dimension is known and at most limit
+ */
+template <typename... Dims>
+constexpr bool fits(Dims... dims) {
+  return ((dims != 0 && std::size_t(dims) <= limit) && ...);
+}
+
+/**
+ * The expansion must not be left as calls, or nothing is gained over the loop. This includes the
+ * loop bodies, which GCC otherwise outlines once per index: every lambda passed to static_for is
+ * declared [&](auto i) FASTMATRIX_INLINE_BODY { ... }
+ */
+#if defined(__GNUC__)
+#define FASTMATRIX_ALWAYS_INLINE inline __attribute__((always_inline))
+#define FASTMATRIX_INLINE_BODY __attribute__((always_inline))
+#else
+#define FASTMATRIX_ALWAYS_INLINE inline
+#define FASTMATRIX_INLINE_BODY
+#endif
+
+template <typename F, std::size_t... I>
+FASTMATRIX_ALWAYS_INLINE void expand(F &&f, std::index_sequence<I...>) {
+  (f(std::integral_constant<std::size_t, I>()), ...);
+}
+
+/**
+ * \brief      Calls f(std::integral_constant<std::size_t, I>()) for I = 0, ..., N - 1 in order
+ *
+ * The constant converts to std::size_t wherever an index is expected, and is usable in constant
+ * expressions inside the body
+ *
+ * \param      f     The loop body
+ *
+ * \tparam     N     Trip count
+ * \tparam     F     Type of the loop body
+ */
+template <std::size_t N, typename F>
+FASTMATRIX_ALWAYS_INLINE void static_for(F &&f) {
+  expand(f, std::make_index_sequence<N>());
+}
+
+} // namespace unroll
+} // namespace fastmatrix
+
+#endif // FASTMATRIX_UNROLL_HPP
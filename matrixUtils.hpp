@@ -1,62 +1,150 @@
+#ifndef MATRIX_UTILS_HPP
+#define MATRIX_UTILS_HPP
 #include "EKF.hpp"
+#include "quaternion.hpp"
 #include <iostream>
 #include <cmath>
+#include <type_traits>
 namespace matrix_utils {
-    inline matrix<float> rotateVector(const matrix<float>& q, const matrix<float>& v) {
-        float q0 = q(0, 0);
-        float q1 = q(1, 0);
-        float q2 = q(2, 0);
-        float q3 = q(3, 0);
+    // q is a 4x1 and v a 3x1 matrix, either dynamic or fixed size, of float or fixed point
+    template <typename Q, typename V>
+    inline fixed_matrix<typename Q::ElementType, 3, 1> rotateVector(const Q& q, const V& v) {
+        using T = typename Q::ElementType;
+        T q0 = q(0, 0);
+        T q1 = q(1, 0);
+        T q2 = q(2, 0);
+        T q3 = q(3, 0);
 
-        matrix<float> result(3, 1);
+        fixed_matrix<T, 3, 1> result;
+        const T two(2);
 
-        float t2 =   q0*q1;
-        float t3 =   q0*q2;
-        float t4 =   q0*q3;
-        float t5 =  -q1*q1;
-        float t6 =   q1*q2;
-        float t7 =   q1*q3;
-        float t8 =  -q2*q2;
-        float t9 =   q2*q3;
-        float t10 = -q3*q3;
+        T t2 =   q0*q1;
+        T t3 =   q0*q2;
+        T t4 =   q0*q3;
+        T t5 =  -q1*q1;
+        T t6 =   q1*q2;
+        T t7 =   q1*q3;
+        T t8 =  -q2*q2;
+        T t9 =   q2*q3;
+        T t10 = -q3*q3;
 
-        result.set_elt(0, 0, 2*( (t8 + t10)*v(0,0) + (t6 - t4)*v(1,0) + (t3 + t7)*v(2,0) ) + v(0,0));
-        result.set_elt(1, 0, 2*( (t4 + t6)*v(0,0) + (t5 + t10)*v(1,0) + (t9 - t2)*v(2,0) ) + v(1,0));
-        result.set_elt(2, 0, 2*( (t7 - t3)*v(0,0) + (t2 + t9)*v(1,0) + (t5 + t8)*v(2,0) ) + v(2,0));
+        result.set_elt(0, 0, two*( (t8 + t10)*v(0,0) + (t6 - t4)*v(1,0) + (t3 + t7)*v(2,0) ) + v(0,0));
+        result.set_elt(1, 0, two*( (t4 + t6)*v(0,0) + (t5 + t10)*v(1,0) + (t9 - t2)*v(2,0) ) + v(1,0));
+        result.set_elt(2, 0, two*( (t7 - t3)*v(0,0) + (t2 + t9)*v(1,0) + (t5 + t8)*v(2,0) ) + v(2,0));
 
         return result;
     } 
-    
-    inline matrix<float> transpose(const matrix<float>& m) {
-        matrix<float> result(m.num_cols(), m.num_rows());
-    
-        for (int i = 0; i < m.num_rows(); ++i) {
-            for (int j = 0; j < m.num_cols(); ++j) {
-                result.set_elt(j, i, m(i, j));
+
+    // cos(theta) and sin(theta)/theta from theta^2, by their series up to the theta^6 term. Needs no
+    // sqrt or trig, so fixed point types can use it, and is exact to float rounding for theta up to 0.5
+    template <typename T>
+    inline void halfAngleSeries(T theta2, T& c, T& sinc) {
+        c    = T(1) - theta2 * T(0.5f)      * (T(1) - theta2 * T(1.0f/12) * (T(1) - theta2 * T(1.0f/30)));
+        sinc = T(1) - theta2 * T(1.0f/6)    * (T(1) - theta2 * T(1.0f/20) * (T(1) - theta2 * T(1.0f/42)));
+    }
+
+    // theta^2 up to which halfAngleSeries is exact to float rounding
+    constexpr float kHalfAngleSeriesLimit = 0.25f;
+
+    // cos(theta) and sin(theta)/theta from theta^2 at any angle: the series within its limit, sqrt and
+    // trig beyond it for floating point types. Fixed point types always take the series, whose error
+    // grows as theta^8 past the limit
+    template <typename T>
+    inline void halfAngle(T theta2, T& c, T& sinc) {
+        if constexpr (std::is_floating_point<T>::value) {
+            if (theta2 > T(kHalfAngleSeriesLimit)) {
+                T theta = std::sqrt(theta2);
+                c = std::cos(theta);
+                sinc = std::sin(theta) / theta;
+                return;
             }
         }
-    
-        return result;
+        halfAngleSeries(theta2, c, sinc);
+    }
+
+    // exp(phi/2): the unit quaternion of the rotation by the rotation vector phi, exact to float
+    // rounding at any |phi| for float, and for |phi| up to 1 rad for fixed point
+    template <typename T>
+    inline fixed_matrix<T, 4, 1> rotationVectorToQuaternion(const fixed_matrix<T, 3, 1>& phi) {
+        const T h(0.5f);
+        T p0 = h*phi(0,0), p1 = h*phi(1,0), p2 = h*phi(2,0);
+        T c, sinc;
+        halfAngle(p0*p0 + p1*p1 + p2*p2, c, sinc);
+
+        fixed_matrix<T, 4, 1> q;
+        q.set_elt(0,0, c);
+        q.set_elt(1,0, sinc*p0);
+        q.set_elt(2,0, sinc*p1);
+        q.set_elt(3,0, sinc*p2);
+        return q;
+    }
+
+    // Rotation vector of a predict step from count gyro increments d[i] = rate_i * dt/count over equal
+    // sub-intervals, count from 1 to 4. The cross terms correct for coning, a rate changing direction
+    // within the step: the two sample 2/3 rule and Ignagni's three and four sample coefficients, which
+    // leave an O(dt^5) attitude error where the plain sum of increments leaves O(dt^3)
+    template <typename T>
+    inline fixed_matrix<T, 3, 1> coningRotationVector(const fixed_matrix<T, 3, 1>* d, int count) {
+        auto cross = [](const fixed_matrix<T, 3, 1>& a, const fixed_matrix<T, 3, 1>& b) {
+            fixed_matrix<T, 3, 1> c;
+            c.set_elt(0,0, a(1,0)*b(2,0) - a(2,0)*b(1,0));
+            c.set_elt(1,0, a(2,0)*b(0,0) - a(0,0)*b(2,0));
+            c.set_elt(2,0, a(0,0)*b(1,0) - a(1,0)*b(0,0));
+            return c;
+        };
+
+        fixed_matrix<T, 3, 1> phi = d[0];
+        for(int i=1;i<count;++i) phi += d[i];
+        if (count == 2) {
+            phi += cross(d[0], d[1]) * T(2.0f/3);
+        } else if (count == 3) {
+            phi += cross(d[0], d[2]) * T(33.0f/80);
+            phi += cross(d[1], d[2] - d[0]) * T(57.0f/80);
+        } else if (count == 4) {
+            phi += (cross(d[0], d[1]) + cross(d[2], d[3])) * T(736.0f/945);
+            phi += (cross(d[0], d[2]) + cross(d[1], d[3])) * T(334.0f/945);
+            phi += cross(d[0], d[3]) * T(526.0f/945);
+            phi += cross(d[1], d[2]) * T(654.0f/945);
+        }
+        return phi;
+    }
+
+    // float attitude math on the SIMD types of quaternion.hpp
+    inline vec3 rotateVector(const quat& q, const vec3& v) {
+        return rotate(q, v);
     }
     
-    inline matrix<float> inverse6x6(const matrix<float>& m) {
+    // A copy of the transpose of a dynamic matrix, as matrix_utils has always returned, so writing
+    // it back into m is safe. Other expressions get the zero-copy view of fastmatrix::transpose
+    template <typename T, typename Allocator>
+    inline matrix<T, Allocator> transpose(const matrix<T, Allocator>& m) {
+        return fastmatrix::transpose(m);
+    }
+    using fastmatrix::transpose;
+    
+    // M is matrix<T, Allocator> or fixed_matrix<T, 6, 6>, the result has the same type; an
+    // arena_matrix takes its scratch and result from the current arena
+    template <typename M>
+    inline M inverse6x6Impl(const M& m) {
+        using T = typename M::ElementType;
+        using std::abs;
         if (m.num_rows() != 6 || m.num_cols() != 6) {
         }
     
-        matrix<float> A(6, 6);  
-        matrix<float> I(6, 6);  
+        M A(6, 6);  
+        M I(6, 6);  
     
         for (int i = 0; i < 6; ++i) {
             for (int j = 0; j < 6; ++j) {
                 A.set_elt(i, j, m(i, j));
-                I.set_elt(i, j, (i == j) ? 1.0f : 0.0f);
+                I.set_elt(i, j, (i == j) ? T(1) : T(0));
             }
         }
     
         // Gauss-Jordan elimination
         for (int col = 0; col < 6; ++col) {
-            float pivot = A(col, col);
-            if (fabs(pivot) < 1e-6f) {
+            T pivot = A(col, col);
+            if (abs(pivot) < T(1e-6f)) {
                 std::cout<<"Matrix is singular and cannot be inverted."<<std::endl;
             }
     
@@ -67,7 +155,7 @@ namespace matrix_utils {
     
             for (int row = 0; row < 6; ++row) {
                 if (row != col) {
-                    float factor = A(row, col);
+                    T factor = A(row, col);
                     for (int j = 0; j < 6; ++j) {
                         A.set_elt(row, j, A(row, j) - factor * A(col, j));
                         I.set_elt(row, j, I(row, j) - factor * I(col, j));
@@ -78,12 +166,22 @@ namespace matrix_utils {
     
         return I;
     }
+
+    template <typename Allocator>
+    inline matrix<float, Allocator> inverse6x6(const matrix<float, Allocator>& m) {
+        return inverse6x6Impl(m);
+    }
+
+    inline fixed_matrix<float, 6, 6> inverse6x6(const fixed_matrix<float, 6, 6>& m) {
+        return inverse6x6Impl(m);
+    }
     
-    inline void quaternionToEuler(const matrix<float>& q, float& roll, float& pitch, float& yaw) {
-        float q0 = q(0,0);
-        float q1 = q(1,0);
-        float q2 = q(2,0);
-        float q3 = q(3,0);
+    template <typename Q>
+    inline void quaternionToEuler(const Q& q, float& roll, float& pitch, float& yaw) {
+        float q0 = float(q(0,0));
+        float q1 = float(q(1,0));
+        float q2 = float(q(2,0));
+        float q3 = float(q(3,0));
     
         // Roll (x-axis)
         float sinr_cosp = 2.0f * (q0 * q1 + q2 * q3);
@@ -102,18 +200,28 @@ namespace matrix_utils {
         float cosy_cosp = 1.0f - 2.0f * (q2*q2 + q3*q3);
         yaw = atan2(siny_cosp, cosy_cosp) * (180.0f / 3.14159265f);
     }
-    inline void normalizeQuaternion(matrix<float>& q) {
-        float norm = 0.0f;
+    inline void quaternionToEuler(const quat& q, float& roll, float& pitch, float& yaw) {
+        quaternionToEuler(q.matrix(), roll, pitch, yaw);
+    }
+    template <typename Q>
+    inline void normalizeQuaternion(Q& q) {
+        using T = typename Q::ElementType;
+        using std::sqrt;
+        T norm(0);
         for (int i = 0; i < 4; ++i) {
             norm += q(i, 0) * q(i, 0);
         }
         norm = sqrt(norm);
-        if (norm > 0.0f) {
+        if (norm > T(0)) {
             for (int i = 0; i < 4; ++i) {
                 q.set_elt(i, 0, q(i, 0) / norm);
             }
         }
     }
+    inline void normalizeQuaternion(quat& q) {
+        q = normalize(q);
+    }
     
     
 };
+#endif
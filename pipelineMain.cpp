@@ -0,0 +1,205 @@
+#include "LogReplay.hpp"
+#include "MEKF.hpp"
+#include "Pipeline.hpp"
+#include "matrixUtils.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Ground station load test: many sensor streams through pipelines of
+//   sensors -> filter -> attitude -> telemetry
+// each stage on a thread of its own, pinned to consecutive cores with --cpu. Streams replay the given
+// sensor logs (stream i plays log i modulo their number) interleaved record by record, and are split
+// across the pipelines; each pipeline keeps one filter per stream. Telemetry is the KF_test.ino
+// plotter line prefixed with the stream and time, written to --telemetry or dropped.
+//
+// Prints the per-stage service time, the wait in front of each stage and the end to end latency.
+//
+//   guidance_pipeline [--streams N] [--pipelines P] [--cpu FIRST] [--filter ekf|mekf] [--telemetry PATH] LOG...
+
+namespace {
+    using namespace sensor_log;
+
+    void usage(const char* program) {
+        std::fprintf(stderr,
+            "usage: %s [--streams N] [--pipelines P] [--cpu FIRST] [--filter ekf|mekf] [--telemetry PATH] LOG...\n"
+            "  --streams N      sensor streams, stream i replays LOG i modulo the logs (default 1)\n"
+            "  --pipelines P    pipelines the streams are split across, 4 threads each (default 1)\n"
+            "  --cpu FIRST      pin pipeline p's stages to cores FIRST + 4p and up, -1 for no pinning (default -1)\n"
+            "  --filter         ekf or mekf (default ekf)\n"
+            "  --telemetry PATH write the telemetry lines to PATH (default: encode and drop)\n", program);
+    }
+
+    constexpr int kStages = 4;
+
+    struct Options {
+        int streams = 1;
+        int pipelines = 1;
+        int cpu = -1;
+        const char* telemetry = nullptr;
+    };
+
+    // the streams s with s % pipelines == index
+    template <typename Filter>
+    void runPipeline(int index, const Options& options, const std::vector<std::unique_ptr<MappedLog>>& logs,
+                     std::FILE* telemetry, pipeline::Stats& stats) {
+        std::vector<int> streams;
+        for(int s=index; s<options.streams; s+=options.pipelines) streams.push_back(s);
+
+        std::vector<std::unique_ptr<Filter>> filters;
+        std::vector<std::unique_ptr<RecordFeeder<Filter>>> feeders;
+        for(int s : streams) {
+            float dt = logs[s % logs.size()]->header().nominalDt;
+            filters.emplace_back(new Filter(dt));
+            feeders.emplace_back(new RecordFeeder<Filter>(*filters.back(), dt));
+        }
+
+        pipeline::Pipeline p(options.cpu < 0 ? -1 : options.cpu + kStages * index);
+
+        // record by record across the streams, a stream whose log has ended is skipped
+        std::size_t record = 0, next = 0, exhausted = 0;
+        p.setSource("sensors", [&](pipeline::Sample& sample) {
+            while (exhausted < streams.size()) {
+                if (next == streams.size()) {
+                    next = 0;
+                    ++record;
+                    exhausted = 0;
+                }
+                std::size_t local = next++;
+                const MappedLog& log = *logs[streams[local] % logs.size()];
+                if (record >= log.size()) {
+                    ++exhausted;
+                    continue;
+                }
+                sample.stream = std::uint32_t(local);
+                sample.sensors = log.records<SensorRecord>()[record];
+                return true;
+            }
+            return false;
+        });
+
+        p.addStage("filter", [&](pipeline::Sample& sample) {
+            RecordFeeder<Filter>& feeder = *feeders[sample.stream];
+            bool ok = feeder.apply(sample.sensors);
+            sample.estimate = feeder.estimate(sample.sensors.timeUs, ok);
+            return true;
+        });
+
+        p.addStage("attitude", [&](pipeline::Sample& sample) {
+            Quaternion q;
+            for(int i=0;i<4;++i) q.set_elt(i,0, sample.estimate.q[i]);
+            matrix_utils::quaternionToEuler(q, sample.roll, sample.pitch, sample.yaw);
+            return true;
+        });
+
+        std::string buffer;
+        buffer.reserve(1 << 16);
+        p.addStage("telemetry", [&](pipeline::Sample& sample) {
+            char line[96];
+            int n = std::snprintf(line, sizeof(line), "%d\t%.6f\t%.4f\t%.4f\t%.4f\n", streams[sample.stream],
+                                  sample.sensors.timeUs * 1e-6, sample.roll, sample.pitch, sample.yaw);
+            buffer.append(line, std::size_t(n));
+            if (buffer.size() >= (1 << 16) - sizeof(line)) {
+                if (telemetry) std::fwrite(buffer.data(), 1, buffer.size(), telemetry);
+                buffer.clear();
+            }
+            return true;
+        });
+
+        p.run();
+        if (telemetry) std::fwrite(buffer.data(), 1, buffer.size(), telemetry);
+        stats = p.stats();
+    }
+
+    void printHistogram(const char* label, const pipeline::LatencyHistogram& h) {
+        std::fprintf(stderr, "    %-8s p50 %9.2f  p99 %9.2f  p99.9 %9.2f  max %9.2f us\n", label,
+                     h.percentile(0.5) * 1e-3, h.percentile(0.99) * 1e-3, h.percentile(0.999) * 1e-3,
+                     h.max() * 1e-3);
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    const char* filter = "ekf";
+    std::vector<const char*> paths;
+
+    for(int i=1; i<argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--streams") && hasValue) options.streams = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--pipelines") && hasValue) options.pipelines = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--cpu") && hasValue) options.cpu = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--filter") && hasValue) filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--telemetry") && hasValue) options.telemetry = argv[++i];
+        else if (argv[i][0] != '-') paths.push_back(argv[i]);
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    bool mekf = !std::strcmp(filter, "mekf");
+    if (paths.empty() || options.streams < 1 || options.pipelines < 1 || (!mekf && std::strcmp(filter, "ekf"))) {
+        usage(argv[0]);
+        return 2;
+    }
+    options.pipelines = std::min(options.pipelines, options.streams);
+
+    std::vector<std::unique_ptr<MappedLog>> logs;
+    for(const char* path : paths) {
+        logs.emplace_back(new MappedLog());
+        if (!logs.back()->open<SensorRecord>(path)) {
+            std::fprintf(stderr, "%s\n", logs.back()->error());
+            return 1;
+        }
+    }
+    std::FILE* telemetry = nullptr;
+    if (options.telemetry && !(telemetry = std::fopen(options.telemetry, "w"))) {
+        std::perror(options.telemetry);
+        return 1;
+    }
+
+    std::vector<pipeline::Stats> stats(options.pipelines);
+    std::vector<std::thread> runners;
+    for(int p=0; p<options.pipelines; ++p) {
+        runners.emplace_back([&, p]() {
+            if (mekf) runPipeline<MEKF>(p, options, logs, telemetry, stats[p]);
+            else runPipeline<EKF>(p, options, logs, telemetry, stats[p]);
+        });
+    }
+    for(auto& t : runners) t.join();
+    if (telemetry) std::fclose(telemetry);
+
+    // every pipeline has the same stages, merged stage by stage
+    pipeline::Stats total = stats[0];
+    for(int p=1; p<options.pipelines; ++p) {
+        for(std::size_t s=0; s<total.stages.size(); ++s) {
+            total.stages[s].processed += stats[p].stages[s].processed;
+            total.stages[s].dropped += stats[p].stages[s].dropped;
+            total.stages[s].fullWaits += stats[p].stages[s].fullWaits;
+            total.stages[s].pinned = total.stages[s].pinned && stats[p].stages[s].pinned;
+            total.stages[s].service.merge(stats[p].stages[s].service);
+            total.stages[s].wait.merge(stats[p].stages[s].wait);
+        }
+        total.endToEnd.merge(stats[p].endToEnd);
+        total.seconds = std::max(total.seconds, stats[p].seconds);
+    }
+
+    std::uint64_t samples = total.stages[0].processed;
+    std::fprintf(stderr, "%d streams on %d pipelines: %llu samples in %.3f s, %.0f samples/s\n",
+                 options.streams, options.pipelines, (unsigned long long)samples, total.seconds,
+                 samples / total.seconds);
+    for(std::size_t s=0; s<total.stages.size(); ++s) {
+        const auto& stage = total.stages[s];
+        std::fprintf(stderr, "  %-10s %llu samples, %llu dropped, %llu full waits%s\n", stage.name.c_str(),
+                     (unsigned long long)stage.processed, (unsigned long long)stage.dropped,
+                     (unsigned long long)stage.fullWaits, stage.pinned ? ", pinned" : "");
+        printHistogram("service", stage.service);
+        if (s > 0) printHistogram("wait", stage.wait);
+    }
+    std::fprintf(stderr, "  end to end\n");
+    printHistogram("latency", total.endToEnd);
+    return 0;
+}
@@ -0,0 +1,194 @@
+#ifndef QUATERNION_HPP
+#define QUATERNION_HPP
+#include "fastmatrix.hpp"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Value types for attitude math: quat and vec3 are four floats in one 16-byte aligned register,
+// passed and returned by value, with SSE or NEON kernels (plain float elsewhere). A vec3 is kept as
+// the pure quaternion (0, x, y, z), so rotating it is two Hamilton products and every kernel is
+// built from the same four-lane operations.
+//
+// They convert to and from the 4x1 and 3x1 fastmatrix types at the boundaries with from() and
+// matrix(), the math in between never touches a matrix.
+namespace matrix_utils {
+    namespace detail {
+#if defined(__SSE2__)
+        using lanes = __m128;
+        inline lanes load(const float* p) { return _mm_load_ps(p); }
+        inline void store(float* p, lanes a) { _mm_store_ps(p, a); }
+        inline lanes set(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+        inline lanes add(lanes a, lanes b) { return _mm_add_ps(a, b); }
+        inline lanes mul(lanes a, lanes b) { return _mm_mul_ps(a, b); }
+        template <int I> inline lanes splat(lanes a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(I, I, I, I)); }
+        inline lanes swapPairs(lanes a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)); }   // 1 0 3 2
+        inline lanes swapHalves(lanes a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)); }  // 2 3 0 1
+        inline lanes reverse(lanes a) { return _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 1, 2, 3)); }     // 3 2 1 0
+        // about 12 bits, refined by the caller
+        inline lanes rsqrtEstimate(lanes a) { return _mm_rsqrt_ps(a); }
+#elif defined(__ARM_NEON)
+        using lanes = float32x4_t;
+        inline lanes load(const float* p) { return vld1q_f32(p); }
+        inline void store(float* p, lanes a) { vst1q_f32(p, a); }
+        inline lanes set(float a, float b, float c, float d) {
+            const float v[4] = {a, b, c, d};
+            return vld1q_f32(v);
+        }
+        inline lanes add(lanes a, lanes b) { return vaddq_f32(a, b); }
+        inline lanes mul(lanes a, lanes b) { return vmulq_f32(a, b); }
+        template <int I> inline lanes splat(lanes a) { return vdupq_n_f32(vgetq_lane_f32(a, I)); }
+        inline lanes swapPairs(lanes a) { return vrev64q_f32(a); }
+        inline lanes swapHalves(lanes a) { return vextq_f32(a, a, 2); }
+        inline lanes reverse(lanes a) { return vrev64q_f32(vextq_f32(a, a, 2)); }
+        inline lanes rsqrtEstimate(lanes a) { return vrsqrteq_f32(a); }
+#else
+        struct lanes { float v[4]; };
+        inline lanes load(const float* p) { return {{p[0], p[1], p[2], p[3]}}; }
+        inline void store(float* p, lanes a) { for(int i=0;i<4;++i) p[i] = a.v[i]; }
+        inline lanes set(float a, float b, float c, float d) { return {{a, b, c, d}}; }
+        inline lanes add(lanes a, lanes b) { return {{a.v[0]+b.v[0], a.v[1]+b.v[1], a.v[2]+b.v[2], a.v[3]+b.v[3]}}; }
+        inline lanes mul(lanes a, lanes b) { return {{a.v[0]*b.v[0], a.v[1]*b.v[1], a.v[2]*b.v[2], a.v[3]*b.v[3]}}; }
+        template <int I> inline lanes splat(lanes a) { return {{a.v[I], a.v[I], a.v[I], a.v[I]}}; }
+        inline lanes swapPairs(lanes a) { return {{a.v[1], a.v[0], a.v[3], a.v[2]}}; }
+        inline lanes swapHalves(lanes a) { return {{a.v[2], a.v[3], a.v[0], a.v[1]}}; }
+        inline lanes reverse(lanes a) { return {{a.v[3], a.v[2], a.v[1], a.v[0]}}; }
+        inline lanes rsqrtEstimate(lanes a) {
+            lanes r;
+            for(int i=0;i<4;++i) r.v[i] = 1.0f / std::sqrt(a.v[i]);
+            return r;
+        }
+#endif
+
+        // Hamilton product a*b: each lane of a scales a permutation of b with the signs of the product
+        inline lanes hamilton(lanes a, lanes b) {
+            lanes r = mul(splat<0>(a), b);
+            r = add(r, mul(splat<1>(a), mul(swapPairs(b),  set(-1.0f,  1.0f, -1.0f,  1.0f))));
+            r = add(r, mul(splat<2>(a), mul(swapHalves(b), set(-1.0f,  1.0f,  1.0f, -1.0f))));
+            r = add(r, mul(splat<3>(a), mul(reverse(b),    set(-1.0f, -1.0f,  1.0f,  1.0f))));
+            return r;
+        }
+
+        // sum of the four lanes of a*b, in every lane
+        inline lanes dot(lanes a, lanes b) {
+            lanes m = mul(a, b);
+            m = add(m, swapPairs(m));
+            return add(m, swapHalves(m));
+        }
+    }
+
+    struct alignas(16) quat {
+        float v[4];  // w, x, y, z: the layout of Quaternion
+
+        quat(): v{1.0f, 0.0f, 0.0f, 0.0f} {}
+        quat(float w, float x, float y, float z): v{w, x, y, z} {}
+
+        float w() const { return v[0]; }
+        float x() const { return v[1]; }
+        float y() const { return v[2]; }
+        float z() const { return v[3]; }
+
+        // from a 4x1 expression such as Quaternion
+        template <typename E>
+        static quat from(const fastmatrix::expression<E>& e) {
+            const E& q = e.get_const_derived();
+            return quat(q(0,0), q(1,0), q(2,0), q(3,0));
+        }
+        fastmatrix::fixed_matrix<float, 4, 1> matrix() const {
+            fastmatrix::fixed_matrix<float, 4, 1> q;
+            for(int i=0;i<4;++i) q.set_elt(i,0, v[i]);
+            return q;
+        }
+
+        detail::lanes load() const { return detail::load(v); }
+        static quat store(detail::lanes a) {
+            quat q;
+            detail::store(q.v, a);
+            return q;
+        }
+    };
+
+    struct alignas(16) vec3 {
+        float v[4];  // 0, x, y, z
+
+        vec3(): v{0.0f, 0.0f, 0.0f, 0.0f} {}
+        vec3(float x, float y, float z): v{0.0f, x, y, z} {}
+
+        float x() const { return v[1]; }
+        float y() const { return v[2]; }
+        float z() const { return v[3]; }
+
+        // from a 3x1 expression such as Vector3
+        template <typename E>
+        static vec3 from(const fastmatrix::expression<E>& e) {
+            const E& a = e.get_const_derived();
+            return vec3(a(0,0), a(1,0), a(2,0));
+        }
+        fastmatrix::fixed_matrix<float, 3, 1> matrix() const {
+            fastmatrix::fixed_matrix<float, 3, 1> a;
+            for(int i=0;i<3;++i) a.set_elt(i,0, v[i+1]);
+            return a;
+        }
+
+        detail::lanes load() const { return detail::load(v); }
+        static vec3 store(detail::lanes a) {
+            vec3 r;
+            detail::store(r.v, a);
+            r.v[0] = 0.0f;  // exactly pure, whatever rounding left in the scalar lane
+            return r;
+        }
+    };
+
+    inline quat operator*(const quat& a, const quat& b) {
+        return quat::store(detail::hamilton(a.load(), b.load()));
+    }
+
+    inline vec3 operator*(const vec3& a, float s) {
+        return vec3::store(detail::mul(a.load(), detail::set(s, s, s, s)));
+    }
+
+    inline quat conjugate(const quat& q) {
+        return quat::store(detail::mul(q.load(), detail::set(1.0f, -1.0f, -1.0f, -1.0f)));
+    }
+
+    // q * (0, v) * conj(q), the same rotation as rotateVector
+    inline vec3 rotate(const quat& q, const vec3& v) {
+        detail::lanes a = q.load();
+        detail::lanes c = detail::mul(a, detail::set(1.0f, -1.0f, -1.0f, -1.0f));
+        return vec3::store(detail::hamilton(detail::hamilton(a, v.load()), c));
+    }
+
+    // q / |q| with the reciprocal square root estimate and one Newton step, about 1 ulp short of a
+    // division by sqrt; q must not be zero
+    inline quat normalize(const quat& q) {
+        detail::lanes a = q.load();
+        detail::lanes n = detail::dot(a, a);
+        detail::lanes r = detail::rsqrtEstimate(n);
+        // r * (1.5 - 0.5 * n * r * r)
+        detail::lanes nr2 = detail::mul(detail::mul(n, r), r);
+        r = detail::mul(r, detail::add(detail::set(1.5f, 1.5f, 1.5f, 1.5f),
+                                       detail::mul(nr2, detail::set(-0.5f, -0.5f, -0.5f, -0.5f))));
+        return quat::store(detail::mul(a, r));
+    }
+
+    // rotation by the vector k (axis * angle): [cos(|k|/2), sin(|k|/2) * k/|k|]
+    inline quat exp(const vec3& k) {
+        float angle = std::sqrt(k.x()*k.x() + k.y()*k.y() + k.z()*k.z());
+        float c = 1.0f, s = 0.5f;
+        if (angle > 1e-6f) {
+            c = std::cos(0.5f * angle);
+            s = std::sin(0.5f * angle) / angle;
+        }
+        return quat(c, s*k.x(), s*k.y(), s*k.z());
+    }
+
+    // q after turning at the body rate omega for dt, exact for a constant rate
+    inline quat integrate(const quat& q, const vec3& omega, float dt) {
+        return normalize(q * exp(omega * dt));
+    }
+}
+#endif
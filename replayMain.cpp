@@ -0,0 +1,287 @@
+#include "FilterThread.hpp"
+#include "LogReplay.hpp"
+#include "Simulation.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
+// Replays a binary sensor log (SensorLog.hpp) through a filter as fast as it runs, optionally writing
+// the estimated trajectory to a log of its own and scoring it against a truth trajectory.
+//
+// --record instead writes the readings of a simulation trial to LOG, and its truth to --truth, which
+// makes test logs of any length for the replay.
+//
+// --threaded runs the filter the way the flight computer does, on a FilterThread fed by an ingest
+// thread that pushes the records SPEEDUP times faster than they were recorded (0: as fast as it can),
+// and reports drops and latencies.
+//
+// --profile and --trace write what the instrumentation recorded during the replay as JSON and as a
+// Chrome trace, in builds made with make INSTRUMENT=1.
+//
+//   guidance_replay [--filter ekf|mekf] [--out TRAJ] [--truth TRUTH] [--threaded SPEEDUP]
+//                   [--profile JSON] [--trace JSON] LOG
+//   guidance_replay --record SCENARIO [--seed S] [--trial N] [--steps N] [--truth TRUTH] LOG
+
+namespace {
+    using namespace sensor_log;
+
+    void usage(const char* program) {
+        std::fprintf(stderr,
+            "usage: %s [--filter ekf|mekf] [--out TRAJ] [--truth TRUTH] [--threaded SPEEDUP]\n"
+            "          [--profile JSON] [--trace JSON] LOG\n"
+            "       %s --record SCENARIO [--seed S] [--trial N] [--steps N] [--truth TRUTH] LOG\n"
+            "  --filter       filter to replay through, ekf or mekf (default ekf)\n"
+            "  --out TRAJ     write the estimated attitude and bias of every record to TRAJ\n"
+            "  --truth TRUTH  replay: score the estimate against this trajectory log\n"
+            "                 record: write the true attitude and bias to it\n"
+            "  --threaded S   run the filter on its own thread, fed S times faster than real time\n"
+            "                 (0: as fast as the ingest goes), and report overruns and latency\n"
+            "  --profile JSON write the instrumentation counters and per call timings of the replay\n"
+            "  --trace JSON   write the instrumented calls of the replay as a Chrome trace\n"
+            "  --record       write the readings of a simulation scenario to LOG instead\n"
+            "  --seed S       base seed of the recorded trial (default 1)\n"
+            "  --trial N      trial to record (default 0)\n"
+            "  --steps N      steps to record, 0 for the scenario length (default 0)\n", program, program);
+    }
+
+    int record(const char* scenarioName, const char* path, const char* truthPath, std::uint64_t seed,
+               int trial, int steps) {
+        for(const auto& scenario : simulation::defaultScenarios()) {
+            if (scenario.name != scenarioName) continue;
+
+            LogWriter sensors, truth;
+            if (!sensors.open<SensorRecord>(path, scenario.dt)) {
+                std::fprintf(stderr, "%s\n", sensors.error());
+                return 1;
+            }
+            if (truthPath && !truth.open<TrajectoryRecord>(truthPath, scenario.dt)) {
+                std::fprintf(stderr, "%s\n", truth.error());
+                return 1;
+            }
+            int written = simulation::recordTrial(scenario, trial, seed, sensors, truthPath ? &truth : nullptr,
+                                                  steps);
+            if (!sensors.close() || !truth.close()) {
+                std::fprintf(stderr, "%s: %s\n", path, sensors.error()[0] ? sensors.error() : truth.error());
+                return 1;
+            }
+            std::fprintf(stderr, "%s: %d records, %.1f s of %s\n", path, written, written * scenario.dt,
+                         scenarioName);
+            return 0;
+        }
+        std::fprintf(stderr, "unknown scenario '%s', see guidance_system --list\n", scenarioName);
+        return 2;
+    }
+
+    // RMS and final attitude error against the truth, and the final bias error
+    void score(const MappedLog& estimate, const MappedLog& truth) {
+        if (estimate.size() != truth.size()) {
+            std::fprintf(stderr, "truth has %zu records for %zu estimates, not scored\n", truth.size(),
+                         estimate.size());
+            return;
+        }
+        auto quaternion = [](const TrajectoryRecord& r) {
+            Quaternion q;
+            for(int i=0;i<4;++i) q.set_elt(i,0, r.q[i]);
+            return q;
+        };
+        const TrajectoryRecord* a = estimate.records<TrajectoryRecord>();
+        const TrajectoryRecord* b = truth.records<TrajectoryRecord>();
+        double squared = 0.0;
+        float error = 0.0f;
+        for(std::size_t i=0; i<estimate.size(); ++i) {
+            error = simulation::attitudeError(quaternion(b[i]), quaternion(a[i]));
+            squared += double(error) * error;
+        }
+        float bias = 0.0f;
+        if (estimate.size()) {
+            const TrajectoryRecord& last = a[estimate.size()-1];
+            const TrajectoryRecord& truthLast = b[truth.size()-1];
+            for(int i=0;i<3;++i) bias += (last.bias[i] - truthLast.bias[i]) * (last.bias[i] - truthLast.bias[i]);
+        }
+        std::fprintf(stderr, "attitude deg rms %.4f final %.4f  final bias dps %.4f\n",
+                     estimate.size() ? std::sqrt(squared / estimate.size()) : 0.0, error,
+                     std::sqrt(bias) * 180.0f / 3.14159265f);
+    }
+
+    // what the instrumentation recorded, in builds that have it
+    int writeProfile(const char* profilePath, const char* tracePath) {
+        namespace instrumentation = fastmatrix::instrumentation;
+        if (!profilePath && !tracePath) return 0;
+        if (!instrumentation::enabled) {
+            std::fprintf(stderr, "built without instrumentation, rebuild with make clean && make INSTRUMENT=1\n");
+            return 1;
+        }
+        if (profilePath) {
+            std::ofstream out(profilePath);
+            instrumentation::write_json(out, instrumentation::take_snapshot());
+            if (!out) {
+                std::fprintf(stderr, "%s: write failed\n", profilePath);
+                return 1;
+            }
+        }
+        if (tracePath) {
+            std::ofstream out(tracePath);
+            instrumentation::write_chrome_trace(out);
+            if (!out) {
+                std::fprintf(stderr, "%s: write failed\n", tracePath);
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // the ingest runs on the calling thread, the final estimate is scored against the last truth record
+    template <typename Filter>
+    int replayThreaded(const char* path, const char* truthPath, double speedup) {
+        MappedLog log, truth;
+        if (!log.open<SensorRecord>(path) || (truthPath && !truth.open<TrajectoryRecord>(truthPath))) {
+            std::fprintf(stderr, "%s\n", log.error()[0] ? log.error() : truth.error());
+            return 1;
+        }
+
+        Filter filter(log.header().nominalDt);
+        FilterThread<Filter> thread(filter, log.header().nominalDt);
+        const SensorRecord* records = log.records<SensorRecord>();
+        auto start = std::chrono::steady_clock::now();
+        thread.start();
+        for(std::size_t i=0; i<log.size(); ++i) {
+            if (speedup > 0.0) {
+                double due = double(records[i].timeUs - records[0].timeUs) * 1e-6 / speedup;
+                std::this_thread::sleep_until(start + std::chrono::duration<double>(due));
+            }
+            thread.push(records[i]);
+        }
+        thread.stop();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto s = thread.stats();
+        std::fprintf(stderr,
+            "%s: %zu records in %.3f s, %llu pushed, %llu overruns, %llu applied in %llu batches (largest %llu)\n"
+            "  latency max %.3f ms, %llu records over %.3f ms, %llu rejected updates\n",
+            path, log.size(), seconds, (unsigned long long)s.pushed, (unsigned long long)s.overruns,
+            (unsigned long long)s.applied, (unsigned long long)s.batches, (unsigned long long)s.largestBatch,
+            s.maxLatencyNs * 1e-6, (unsigned long long)s.lateRecords,
+            std::chrono::duration<double, std::milli>(typename FilterThread<Filter>::Config().latencyBound).count(),
+            (unsigned long long)s.rejectedUpdates);
+
+        if (truthPath && truth.size()) {
+            auto quaternion = [](const TrajectoryRecord& r) {
+                Quaternion q;
+                for(int i=0;i<4;++i) q.set_elt(i,0, r.q[i]);
+                return q;
+            };
+            TrajectoryRecord estimate = thread.estimate();
+            const TrajectoryRecord& last = truth.records<TrajectoryRecord>()[truth.size()-1];
+            std::fprintf(stderr, "final attitude deg %.4f\n",
+                         simulation::attitudeError(quaternion(last), quaternion(estimate)));
+        }
+        return 0;
+    }
+
+    template <typename Filter>
+    int replay(const char* path, const char* outPath, const char* truthPath) {
+        MappedLog log;
+        if (!log.open<SensorRecord>(path)) {
+            std::fprintf(stderr, "%s\n", log.error());
+            return 1;
+        }
+        // scoring reads the estimate back, so it needs one on disk
+        char scratch[] = "/tmp/guidance_replay_XXXXXX";
+        bool temporary = truthPath && !outPath;
+        if (temporary) {
+            int fd = mkstemp(scratch);
+            if (fd < 0) {
+                std::perror("mkstemp");
+                return 1;
+            }
+            close(fd);
+            outPath = scratch;
+        }
+        LogWriter trajectory;
+        if (outPath && !trajectory.open<TrajectoryRecord>(outPath, log.header().nominalDt)) {
+            std::fprintf(stderr, "%s\n", trajectory.error());
+            return 1;
+        }
+
+        Filter filter(log.header().nominalDt);
+        auto start = std::chrono::steady_clock::now();
+        ReplayStats stats = replayLog(log, filter, outPath ? &trajectory : nullptr);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (!trajectory.close()) {
+            std::fprintf(stderr, "%s: %s\n", outPath, trajectory.error());
+            return 1;
+        }
+
+        std::fprintf(stderr,
+            "%s: %zu records, %.1f s of log in %.3f s (%.0f records/s, %.0fx real time)\n"
+            "  %zu predicts, %zu updates, %zu rejected\n",
+            path, stats.records, stats.logSeconds, seconds, stats.records / seconds, stats.logSeconds / seconds,
+            stats.predicts, stats.updates, stats.rejectedUpdates);
+
+        int status = 0;
+        if (truthPath) {
+            MappedLog estimate, truth;
+            if (!estimate.open<TrajectoryRecord>(outPath) || !truth.open<TrajectoryRecord>(truthPath)) {
+                std::fprintf(stderr, "%s\n", estimate.error()[0] ? estimate.error() : truth.error());
+                status = 1;
+            } else {
+                score(estimate, truth);
+            }
+        }
+        if (temporary) std::remove(scratch);
+        return status;
+    }
+}
+
+int main(int argc, char** argv) {
+    const char* filter = "ekf";
+    const char* outPath = nullptr;
+    const char* truthPath = nullptr;
+    const char* scenario = nullptr;
+    const char* path = nullptr;
+    std::uint64_t seed = 1;
+    int trial = 0, steps = 0;
+    double speedup = -1.0;  // not threaded
+    const char* profilePath = nullptr;
+    const char* tracePath = nullptr;
+
+    for(int i=1; i<argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--filter") && hasValue) filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--out") && hasValue) outPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--truth") && hasValue) truthPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--record") && hasValue) scenario = argv[++i];
+        else if (!std::strcmp(argv[i], "--seed") && hasValue) seed = std::strtoull(argv[++i], nullptr, 0);
+        else if (!std::strcmp(argv[i], "--trial") && hasValue) trial = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--steps") && hasValue) steps = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threaded") && hasValue) speedup = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--profile") && hasValue) profilePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--trace") && hasValue) tracePath = argv[++i];
+        else if (argv[i][0] != '-' && !path) path = argv[i];
+        else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (scenario) return record(scenario, path, truthPath, seed, trial, steps);
+    bool mekf = !std::strcmp(filter, "mekf");
+    if (!mekf && std::strcmp(filter, "ekf")) {
+        usage(argv[0]);
+        return 2;
+    }
+    int status;
+    if (speedup >= 0.0) status = mekf ? replayThreaded<MEKF>(path, truthPath, speedup)
+                                      : replayThreaded<EKF>(path, truthPath, speedup);
+    else status = mekf ? replay<MEKF>(path, outPath, truthPath) : replay<EKF>(path, outPath, truthPath);
+    if (status) return status;
+    return writeProfile(profilePath, tracePath);
+}
@@ -0,0 +1,157 @@
+#include "Simulation.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Runs seeded Monte Carlo trials of the simulation scenarios.
+// Per-trial results go to stdout as CSV, a per-scenario summary goes to stderr.
+//
+// --compare-fixed instead runs the float EKF and the Q4.27 one side by side on the same readings.
+//
+//   guidance_system [--trials N] [--threads N] [--seed S] [--scenario NAME|all] [--filter ekf|mekf|fixed]
+//                   [--gyro-samples N] [--compare-fixed] [--list]
+
+namespace {
+    void usage(const char* program) {
+        std::fprintf(stderr,
+            "usage: %s [--trials N] [--threads N] [--seed S] [--scenario NAME|all] [--filter ekf|mekf|fixed]\n"
+            "          [--gyro-samples N] [--compare-fixed] [--list]\n"
+            "  --trials N     trials per scenario (default 100)\n"
+            "  --threads N    worker threads, 0 for all cores (default 0)\n"
+            "  --seed S       base seed, trial i of a run is reproducible from (S, i) (default 1)\n"
+            "  --scenario     scenario to run (default all)\n"
+            "  --filter       filter under test, ekf, mekf or fixed (EKF on Q4.27) (default ekf)\n"
+            "  --gyro-samples N  gyro samples per predict, 1 to 4: the filter runs at 1/N of the\n"
+            "                 sensor rate with coning compensation (default 1)\n"
+            "  --compare-fixed  compare the float and fixed point EKFs instead\n"
+            "  --list         print the scenario names and exit\n", program);
+    }
+
+    float percentile(std::vector<float> values, float p) {
+        if (values.empty()) return 0.0f;
+        std::sort(values.begin(), values.end());
+        std::size_t i = std::size_t(p * (values.size() - 1) + 0.5f);
+        return values[i];
+    }
+
+    int compareFixedPoint(const std::vector<simulation::Scenario>& scenarios, const char* only,
+                          int trials, unsigned long long seed, unsigned threads) {
+        bool any = false;
+        std::printf("scenario,trial,steps,rms_difference_deg,max_difference_deg,final_bias_difference_dps,"
+                    "float_rms_deg,fixed_rms_deg,failed_updates\n");
+        for(const auto& scenario : scenarios) {
+            if (std::strcmp(only, "all") && scenario.name != only) continue;
+            any = true;
+
+            auto results = simulation::compareFixedPoint(scenario, trials, seed, threads);
+
+            std::vector<float> rms, max, floatRms, fixedRms;
+            for(const auto& r : results) {
+                std::printf("%s,%d,%d,%.5f,%.5f,%.5f,%.5f,%.5f,%d\n", scenario.name.c_str(), r.trial, r.steps,
+                            r.rmsDifference, r.maxDifference, r.finalBiasDifference, r.floatRmsError,
+                            r.fixedRmsError, r.failedUpdates);
+                rms.push_back(r.rmsDifference);
+                max.push_back(r.maxDifference);
+                floatRms.push_back(r.floatRmsError);
+                fixedRms.push_back(r.fixedRmsError);
+            }
+
+            std::fprintf(stderr,
+                "%-12s %5d trials  float vs fixed deg rms p50 %.5f p95 %.5f  max %.5f  "
+                "rms attitude deg p50 float %.4f fixed %.4f\n",
+                scenario.name.c_str(), int(results.size()), percentile(rms, 0.5f), percentile(rms, 0.95f),
+                percentile(max, 1.0f), percentile(floatRms, 0.5f), percentile(fixedRms, 0.5f));
+        }
+
+        if (!any) {
+            std::fprintf(stderr, "unknown scenario '%s', see --list\n", only);
+            return 2;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    int trials = 100;
+    unsigned threads = 0;
+    unsigned long long seed = 1;
+    const char* only = "all";
+    simulation::Filter filter = simulation::Filter::EKF;
+    int gyroSamples = 1;
+    bool compareFixed = false;
+
+    std::vector<simulation::Scenario> scenarios = simulation::defaultScenarios();
+
+    for(int i=1; i<argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(argv[i], "--trials") && hasValue) trials = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && hasValue) threads = unsigned(std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--seed") && hasValue) seed = std::strtoull(argv[++i], nullptr, 0);
+        else if (!std::strcmp(argv[i], "--scenario") && hasValue) only = argv[++i];
+        else if (!std::strcmp(argv[i], "--filter") && hasValue) {
+            const char* name = argv[++i];
+            if (!std::strcmp(name, "ekf")) filter = simulation::Filter::EKF;
+            else if (!std::strcmp(name, "mekf")) filter = simulation::Filter::MEKF;
+            else if (!std::strcmp(name, "fixed")) filter = simulation::Filter::FixedEKF;
+            else {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--gyro-samples") && hasValue) {
+            gyroSamples = std::atoi(argv[++i]);
+            if (gyroSamples < 1 || gyroSamples > EKF::kMaxGyroSamples) {
+                usage(argv[0]);
+                return 2;
+            }
+        }
+        else if (!std::strcmp(argv[i], "--compare-fixed")) compareFixed = true;
+        else if (!std::strcmp(argv[i], "--list")) {
+            for(const auto& s : scenarios) std::printf("%s\n", s.name.c_str());
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (compareFixed) return compareFixedPoint(scenarios, only, trials, seed, threads);
+
+    bool any = false;
+    std::printf("scenario,trial,steps,rms_attitude_deg,final_attitude_deg,final_bias_dps,"
+                "bias_settle_s,failed_updates,ns_per_step\n");
+    for(const auto& scenario : scenarios) {
+        if (std::strcmp(only, "all") && scenario.name != only) continue;
+        any = true;
+
+        auto results = simulation::runMonteCarlo(scenario, trials, seed, threads, filter, gyroSamples);
+
+        std::vector<float> rms, bias;
+        int settled = 0;
+        double ns = 0.0;
+        for(const auto& r : results) {
+            std::printf("%s,%d,%d,%.5f,%.5f,%.5f,%.3f,%d,%.1f\n", scenario.name.c_str(), r.trial, r.steps,
+                        r.rmsAttitudeError, r.finalAttitudeError, r.finalBiasError, r.biasSettleTime,
+                        r.failedUpdates, r.nsPerStep);
+            rms.push_back(r.rmsAttitudeError);
+            bias.push_back(r.finalBiasError);
+            if (r.biasSettleTime >= 0.0f) ++settled;
+            ns += r.nsPerStep;
+        }
+        if (!results.empty()) ns /= results.size();
+
+        std::fprintf(stderr,
+            "%-12s %5d trials  rms attitude deg p50 %.4f p95 %.4f max %.4f  "
+            "final bias dps p50 %.4f p95 %.4f  bias settled %d/%d  %.0f ns/step\n",
+            scenario.name.c_str(), int(results.size()),
+            percentile(rms, 0.5f), percentile(rms, 0.95f), percentile(rms, 1.0f),
+            percentile(bias, 0.5f), percentile(bias, 0.95f), settled, int(results.size()), ns);
+    }
+
+    if (!any) {
+        std::fprintf(stderr, "unknown scenario '%s', see --list\n", only);
+        return 2;
+    }
+    return 0;
+}
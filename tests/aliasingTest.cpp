@@ -0,0 +1,135 @@
+#include "../fastmatrix.hpp"
+#include "reference.hpp"
+#include "check.hpp"
+
+// An assignment whose expression reads its destination must give the result of evaluating the
+// expression first, whichever path the library takes: products into a temporary, operator*= in
+// place below gemm::blocked_threshold, other expressions through a temporary when aliases() sees
+// the overlap
+using namespace fastmatrix;
+
+namespace {
+    const double kTolerance = 1e-5;
+
+    // a = a*b, a = b*a, a *= b and a *= a on n x n dynamic matrices
+    bool squareProducts(std::size_t n) {
+        bool ok = true;
+        matrix<float> a(n, n), b(n, n);
+        reference::fill(a, 1);
+        reference::fill(b, 2);
+        reference::Matrix ra = reference::copy(a), rb = reference::copy(b);
+
+        matrix<float> c(n, n);
+        reference::load(c, ra);
+        c = c * b;
+        ok = ok && reference::matches(c, reference::product(ra, rb), kTolerance);
+        reference::load(c, ra);
+        c = b * c;
+        ok = ok && reference::matches(c, reference::product(rb, ra), kTolerance);
+        reference::load(c, ra);
+        c *= b;
+        ok = ok && reference::matches(c, reference::product(ra, rb), kTolerance);
+        reference::load(c, ra);
+        c *= c;
+        ok = ok && reference::matches(c, reference::product(ra, ra), kTolerance);
+        return ok;
+    }
+}
+
+TEST_CASE(aliasedProductsSmall) {
+    CHECK(squareProducts(5));  // operator*= in place
+}
+
+TEST_CASE(aliasedProductsLarge) {
+    CHECK(squareProducts(40));  // 40^3 multiply-adds, past gemm::blocked_threshold
+}
+
+TEST_CASE(aliasedRectangularProduct) {
+    matrix<float> a(6, 4), b(4, 4);
+    reference::fill(a, 3);
+    reference::fill(b, 4);
+    reference::Matrix expected = reference::product(reference::copy(a), reference::copy(b));
+    a *= b;
+    CHECK(reference::matches(a, expected, kTolerance));
+}
+
+TEST_CASE(aliasedTranspose) {
+    matrix<float> sq(7, 7);
+    reference::fill(sq, 5);
+    reference::Matrix expected = reference::transpose(reference::copy(sq));
+    sq = transpose(sq);
+    CHECK(reference::matches(sq, expected, 0));
+
+    matrix<float> c(5, 5);
+    reference::fill(c, 6);
+    reference::Matrix rc = reference::copy(c);
+    c = c + transpose(c);
+    CHECK(reference::matches(c, reference::add(rc, reference::transpose(rc)), kTolerance));
+}
+
+TEST_CASE(aliasedFixedProducts) {
+    fixed_matrix<float, 6, 6> a, b;
+    reference::fill(a, 7);
+    reference::fill(b, 8);
+    reference::Matrix expected = reference::product(reference::copy(a), reference::copy(b));
+    fixed_matrix<float, 6, 6> c;
+    reference::load(c, reference::copy(a));
+    c = c * b;
+    CHECK(reference::matches(c, expected, kTolerance));
+    c = a;
+    c *= b;
+    CHECK(reference::matches(c, expected, kTolerance));
+}
+
+TEST_CASE(aliasedTripleProduct) {
+    matrix<float> a(7, 7), b(7, 7), c(7, 7);
+    reference::fill(a, 9);
+    reference::fill(b, 10);
+    reference::fill(c, 11);
+    reference::Matrix ra = reference::copy(a), rb = reference::copy(b), rc = reference::copy(c);
+
+    a = a * b * c + a;
+    CHECK(reference::matches(a, reference::add(reference::product(reference::product(ra, rb), rc), ra),
+                             kTolerance));
+
+    reference::load(a, ra);
+    a -= b * a;
+    CHECK(reference::matches(a, reference::add(ra, reference::product(rb, ra), -1), kTolerance));
+}
+
+TEST_CASE(overlappingSegments) {
+    fixed_matrix<float, 8, 1> v;
+    reference::fill(v, 12);
+    reference::Matrix rv = reference::copy(v);
+    v.segment<0, 5>() = v.segment<2, 5>();  // reads ahead of what it writes
+    bool ok = true;
+    for(std::size_t i=0; i<5; ++i) ok = ok && v(i, 0) == float(rv(i + 2, 0));
+    CHECK(ok);
+
+    reference::fill(v, 13);
+    rv = reference::copy(v);
+    v.segment<3, 5>() = v.segment<1, 5>();  // reads behind what it writes
+    ok = true;
+    for(std::size_t i=0; i<5; ++i) ok = ok && v(i + 3, 0) == float(rv(i + 1, 0));
+    CHECK(ok);
+}
+
+TEST_CASE(overlappingBlocks) {
+    matrix<float> m(6, 6);
+    reference::fill(m, 14);
+    reference::Matrix rm = reference::copy(m);
+    m.block<4, 4>(0, 0) = m.block<4, 4>(1, 1);
+    bool ok = true;
+    for(std::size_t i=0; i<4; ++i)
+      for(std::size_t j=0; j<4; ++j) ok = ok && m(i, j) == float(rm(i + 1, j + 1));
+    CHECK(ok);
+
+    reference::fill(m, 15);
+    rm = reference::copy(m);
+    m.block(2, 1, 4, 5) += m.block(0, 0, 4, 5);
+    ok = true;
+    for(std::size_t i=0; i<4; ++i)
+      for(std::size_t j=0; j<5; ++j)
+        ok = ok && std::fabs(m(i + 2, j + 1) - float(rm(i + 2, j + 1) + rm(i, j))) < 1e-6f;
+    CHECK(ok);
+}
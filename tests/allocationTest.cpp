@@ -0,0 +1,86 @@
+#include "../EKF.hpp"
+#include "../MEKF.hpp"
+#include "../allocationHook.hpp"
+#include "check.hpp"
+#include <cmath>
+#include <cstdint>
+
+// Every filter step runs on preallocated workspace: once the filter is constructed, no predict or
+// update of any kind reaches the allocator. The filters are built with -DEKF_CHECK_ALLOCATIONS, so
+// a step that does allocate also trips the assertion inside it.
+namespace {
+    template <typename V>
+    V reading(float x, float y, float z) {
+        V v;
+        v.set_elt(0,0, typename V::ElementType(x));
+        v.set_elt(1,0, typename V::ElementType(y));
+        v.set_elt(2,0, typename V::ElementType(z));
+        return v;
+    }
+
+    // Allocations made by a number of steps of every kind, after one warm-up step of each
+    template <typename Filter, typename V>
+    std::size_t stepAllocations(Filter& filter) {
+        std::size_t allocations = 0;
+        for (int step = 0; step < 21; ++step) {
+            float t = 0.01f * step;
+            V gyro = reading<V>(0.2f * std::sin(t), 0.1f, -0.05f);
+            V gyros[Filter::kMaxGyroSamples] = {gyro, gyro, gyro, gyro};
+            V accel = reading<V>(0.01f * std::cos(t), -0.02f, -1.0f);
+            V mag = reading<V>(0.99f, 0.03f * std::sin(t), 0.01f);
+
+            allocation_hook::Scope scope;
+            filter.predict(gyro);
+            filter.predict(gyro, 0.02f);
+            filter.predict(gyros, Filter::kMaxGyroSamples, 0.02f);
+            filter.update(accel, mag);
+            filter.updateAccel(accel);
+            filter.updateMag(mag);
+            if (step > 0) allocations += scope.allocations();
+        }
+        return allocations;
+    }
+}
+
+TEST_CASE(ekfStepsDoNotAllocate) {
+    EKF ekf(0.01f);
+    CHECK((stepAllocations<EKF, EKF::Vector3>(ekf)) == 0);
+}
+
+TEST_CASE(ekfBatchUpdateDoesNotAllocate) {
+    EKF ekf(0.01f);
+    ekf.setUpdateMode(EKF::UpdateMode::Batch);
+    CHECK((stepAllocations<EKF, EKF::Vector3>(ekf)) == 0);
+}
+
+TEST_CASE(fixedEkfStepsDoNotAllocate) {
+    FixedEKF ekf(0.01f);
+    CHECK((stepAllocations<FixedEKF, FixedEKF::Vector3>(ekf)) == 0);
+}
+
+TEST_CASE(fixedEkfBatchUpdateDoesNotAllocate) {
+    FixedEKF ekf(0.01f);
+    ekf.setUpdateMode(FixedEKF::UpdateMode::Batch);
+    CHECK((stepAllocations<FixedEKF, FixedEKF::Vector3>(ekf)) == 0);
+}
+
+TEST_CASE(mekfStepsDoNotAllocate) {
+    MEKF mekf(0.01f);
+    CHECK((stepAllocations<MEKF, Vector3>(mekf)) == 0);
+}
+
+// The hook also counts the aligned allocator, or the tests above would pass without looking at
+// over-aligned storage
+TEST_CASE(hookCountsAlignedAllocations) {
+    struct alignas(64) Wide { float lanes[16]; };
+    allocation_hook::Scope scope;
+    Wide* w = new Wide();
+    Wide* ws = new Wide[3]();
+    void* heap = fastmatrix::arena::heap_allocate(256, 64);
+    CHECK(reinterpret_cast<std::uintptr_t>(w) % 64 == 0);
+    CHECK(reinterpret_cast<std::uintptr_t>(heap) % 64 == 0);
+    fastmatrix::arena::heap_deallocate(heap, 64);
+    delete[] ws;
+    delete w;
+    CHECK(scope.allocations() == 3);
+}
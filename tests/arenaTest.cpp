@@ -0,0 +1,76 @@
+#include "../fastmatrix.hpp"
+#include "check.hpp"
+#include <utility>
+
+using namespace fastmatrix;
+
+TEST_CASE(arenaScopeRewinds) {
+    static_arena<4096> scratch;
+    {
+        arena_scope scope(scratch);
+        arena_matrix<float> m(6, 6);
+        CHECK(scratch.owns(m.get_container().data()));
+        CHECK(scratch.used() >= 36 * sizeof(float));
+    }
+    CHECK(scratch.used() == 0);
+    CHECK(scratch.high_water() >= 36 * sizeof(float));
+    CHECK(scratch.overflows() == 0);
+}
+
+TEST_CASE(arenaCountsOverflows) {
+    static_arena<256> scratch;
+    arena_scope scope(scratch);
+    arena_matrix<float> fits(4, 4);
+    arena_matrix<float> spills(16, 16);  // 1 KiB, taken from the heap
+    CHECK(scratch.owns(fits.get_container().data()));
+    CHECK(!scratch.owns(spills.get_container().data()));
+    CHECK(scratch.overflows() == 1);
+    spills.set_elt(15, 15, 2.0f);
+    CHECK(spills(15, 15) == 2.0f);
+}
+
+TEST_CASE(arenaScopesNest) {
+    static_arena<1024> outer, inner;
+    CHECK(arena::current() == nullptr);
+    {
+        arena_scope a(outer);
+        arena_matrix<float> m(2, 2);
+        std::size_t outerUsed = outer.used();
+        {
+            arena_scope b(inner);
+            CHECK(arena::current() == &inner);
+            arena_matrix<float> n(3, 3);
+            CHECK(inner.owns(n.get_container().data()));
+            CHECK(outer.used() == outerUsed);
+        }
+        CHECK(arena::current() == &outer);
+        CHECK(inner.used() == 0);
+        CHECK(outer.used() == outerUsed);
+    }
+    CHECK(arena::current() == nullptr);
+    CHECK(outer.used() == 0);
+}
+
+TEST_CASE(arenaAllocatorFallsBackToHeap) {
+    arena_matrix<float> m(3, 3);  // no scope installed
+    CHECK(m.get_container().get_allocator().get_arena() == nullptr);
+    CHECK(allocates_from_heap(m.get_container().get_allocator()));
+    m.set_elt(2, 2, 1.0f);
+    CHECK(m(2, 2) == 1.0f);
+}
+
+// A matrix outliving a scope keeps its own storage when a matrix from the scope's arena is moved
+// into it, so the rewind at the end of the scope cannot pull the elements from under it
+TEST_CASE(arenaMoveKeepsDestinationStorage) {
+    static_arena<1024> scratch;
+    arena_matrix<float> kept(3, 3);
+    {
+        arena_scope scope(scratch);
+        arena_matrix<float> tmp(3, 3);
+        tmp.set_elt(1, 2, 5.0f);
+        kept = std::move(tmp);
+    }
+    CHECK(!scratch.owns(kept.get_container().data()));
+    CHECK(kept.get_container().get_allocator().get_arena() == nullptr);
+    CHECK(kept(1, 2) == 5.0f);
+}
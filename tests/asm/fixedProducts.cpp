@@ -0,0 +1,20 @@
+#include "../../fastmatrix.hpp"
+
+// Compiled to assembly by make check, which fails if any of these functions has a backward jump:
+// the element loops of small fixed size products are meant to be unrolled completely at -O2
+using namespace fastmatrix;
+
+extern "C" void product4x4(fixed_matrix<float, 4, 4>& c, const fixed_matrix<float, 4, 4>& a,
+                           const fixed_matrix<float, 4, 4>& b) {
+    c = a * b;
+}
+
+extern "C" void product6x6(fixed_matrix<float, 6, 6>& c, const fixed_matrix<float, 6, 6>& a,
+                           const fixed_matrix<float, 6, 6>& b) {
+    c = a * b;
+}
+
+extern "C" void product6x6Vector(fixed_matrix<float, 6, 1>& c, const fixed_matrix<float, 6, 6>& a,
+                                 const fixed_matrix<float, 6, 1>& b) {
+    c = a * b;
+}
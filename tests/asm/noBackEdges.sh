@@ -0,0 +1,70 @@
+#!/bin/sh
+# Reads GNU assembler output for x86 on stdin and fails if any function in it contains a loop, a
+# cycle in the graph of its basic blocks. Prints the functions that do. Empty input, from a failed
+# compile, fails too. The first argument is the target triple of the compiler, other targets than
+# x86 are skipped since their branch mnemonics are not recognized.
+case "$1" in
+    x86_64*|i?86*) ;;
+    *)
+        cat > /dev/null
+        echo "SKIPPED: loop check of tests/asm reads x86 assembly only, target is ${1:-unknown}" >&2
+        exit 0
+        ;;
+esac
+awk '
+    function finish(    b) {
+        if (name == "") return
+        for (b = 0; b < blocks; ++b) state[b] = 0
+        for (b = 0; b < blocks; ++b) if (!state[b] && cyclic(b)) { print "loop in " name; ++found; break }
+        name = ""
+    }
+    # depth first search, state 1 while on the stack and 2 once done
+    function cyclic(b,    i, t) {
+        state[b] = 1
+        for (i = 0; i < degree[b]; ++i) {
+            t = edge[b, i]
+            if (state[t] == 1 || (!state[t] && cyclic(t))) return 1
+        }
+        state[b] = 2
+        return 0
+    }
+    function newBlock() {
+        if (!ended) edge[blocks - 1, degree[blocks - 1]++] = blocks  # falls through
+        degree[blocks++] = 0
+        ended = 0
+    }
+    /^[ \t]*\.type[ \t]+[^,]+,[ \t]*@function/ {
+        finish()
+        ++functions
+        name = $2; sub(/,$/, "", name)
+        blocks = 0; ended = 1; split("", index_of); split("", pending); npending = 0
+        newBlock()
+        next
+    }
+    name == "" { next }
+    /^[ \t]*\.size[ \t]/ {
+        for (i = 0; i < npending; ++i)
+            if (pending[i, "target"] in index_of)
+                edge[pending[i, "from"], degree[pending[i, "from"]]++] = index_of[pending[i, "target"]]
+        finish()
+        next
+    }
+    /^[.A-Za-z_$][^ \t:]*:/ {
+        label = $0; sub(/:.*/, "", label)
+        newBlock()
+        index_of[label] = blocks - 1
+        next
+    }
+    /^[ \t]+j[a-z]+[ \t]/ {
+        pending[npending, "from"] = blocks - 1; pending[npending++, "target"] = $2
+        if ($1 == "jmp") ended = 1
+        newBlock()
+        next
+    }
+    /^[ \t]+(ret|ud2)/ { ended = 1; newBlock(); next }
+    END {
+        finish()
+        if (!functions) { print "no functions in the input"; exit 1 }
+        exit found > 0
+    }
+'
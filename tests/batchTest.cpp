@@ -0,0 +1,46 @@
+#include "../EKFBatch.hpp"
+#include "readings.hpp"
+#include "check.hpp"
+#include <vector>
+
+// EKFBatch runs the arithmetic of EKF in the same order lane by lane, so every filter of the batch
+// must match a scalar EKF fed the same readings bit for bit, however the blocks are spread over
+// threads
+namespace {
+    bool matchesScalar(std::size_t filters, unsigned threads, int steps) {
+        const float dt = 0.01f;
+        EKFBatch batch(filters, dt);
+        batch.setThreadCount(threads);
+        std::vector<EKF> scalar(filters, EKF(dt));
+        std::vector<float> g[3], a[3], m[3];
+        for(int c=0;c<3;++c) { g[c].resize(filters); a[c].resize(filters); m[c].resize(filters); }
+
+        bool identical = true;
+        for(int k=0; k<steps; ++k) {
+            for(std::size_t f=0; f<filters; ++f) {
+                readings::Sample s = readings::at(int(f), k, dt);
+                for(int c=0;c<3;++c) { g[c][f] = s.gyro[c]; a[c][f] = s.accel[c]; m[c][f] = s.mag[c]; }
+                scalar[f].predict(readings::vector<Vector3>(s.gyro));
+                scalar[f].update(readings::vector<Vector3>(s.accel), readings::vector<Vector3>(s.mag));
+            }
+            batch.predict({g[0].data(), g[1].data(), g[2].data()});
+            batch.update({a[0].data(), a[1].data(), a[2].data()}, {m[0].data(), m[1].data(), m[2].data()});
+
+            for(std::size_t f=0; f<filters; ++f) {
+                Quaternion q = scalar[f].getQuaternion(), qb = batch.getQuaternion(f);
+                Vector3 b = scalar[f].getBias(), bb = batch.getBias(f);
+                for(int i=0;i<4;++i) identical = identical && q(i,0) == qb(i,0);
+                for(int i=0;i<3;++i) identical = identical && b(i,0) == bb(i,0);
+            }
+        }
+        return identical;
+    }
+}
+
+TEST_CASE(ekfBatchMatchesScalarEkf) {
+    CHECK(matchesScalar(37, 1, 300));  // a partial last block
+}
+
+TEST_CASE(ekfBatchMatchesScalarEkfOnThreads) {
+    CHECK(matchesScalar(2048, 4, 50));  // 128 blocks over the caller and three helpers
+}
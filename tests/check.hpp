@@ -0,0 +1,41 @@
+#ifndef CHECK_HPP
+#define CHECK_HPP
+#include <cstdio>
+#include <vector>
+
+// Minimal harness of make check: each tests/*.cpp declares its cases with TEST_CASE and tests them
+// with CHECK, testMain.cpp runs them all and fails when any CHECK did.
+namespace check {
+    struct Case {
+        const char* name;
+        void (*run)();
+    };
+
+    inline std::vector<Case>& cases() {
+        static std::vector<Case> registered;
+        return registered;
+    }
+
+    inline int& failures() {
+        static int count = 0;
+        return count;
+    }
+
+    struct Registrar {
+        Registrar(const char* name, void (*run)()) { cases().push_back({name, run}); }
+    };
+
+    inline void fail(const char* file, int line, const char* what) {
+        ++failures();
+        std::printf("  %s:%d: CHECK(%s) failed\n", file, line, what);
+    }
+}
+
+#define CHECK(cond) \
+    do { if (!(cond)) check::fail(__FILE__, __LINE__, #cond); } while (0)
+
+#define TEST_CASE(name) \
+    static void name(); \
+    static check::Registrar name##Registrar_(#name, name); \
+    static void name()
+#endif
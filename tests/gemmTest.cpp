@@ -0,0 +1,50 @@
+#include "../fastmatrix.hpp"
+#include "reference.hpp"
+#include "check.hpp"
+#include <vector>
+
+// Products of every shape against the naive reference: sizes on both sides of
+// gemm::blocked_threshold, odd ones leaving a tail after the SIMD width and the MR x NR micro-tile,
+// and k past the KC panel depth
+using namespace fastmatrix;
+
+namespace {
+    const std::size_t kRows[] = {1, 3, 5, 17, 33, 131};
+    const std::size_t kInner[] = {1, 7, 31, 257};
+    const std::size_t kCols[] = {1, 5, 13, 67};
+
+    template <typename T>
+    int mismatchedShapes(double tolerance) {
+        int mismatched = 0;
+        for(std::size_t m : kRows)
+          for(std::size_t k : kInner)
+            for(std::size_t n : kCols) {
+                matrix<T> a(m, k), b(k, n), c(m, n);
+                reference::fill(a, unsigned(m + 7*k));
+                reference::fill(b, unsigned(n + 13*k));
+                c = a * b;
+                if (!reference::matches(c, reference::product(reference::copy(a), reference::copy(b)),
+                                        tolerance)) {
+                    std::printf("  %zux%zux%zu mismatched\n", m, k, n);
+                    ++mismatched;
+                }
+            }
+        return mismatched;
+    }
+}
+
+TEST_CASE(gemmMatchesNaiveFloat) {
+    CHECK(mismatchedShapes<float>(1e-5) == 0);
+}
+
+TEST_CASE(gemmMatchesNaiveDouble) {
+    CHECK(mismatchedShapes<double>(1e-12) == 0);
+}
+
+TEST_CASE(gemmEmptyInnerDimensionGivesZero) {
+    std::vector<float> c(6, 1.0f);
+    gemm::multiply<float>(nullptr, nullptr, c.data(), 2, 0, 3);
+    bool zero = true;
+    for(float v : c) zero = zero && v == 0.0f;
+    CHECK(zero);
+}
@@ -0,0 +1,101 @@
+#include "../EKF.hpp"
+#include "../MEKF.hpp"
+#include "../matrixUtils.hpp"
+#include "../Simulation.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // largest component error of rotationVectorToQuaternion for rotations of angle up to maxAngle
+    template <typename T>
+    double exponentialError(double maxAngle) {
+        double worst = 0.0;
+        for(int i=0; i<=300; ++i) {
+            double angle = maxAngle * i / 300;
+            double axis[3] = {0.48, -0.6, 0.64};  // unit
+            fixed_matrix<T, 3, 1> phi;
+            for(int k=0;k<3;++k) phi.set_elt(k,0, T(float(angle * axis[k])));
+            fixed_matrix<T, 4, 1> q = matrix_utils::rotationVectorToQuaternion(phi);
+
+            double exact[4] = {std::cos(angle / 2), 0, 0, 0};
+            for(int k=0;k<3;++k) exact[k+1] = std::sin(angle / 2) * double(float(angle * axis[k])) / angle;
+            if (angle == 0) exact[1] = exact[2] = exact[3] = 0;
+            for(int k=0;k<4;++k) worst = std::max(worst, std::fabs(double(float(q(k,0))) - exact[k]));
+        }
+        return worst;
+    }
+
+    // Noise-free coning: the body axis sweeps a cone of half angle beta at Omega rad/s, with the
+    // closed form attitude q(t) = (cos(beta/2), sin(beta/2)cos(Omega t), sin(beta/2)sin(Omega t), 0)
+    // and body rate Omega*(-sin(beta)sin(Omega t), sin(beta)cos(Omega t), cos(beta) - 1), 2.6 rad/s
+    // in magnitude
+    const double kBeta = 0.6, kOmega = 2 * 3.14159265358979 * 0.7, kDuration = 10.0;
+
+    // mean body rate over [t0, t1], the rate a gyro integrating over the interval reports
+    Vector3 meanRate(double t0, double t1) {
+        double sb = std::sin(kBeta), d = t1 - t0;
+        Vector3 w;
+        w.set_elt(0,0, float(sb * (std::cos(kOmega*t1) - std::cos(kOmega*t0)) / d));
+        w.set_elt(1,0, float(sb * (std::sin(kOmega*t1) - std::sin(kOmega*t0)) / d));
+        w.set_elt(2,0, float(-(1 - std::cos(kBeta)) * kOmega));
+        return w;
+    }
+
+    // the rotation from q(0) to q(t), which is where a filter started at identity should be
+    Quaternion trueAttitude(double t) {
+        double a = std::cos(kBeta / 2), b = std::sin(kBeta / 2), c = std::cos(kOmega*t), s = std::sin(kOmega*t);
+        // conj(q(0)) * q(t), with q(0) = (a, b, 0, 0)
+        double r[4] = {a*a + b*b*c, a*b*c - a*b, a*b*s, -b*b*s};
+        Quaternion q;
+        for(int k=0;k<4;++k) q.set_elt(k,0, float(r[k]));
+        return q;
+    }
+
+    // attitude error in degrees after kDuration of predicts of dt, each from samples gyro readings;
+    // samples 0 feeds a single reading averaged over the whole step
+    template <typename Filter>
+    float coningError(Filter& filter, double dt, int samples) {
+        int steps = int(kDuration / dt + 0.5);
+        for(int k=0; k<steps; ++k) {
+            double t = k * dt;
+            if (samples == 0) {
+                filter.predict(meanRate(t, t + dt), float(dt));
+                continue;
+            }
+            Vector3 gyro[4];
+            for(int i=0;i<samples;++i) gyro[i] = meanRate(t + dt*i/samples, t + dt*(i+1)/samples);
+            filter.predict(gyro, samples, float(dt));
+        }
+        return simulation::attitudeError(trueAttitude(steps * dt), filter.getQuaternion());
+    }
+}
+
+TEST_CASE(exponentialIsExactForFloatAtAnyAngle) {
+    CHECK(exponentialError<float>(1.0) < 2e-7);
+    CHECK(exponentialError<float>(6.0) < 2e-7);  // past the series, through sqrt and trig
+}
+
+TEST_CASE(exponentialIsExactForFixedPointTo1Rad) {
+    CHECK(exponentialError<q4_27>(1.0) < 2e-7);
+}
+
+// A quarter-rate predict from four coning compensated samples is at least as accurate as the full
+// rate predict, and far better than a quarter-rate predict from the mean rate alone
+TEST_CASE(coningQuarterRateMatchesFullRate) {
+    EKF euler(0.01f), full(0.01f), mean(0.04f), compensated(0.04f);
+    euler.setIntegrationMode(EKF::IntegrationMode::Euler);
+    float eulerError = coningError(euler, 0.01, 1);
+    float fullError = coningError(full, 0.01, 1);
+    float meanError = coningError(mean, 0.04, 0);
+    float compensatedError = coningError(compensated, 0.04, 4);
+
+    CHECK(fullError < 1.0f);
+    CHECK(eulerError < 1.0f);
+    CHECK(compensatedError < 0.05f);
+    CHECK(compensatedError <= fullError);
+    CHECK(meanError > 10 * compensatedError);
+
+    MEKF mekf(0.04f);
+    CHECK(coningError(mekf, 0.04, 4) < 0.05f);
+}
@@ -0,0 +1,70 @@
+#include "../fastmatrix.hpp"
+#include "../fastmatrix_ldlt.hpp"
+#include "reference.hpp"
+#include "check.hpp"
+
+// The EKF only applies a joint update when ldlt::compute reports success, so the status has to
+// reject what is not positive definite and a successful solve has to be right
+using namespace fastmatrix;
+
+namespace {
+    // a*transpose(a) + n*I, symmetric positive definite
+    template <typename S>
+    void fillSpd(S& s, unsigned seed) {
+        std::size_t n = s.num_rows();
+        matrix<double> a(n, n);
+        reference::fill(a, seed);
+        reference::Matrix r = reference::product(reference::copy(a), reference::transpose(reference::copy(a)));
+        for(std::size_t i=0; i<n; ++i) r.set_elt(i, i, r(i, i) + double(n));
+        reference::load(s, r);
+    }
+
+    template <typename T, std::size_t N>
+    bool solves(std::size_t n, double tolerance) {
+        symmetric_matrix<T, N> s(n);
+        fillSpd(s, unsigned(n));
+        matrix<T> b(n, 7);
+        reference::fill(b, 3);
+
+        ldlt<T, N> factors;
+        if (factors.compute(s) != decomposition_status::success) return false;
+        matrix<T> x(n, 7);
+        x = factors.solve(b);
+        // S*x must give back b
+        return reference::matches(b, reference::product(reference::copy(s), reference::copy(x)), tolerance);
+    }
+}
+
+TEST_CASE(ldltSolvesSpdFixed) {
+    CHECK((solves<float, 6>(6, 1e-5)));
+    CHECK((solves<double, 6>(6, 1e-12)));
+}
+
+TEST_CASE(ldltSolvesSpdDynamic) {
+    CHECK((solves<double, dynamic>(11, 1e-12)));
+}
+
+TEST_CASE(ldltRejectsIndefinite) {
+    symmetric_matrix<float, 6> s;
+    fillSpd(s, 5);
+    s.set_elt(3, 3, -s(3, 3));
+    ldlt<float, 6> factors;
+    CHECK(factors.compute(s) == decomposition_status::not_positive_definite);
+    CHECK(factors.status() == decomposition_status::not_positive_definite);
+
+    // positive diagonal, but not positive definite
+    symmetric_matrix<float, 2> t;
+    t.set_elt(0, 0, 1.0f);
+    t.set_elt(1, 1, 1.0f);
+    t.set_elt(0, 1, 2.0f);
+    CHECK((ldlt<float, 2>(t).status() == decomposition_status::not_positive_definite));
+}
+
+TEST_CASE(ldltRejectsZero) {
+    symmetric_matrix<float, 6> zero;
+    for(std::size_t i=0; i<6; ++i)
+      for(std::size_t j=i; j<6; ++j) zero.set_elt(i, j, 0.0f);
+    ldlt<float, 6> factors;
+    CHECK(factors.compute(zero) == decomposition_status::not_positive_definite);
+    CHECK((ldlt<float, 6>().status() == decomposition_status::uninitialized));
+}
@@ -0,0 +1,41 @@
+#ifndef READINGS_HPP
+#define READINGS_HPP
+#include <cmath>
+
+// Deterministic sensor readings for the filter tests: a slow rotation with gravity and the field
+// seen from a wobbling body frame, plus a per-filter gyro offset and a little pseudo-random noise.
+// Filter f at step k always gets the same readings.
+namespace readings {
+    struct Sample {
+        float gyro[3], accel[3], mag[3];
+    };
+
+    inline float noise(unsigned& state) {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / float(1 << 24) - 0.5f;
+    }
+
+    inline Sample at(int filter, int step, float dt) {
+        unsigned state = 2654435761u * unsigned(filter + 1) + 40503u * unsigned(step);
+        float t = step * dt, p = 0.3f * std::sin(0.7f*t + filter), r = 0.2f * std::cos(0.5f*t + 0.3f*filter);
+        Sample s;
+        s.gyro[0] = 0.1f + 0.01f*filter + 0.02f*noise(state);
+        s.gyro[1] = -0.05f + 0.02f*noise(state);
+        s.gyro[2] = 0.03f + 0.02f*noise(state);
+        s.accel[0] = std::sin(p) + 0.05f*noise(state);
+        s.accel[1] = -std::sin(r) + 0.05f*noise(state);
+        s.accel[2] = -std::cos(p)*std::cos(r) + 0.05f*noise(state);
+        s.mag[0] = std::cos(p) + 0.05f*noise(state);
+        s.mag[1] = 0.1f*std::sin(t) + 0.05f*noise(state);
+        s.mag[2] = std::sin(p) + 0.05f*noise(state);
+        return s;
+    }
+
+    template <typename V>
+    V vector(const float (&v)[3]) {
+        V out;
+        for(int i=0;i<3;++i) out.set_elt(i,0, typename V::ElementType(v[i]));
+        return out;
+    }
+}
+#endif
@@ -0,0 +1,78 @@
+#ifndef REFERENCE_HPP
+#define REFERENCE_HPP
+#include "../fastmatrix.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+// Naive reference arithmetic for the fastmatrix tests: every result is formed element by element in
+// double, from a copy of the operands taken before the expression under test ran
+namespace reference {
+    using Matrix = fastmatrix::matrix<double>;
+
+    // deterministic values in [-1, 1), different for every seed
+    template <typename M>
+    void fill(M& m, unsigned seed) {
+        unsigned state = 2654435761u * (seed + 1);
+        for(std::size_t i=0; i<m.num_rows(); ++i)
+          for(std::size_t j=0; j<m.num_cols(); ++j) {
+              state = state * 1664525u + 1013904223u;
+              m.set_elt(i, j, typename M::ElementType((state >> 8) / double(1 << 23) - 1.0));
+          }
+    }
+
+    template <typename E>
+    Matrix copy(const E& e) {
+        Matrix r(e.num_rows(), e.num_cols());
+        for(std::size_t i=0; i<e.num_rows(); ++i)
+          for(std::size_t j=0; j<e.num_cols(); ++j) r.set_elt(i, j, double(e(i, j)));
+        return r;
+    }
+
+    // sets m, already of the right shape, to r rounded to its element type
+    template <typename M>
+    void load(M& m, const Matrix& r) {
+        for(std::size_t i=0; i<r.num_rows(); ++i)
+          for(std::size_t j=0; j<r.num_cols(); ++j) m.set_elt(i, j, typename M::ElementType(r(i, j)));
+    }
+
+    inline Matrix product(const Matrix& a, const Matrix& b) {
+        Matrix r(a.num_rows(), b.num_cols());
+        for(std::size_t i=0; i<a.num_rows(); ++i)
+          for(std::size_t j=0; j<b.num_cols(); ++j) {
+              double s = 0;
+              for(std::size_t k=0; k<a.num_cols(); ++k) s += a(i, k) * b(k, j);
+              r.set_elt(i, j, s);
+          }
+        return r;
+    }
+
+    inline Matrix transpose(const Matrix& a) {
+        Matrix r(a.num_cols(), a.num_rows());
+        for(std::size_t i=0; i<a.num_rows(); ++i)
+          for(std::size_t j=0; j<a.num_cols(); ++j) r.set_elt(j, i, a(i, j));
+        return r;
+    }
+
+    // a + sign*b
+    inline Matrix add(const Matrix& a, const Matrix& b, double sign = 1) {
+        Matrix r(a.num_rows(), a.num_cols());
+        for(std::size_t i=0; i<a.num_rows(); ++i)
+          for(std::size_t j=0; j<a.num_cols(); ++j) r.set_elt(i, j, a(i, j) + sign * b(i, j));
+        return r;
+    }
+
+    // whether e has the shape of r and its elements agree to tolerance relative to the largest of r
+    template <typename E>
+    bool matches(const E& e, const Matrix& r, double tolerance) {
+        if (e.num_rows() != r.num_rows() || e.num_cols() != r.num_cols()) return false;
+        double scale = 1, worst = 0;
+        for(std::size_t i=0; i<r.num_rows(); ++i)
+          for(std::size_t j=0; j<r.num_cols(); ++j) {
+              scale = std::max(scale, std::fabs(r(i, j)));
+              worst = std::max(worst, std::fabs(double(e(i, j)) - r(i, j)));
+          }
+        return worst <= tolerance * scale;
+    }
+}
+#endif
@@ -0,0 +1,49 @@
+#include "../MeasurementScheduler.hpp"
+#include "../MEKF.hpp"
+#include "check.hpp"
+
+namespace {
+    template <typename V>
+    V vector(float x, float y, float z) {
+        V v;
+        v.set_elt(0,0, typename V::ElementType(x));
+        v.set_elt(1,0, typename V::ElementType(y));
+        v.set_elt(2,0, typename V::ElementType(z));
+        return v;
+    }
+
+    // An accel sample halfway between two gyro samples is predicted to with the rate of the later
+    // one, whose interval it falls in, and not with the rate before it
+    template <typename Filter>
+    bool usesRateOfCoveringInterval() {
+        using V = typename Filter::Vector3;
+        V still = vector<V>(0.0f, 0.0f, 0.0f), turning = vector<V>(1.0f, -0.5f, 2.0f);
+        V accel = vector<V>(0.05f, 0.0f, -1.0f);
+
+        Filter scheduled(0.01f);
+        MeasurementScheduler<Filter> scheduler(scheduled);
+        scheduler.addGyro(0.0, still);
+        scheduler.addAccel(0.005, accel);
+        scheduler.addGyro(0.01, turning);
+        scheduler.flush();
+
+        Filter expected(0.01f);
+        expected.predict(turning, 0.005f);
+        expected.updateAccel(accel);
+        expected.predict(turning, 0.005f);
+
+        auto q = scheduled.getQuaternion(), e = expected.getQuaternion();
+        bool same = true;
+        for(int i=0;i<4;++i) same = same && q(i,0) == e(i,0);
+        return same && scheduler.stats().predicts == 2 && scheduler.stats().accelUpdates == 1;
+    }
+}
+
+TEST_CASE(schedulerPredictsWithCoveringGyroRate) {
+    CHECK(usesRateOfCoveringInterval<EKF>());
+    CHECK(usesRateOfCoveringInterval<MEKF>());
+}
+
+TEST_CASE(schedulerRunsFixedPointEkf) {
+    CHECK(usesRateOfCoveringInterval<FixedEKF>());
+}
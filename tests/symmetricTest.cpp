@@ -0,0 +1,62 @@
+#include "../fastmatrix.hpp"
+#include "../fastmatrix_block.hpp"
+#include "../fastmatrix_symmetric.hpp"
+#include "reference.hpp"
+#include "check.hpp"
+
+// congruence(F, P) + Q computes the upper triangle of F*P*transpose(F) + Q only, reading P through
+// its packed storage; it must give the dense result, also when assigned back to P as the EKF does
+using namespace fastmatrix;
+
+namespace {
+    const double kTolerance = 1e-5;
+
+    template <typename F, typename S>
+    bool propagates(F& f, S& p, S& q, unsigned seed) {
+        reference::fill(f, seed);
+        reference::fill(p, seed + 1);
+        reference::fill(q, seed + 2);
+        reference::Matrix rf = reference::copy(f), rp = reference::copy(p), rq = reference::copy(q);
+        reference::Matrix expected =
+            reference::add(reference::product(reference::product(rf, rp), reference::transpose(rf)), rq);
+
+        S out(p.num_rows());
+        out = congruence(f, p) + q;
+        bool ok = reference::matches(out, expected, kTolerance);
+        out = congruence(f, p);
+        ok = ok && reference::matches(out, reference::add(expected, rq, -1), kTolerance);
+        p = congruence(f, p) + q;  // aliased, as P_ in EKF::propagate
+        ok = ok && reference::matches(p, expected, kTolerance);
+        return ok;
+    }
+}
+
+TEST_CASE(congruenceMatchesDenseFixed) {
+    fixed_matrix<float, 7, 7> f;
+    symmetric_matrix<float, 7> p, q;
+    CHECK(propagates(f, p, q, 1));
+}
+
+TEST_CASE(congruenceMatchesDenseDynamic) {
+    matrix<float> f(9, 9);
+    symmetric_matrix<float> p(9), q(9);
+    CHECK(propagates(f, p, q, 4));
+}
+
+// the structured transition of the EKF, whose zero and identity blocks the product skips
+TEST_CASE(congruenceMatchesDenseBlockTransition) {
+    block_matrix<float, 7, 7, 4, 4, block_kind::dense, block_kind::dense,
+                 block_kind::zero, block_kind::identity> f(7, 7);
+    symmetric_matrix<float, 7> p, q;
+    reference::fill(p, 7);
+    reference::fill(q, 8);
+    fixed_matrix<float, 4, 7> top;
+    reference::fill(top, 9);
+    for(std::size_t i=0; i<4; ++i)
+      for(std::size_t j=0; j<7; ++j) f.set_elt(i, j, top(i, j));
+    reference::Matrix rf = reference::copy(f), rp = reference::copy(p), rq = reference::copy(q);
+    reference::Matrix expected =
+        reference::add(reference::product(reference::product(rf, rp), reference::transpose(rf)), rq);
+    p = congruence(f, p) + q;
+    CHECK(reference::matches(p, expected, kTolerance));
+}
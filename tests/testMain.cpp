@@ -0,0 +1,19 @@
+// The one translation unit of guidance_test that replaces the global allocator with the counting
+// one of allocationHook.hpp, so the filters built with -DEKF_CHECK_ALLOCATIONS can assert on it
+#define ALLOCATION_HOOK_IMPLEMENTATION
+#include "../allocationHook.hpp"
+#include "check.hpp"
+#include <cstdio>
+
+int main() {
+    int failedCases = 0;
+    for (const check::Case& c : check::cases()) {
+        int before = check::failures();
+        c.run();
+        bool ok = check::failures() == before;
+        if (!ok) ++failedCases;
+        std::printf("%-40s %s\n", c.name, ok ? "ok" : "FAILED");
+    }
+    std::printf("%zu cases, %d failed\n", check::cases().size(), failedCases);
+    return failedCases ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#include "../EKF.hpp"
+#include "readings.hpp"
+#include "check.hpp"
+#include <algorithm>
+#include <cmath>
+
+// With a diagonal R the sequential update of UpdateMode::Automatic is the joint update of
+// UpdateMode::Batch done one row at a time, so the two only differ by rounding
+TEST_CASE(automaticUpdateMatchesBatch) {
+    const float dt = 0.01f;
+    float worst = 0.0f;
+    for(int f=0; f<8; ++f) {
+        EKF automatic(dt), batch(dt);
+        batch.setUpdateMode(EKF::UpdateMode::Batch);
+        for(int k=0; k<500; ++k) {
+            readings::Sample s = readings::at(f, k, dt);
+            Vector3 gyro = readings::vector<Vector3>(s.gyro);
+            Vector3 accel = readings::vector<Vector3>(s.accel), mag = readings::vector<Vector3>(s.mag);
+            automatic.predict(gyro);
+            batch.predict(gyro);
+            CHECK(automatic.update(accel, mag));
+            CHECK(batch.update(accel, mag));
+
+            Quaternion qa = automatic.getQuaternion(), qb = batch.getQuaternion();
+            Vector3 ba = automatic.getBias(), bb = batch.getBias();
+            for(int i=0;i<4;++i) worst = std::max(worst, std::fabs(qa(i,0) - qb(i,0)));
+            for(int i=0;i<3;++i) worst = std::max(worst, std::fabs(ba(i,0) - bb(i,0)));
+        }
+    }
+    CHECK(worst < 1e-5f);
+}